@@ -1,20 +1,278 @@
 #include <stdio.h>
+#include <stdbool.h>
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <driver/gpio.h>
+#include <driver/ledc.h>
+#include <soc/gpio_struct.h>
+#include <soc/soc_caps.h>
+#include "freertos/FreeRTOS.h"
 #include "output_iot.h"
 
+static const char *TAG = "output_iot";
+
+#define OUTPUT_PATTERN_MAX          8
+/* Each hardware pattern owns one LEDC timer and the channel with the same index */
+#define OUTPUT_PATTERN_LEDC_MAX     4
+#define OUTPUT_PATTERN_LEDC_MODE    LEDC_LOW_SPEED_MODE
+
+typedef struct {
+    gpio_num_t gpio_num;
+    output_pattern_t pattern;
+    int ledc_channel;           /* -1 when driven in software */
+    esp_timer_handle_t timer;
+    int64_t start_us;
+} output_pattern_slot_t;
+
+static output_pattern_slot_t s_patterns[OUTPUT_PATTERN_MAX];
+static bool s_patterns_init = false;
+
+/* Shadow of the levels we drive, so outputs never have to be read back */
+static uint64_t s_shadow = 0;
+/* Pins this module has driven, the only bits output_io_apply writes */
+static uint64_t s_owned = 0;
+static portMUX_TYPE s_shadow_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Caller holds s_shadow_lock. Each bank takes a write-1-to-clear store then
+ * a write-1-to-set store, both of them atomic in the GPIO block, so pins we
+ * don't own are never touched, whoever drives them and from wherever. The
+ * cost is a window of one bus write between the two stores where the pins
+ * going low already are and the pins going high still aren't: a mask shows
+ * up half applied as break-before-make, never as both levels at once. */
+static inline void IRAM_ATTR output_io_apply(uint64_t changed) {
+    if ((uint32_t) changed) {
+        uint32_t owned = (uint32_t) s_owned;
+        GPIO.out_w1tc = owned & ~(uint32_t) s_shadow;
+        GPIO.out_w1ts = owned & (uint32_t) s_shadow;
+    }
+#if SOC_GPIO_PIN_COUNT > 32
+    if (changed >> 32) {
+        uint32_t owned = (uint32_t) (s_owned >> 32);
+        GPIO.out1_w1tc.val = owned & ~(uint32_t) (s_shadow >> 32);
+        GPIO.out1_w1ts.val = owned & (uint32_t) (s_shadow >> 32);
+    }
+#endif
+}
+
 void output_io_create(gpio_num_t gpio_num) {
     gpio_pad_select_gpio(gpio_num);
-    gpio_set_direction(gpio_num, GPIO_MODE_INPUT_OUTPUT);
+    gpio_set_direction(gpio_num, GPIO_MODE_OUTPUT);
+    /* Start from a known level so the shadow matches the pin */
+    output_io_set_level(gpio_num, 0);
+}
 
+void IRAM_ATTR output_io_set_level(gpio_num_t gpio_num, int level) {
+    if (level) {
+        output_io_write_mask(OUTPUT_IO_BIT(gpio_num), 0);
+    } else {
+        output_io_write_mask(0, OUTPUT_IO_BIT(gpio_num));
+    }
 }
 
-void output_io_set_level(gpio_num_t gpio_num, int level) {
-    gpio_set_level(gpio_num, level);
+void IRAM_ATTR output_io_toggle(gpio_num_t gpio_num) {
+    uint64_t bit = OUTPUT_IO_BIT(gpio_num);
+    portENTER_CRITICAL_SAFE(&s_shadow_lock);
+    s_shadow ^= bit;
+    s_owned |= bit;
+    output_io_apply(bit);
+    portEXIT_CRITICAL_SAFE(&s_shadow_lock);
+}
+
+int output_io_get_level(gpio_num_t gpio_num) {
+    return (s_shadow >> gpio_num) & 1;
+}
+
+void IRAM_ATTR output_io_write_mask(uint64_t set_mask, uint64_t clear_mask) {
+    /* A pin in both masks ends up set */
+    clear_mask &= ~set_mask;
+    portENTER_CRITICAL_SAFE(&s_shadow_lock);
+    s_shadow = (s_shadow | set_mask) & ~clear_mask;
+    s_owned |= set_mask | clear_mask;
+    output_io_apply(set_mask | clear_mask);
+    portEXIT_CRITICAL_SAFE(&s_shadow_lock);
+}
+
+static void output_pattern_sw_step(output_pattern_slot_t *slot) {
+    int64_t t_us = esp_timer_get_time() - slot->start_us;
+    uint64_t next_us;
+    int level;
+    bool running = output_pattern_eval(&slot->pattern, t_us, &level, &next_us);
+    output_io_set_level(slot->gpio_num, level);
+    if (running) {
+        /* Scheduled against the start time so no drift builds up */
+        esp_timer_start_once(slot->timer, next_us - t_us);
+    }
+}
+
+static void output_pattern_hw_step(output_pattern_slot_t *slot) {
+    const output_pattern_t *pattern = &slot->pattern;
+    uint64_t period_us = (uint64_t) pattern->period_ms * 1000;
+    uint64_t burst_us = period_us * pattern->burst_count;
+    uint64_t cycle_us = burst_us + (uint64_t) pattern->burst_gap_ms * 1000;
+    uint64_t t_us = esp_timer_get_time() - slot->start_us;
+    uint64_t index = t_us / cycle_us;
+    uint64_t pos_us = t_us % cycle_us;
+
+    if ((pattern->repeat && index >= pattern->repeat) || pos_us >= burst_us) {
+        ledc_stop(OUTPUT_PATTERN_LEDC_MODE, slot->ledc_channel, 0);
+        if (pattern->repeat && index + 1 >= pattern->repeat) {
+            return;
+        }
+        esp_timer_start_once(slot->timer, cycle_us - pos_us);
+        return;
+    }
+    /* One wake-up per burst edge, the pulses inside the burst come from the LEDC */
+    ledc_timer_rst(OUTPUT_PATTERN_LEDC_MODE, slot->ledc_channel);
+    ledc_update_duty(OUTPUT_PATTERN_LEDC_MODE, slot->ledc_channel);
+    esp_timer_start_once(slot->timer, burst_us - pos_us);
 }
 
-void output_io_toggle(gpio_num_t gpio_num) {
-    int old_level = gpio_get_level(gpio_num);
-    gpio_set_level(gpio_num, 1 - old_level);
+static void output_pattern_timer_cb(void *arg) {
+    output_pattern_slot_t *slot = (output_pattern_slot_t *) arg;
+    if (slot->ledc_channel < 0) {
+        output_pattern_sw_step(slot);
+    } else {
+        output_pattern_hw_step(slot);
+    }
 }
 
+/* Program LEDC timer/channel `index` for the pattern period, clocked from the 1 MHz REF_TICK */
+static esp_err_t output_pattern_ledc_setup(int index, gpio_num_t gpio_num, const output_pattern_t *pattern) {
+    uint32_t resolution;
+    uint32_t divider;
+    if (!output_pattern_ledc_clock(pattern->period_ms, &resolution, &divider)) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    ledc_timer_config_t timer_config = {
+        .speed_mode = OUTPUT_PATTERN_LEDC_MODE,
+        .duty_resolution = LEDC_TIMER_10_BIT,
+        .timer_num = index,
+        .freq_hz = 100,
+        .clk_cfg = LEDC_USE_REF_TICK,
+    };
+    esp_err_t err = ledc_timer_config(&timer_config);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = ledc_timer_set(OUTPUT_PATTERN_LEDC_MODE, index, divider, resolution, LEDC_REF_TICK);
+    if (err != ESP_OK) {
+        return err;
+    }
+    ledc_channel_config_t channel_config = {
+        .gpio_num = gpio_num,
+        .speed_mode = OUTPUT_PATTERN_LEDC_MODE,
+        .channel = index,
+        .intr_type = LEDC_INTR_DISABLE,
+        .timer_sel = index,
+        .duty = (uint32_t) (((1ULL << resolution) * pattern->duty_percent) / 100),
+        .hpoint = 0,
+    };
+    return ledc_channel_config(&channel_config);
+}
+
+static output_pattern_slot_t *output_pattern_find(gpio_num_t gpio_num) {
+    for (int i = 0; i < OUTPUT_PATTERN_MAX; i++) {
+        if (s_patterns[i].gpio_num == gpio_num) {
+            return &s_patterns[i];
+        }
+    }
+    return NULL;
+}
+
+static int output_pattern_free_ledc(void) {
+    bool used[OUTPUT_PATTERN_LEDC_MAX] = { false };
+    for (int i = 0; i < OUTPUT_PATTERN_MAX; i++) {
+        if (s_patterns[i].gpio_num != GPIO_NUM_NC && s_patterns[i].ledc_channel >= 0) {
+            used[s_patterns[i].ledc_channel] = true;
+        }
+    }
+    for (int i = 0; i < OUTPUT_PATTERN_LEDC_MAX; i++) {
+        if (!used[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void output_pattern_release_pin(output_pattern_slot_t *slot) {
+    esp_timer_stop(slot->timer);
+    if (slot->ledc_channel >= 0) {
+        ledc_stop(OUTPUT_PATTERN_LEDC_MODE, slot->ledc_channel, 0);
+        /* Routes the pad back to the GPIO output register */
+        gpio_set_direction(slot->gpio_num, GPIO_MODE_OUTPUT);
+    }
+    output_io_set_level(slot->gpio_num, 0);
+}
+
+esp_err_t output_io_pattern_start(gpio_num_t gpio_num, const output_pattern_t *pattern) {
+    if (!GPIO_IS_VALID_OUTPUT_GPIO(gpio_num) || !output_pattern_is_valid(pattern)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_patterns_init) {
+        for (int i = 0; i < OUTPUT_PATTERN_MAX; i++) {
+            s_patterns[i].gpio_num = GPIO_NUM_NC;
+            s_patterns[i].ledc_channel = -1;
+        }
+        s_patterns_init = true;
+    }
+
+    output_pattern_slot_t *slot = output_pattern_find(gpio_num);
+    if (slot) {
+        output_pattern_release_pin(slot);
+    } else {
+        slot = output_pattern_find(GPIO_NUM_NC);
+        if (slot == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        if (slot->timer == NULL) {
+            const esp_timer_create_args_t timer_args = {
+                .callback = output_pattern_timer_cb,
+                .arg = slot,
+                .name = "output_pattern",
+            };
+            esp_err_t err = esp_timer_create(&timer_args, &slot->timer);
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+        slot->gpio_num = gpio_num;
+        slot->ledc_channel = -1;
+    }
+    slot->pattern = *pattern;
+
+    int level;
+    uint64_t next_us;
+    bool has_edges = output_pattern_eval(pattern, 0, &level, &next_us);
+
+    int ledc_channel = slot->ledc_channel >= 0 ? slot->ledc_channel : output_pattern_free_ledc();
+    slot->ledc_channel = -1;
+    if (has_edges && ledc_channel >= 0) {
+        if (output_pattern_ledc_setup(ledc_channel, gpio_num, pattern) == ESP_OK) {
+            slot->ledc_channel = ledc_channel;
+        } else {
+            ESP_LOGW(TAG, "GPIO %d pattern out of LEDC range, using software", gpio_num);
+        }
+    }
+
+    slot->start_us = esp_timer_get_time();
+    if (!has_edges) {
+        output_io_set_level(gpio_num, level);
+    } else if (slot->ledc_channel < 0) {
+        output_pattern_sw_step(slot);
+    } else if (pattern->burst_count) {
+        output_pattern_hw_step(slot);
+    }
+    return ESP_OK;
+}
+
+esp_err_t output_io_pattern_stop(gpio_num_t gpio_num) {
+    output_pattern_slot_t *slot = s_patterns_init ? output_pattern_find(gpio_num) : NULL;
+    if (slot == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    output_pattern_release_pin(slot);
+    slot->gpio_num = GPIO_NUM_NC;
+    slot->ledc_channel = -1;
+    return ESP_OK;
+}
@@ -0,0 +1,28 @@
+#ifndef OUTPUT_PATTERN_H
+#define OUTPUT_PATTERN_H
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Blink pattern timing, free of driver dependencies so it can be simulated off-target */
+
+typedef struct {
+    uint32_t period_ms;         /* One on/off cycle */
+    uint8_t duty_percent;       /* Share of the period the output is high */
+    uint32_t burst_count;       /* Pulses per burst, 0 blinks continuously */
+    uint32_t burst_gap_ms;      /* Low time between bursts */
+    uint32_t repeat;            /* Number of bursts, 0 repeats forever */
+} output_pattern_t;
+
+bool output_pattern_is_valid(const output_pattern_t *pattern);
+
+/* Level of the pattern t_us after it started and the time of its next edge.
+ * Returns false once the pattern has finished, the output then stays low. */
+bool output_pattern_eval(const output_pattern_t *pattern, uint64_t t_us, int *level, uint64_t *next_us);
+
+/* LEDC timer setup for a period clocked from 1 MHz: the duty resolution in
+ * bits and the 10.8 fixed point divider. The resolution is the largest, up
+ * to 20 bits, that keeps the divider at 1.0 or more, so duty steps are as
+ * fine as the clock allows. Returns false when the period is out of range. */
+bool output_pattern_ledc_clock(uint32_t period_ms, uint32_t *resolution, uint32_t *divider);
+
+#endif
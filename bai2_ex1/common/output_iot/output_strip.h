@@ -0,0 +1,32 @@
+#ifndef OUTPUT_STRIP_H
+#define OUTPUT_STRIP_H
+#include <stdint.h>
+#include <esp_err.h>
+#include <hal/gpio_types.h>
+#include "output_strip_encode.h"
+
+typedef struct {
+    gpio_num_t gpio_num;
+    int rmt_channel;
+    uint32_t led_count;
+    output_strip_timing_t timing;
+} output_strip_config_t;
+
+#define OUTPUT_STRIP_CONFIG_DEFAULT(gpio, channel, count) { \
+    .gpio_num = gpio,                                        \
+    .rmt_channel = channel,                                  \
+    .led_count = count,                                      \
+    .timing = OUTPUT_STRIP_TIMING_WS2812(),                  \
+}
+
+typedef struct output_strip output_strip_t;
+
+esp_err_t output_strip_create(const output_strip_config_t *config, output_strip_t **ret_strip);
+esp_err_t output_strip_set_pixel(output_strip_t *strip, uint32_t index, uint8_t red, uint8_t green, uint8_t blue);
+esp_err_t output_strip_clear(output_strip_t *strip);
+/* Encode the pixels into the idle buffer and start shifting it out. Returns once the
+ * transfer has started, the previous frame is waited for only if it is still running. */
+esp_err_t output_strip_refresh(output_strip_t *strip);
+esp_err_t output_strip_delete(output_strip_t *strip);
+
+#endif
@@ -11,81 +11,61 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/portmacro.h"
-#include "freertos/event_groups.h"
+#include "freertos/queue.h"
 #include "esp_system.h"
 #include "esp_spi_flash.h"
+#include "esp_timer.h"
 #include "input_iot.h"
+#include "input_gesture.h"
 #include "output_iot.h"
-#include "freertos/timers.h"
-#include "freertos/event_groups.h"
 #include "hal/gpio_types.h"
 
-#define NUM_TIMERS 2
-
-#define BIT_EVENT_SHORT_PRESS (1 << 0)
-#define BIT_EVENT_NORMAL_PRESS (1 << 1)
-#define BIT_EVENT_LONG_PRESS (1 << 2)
-
-/* An array to hold handles to the created timers. */
-TimerHandle_t xTimers[NUM_TIMERS];
-
-/* Declare a variable to hold the created event group. */
-static EventGroupHandle_t xCreatedEventGroup;
-static uint64_t __start, __stop, __press_tick;
-
-void button_callback(int pin)
+/* Press classification table, longest press last */
+static const input_gesture_class_t s_press_classes[] = {
+    { 1000000, INPUT_GESTURE_SHORT },
+    { 3000000, INPUT_GESTURE_NORMAL },
+    { 5000000, INPUT_GESTURE_LONG },
+};
+
+static const input_gesture_config_t s_gesture_config = {
+    .active_level = 0,
+    .debounce_us = 20000,
+    .classes = s_press_classes,
+    .class_count = sizeof(s_press_classes) / sizeof(s_press_classes[0]),
+    .double_click_us = 300000,
+    .hold_start_us = 7000000,
+    .hold_repeat_us = 0,       /* One "Timeout" per press, like the old one-shot timer */
+};
+
+/* Edges forwarded from the input_iot worker to the button task */
+static QueueHandle_t xButtonQueue;
+
+void button_callback(const input_event_t *event, void *ctx)
 {
-    EventBits_t uxBits;
-    BaseType_t xHigherPriorityTaskWoken;
-    uint64_t rtc = xTaskGetTickCountFromISR();
-    if (pin == GPIO_NUM_0)
-    {
-        if(input_io_get_level(pin) == 0) {
-            xTimerStartFromISR(xTimers[0],
-                               &xHigherPriorityTaskWoken);
-            __start = rtc;
-        } else {
-            xTimerStopFromISR( xTimers[0], &xHigherPriorityTaskWoken );
-            __stop = rtc;
-            __press_tick = __stop - __start;
-
-            uint64_t press_time_ms = __press_tick * portTICK_PERIOD_MS;
-            if(press_time_ms <= 1000 && press_time_ms > 0)  {
-                //short press
-                /* Set bit 0 in xEventGroup. */
-                uxBits = xEventGroupSetBitsFromISR(
-                    xCreatedEventGroup,                                /* The event group being updated. */
-                    BIT_EVENT_SHORT_PRESS, &xHigherPriorityTaskWoken); /* The bits being set. */
-            } else if(press_time_ms <= 3000 && press_time_ms > 1000)
-            {
-                //normal press
-                /* Set bit 1 in xEventGroup. */
-                uxBits = xEventGroupSetBitsFromISR(
-                    xCreatedEventGroup,                                /* The event group being updated. */
-                    BIT_EVENT_NORMAL_PRESS, &xHigherPriorityTaskWoken); /* The bits being set. */
-            } else if(press_time_ms <= 5000 && press_time_ms > 3000)
-            {
-                //long press
-                /* Set bit 2 in xEventGroup. */
-                uxBits = xEventGroupSetBitsFromISR(
-                    xCreatedEventGroup,                                /* The event group being updated. */
-                    BIT_EVENT_LONG_PRESS, &xHigherPriorityTaskWoken); /* The bits being set. */
-            }
-        }
-    }
+    xQueueSend((QueueHandle_t) ctx, event, 0);
 }
 
-void vTimerCallback(TimerHandle_t xTimer)
+static void print_gesture(input_gesture_event_t event)
 {
-    /* Optionally do something if the pxTimer parameter is NULL. */
-    configASSERT(xTimer);
-
-    /* The number of times this timer has expired is saved as the
-    timer's ID.  Obtain the count. */
-    uint32_t ulCount = (uint32_t)pvTimerGetTimerID(xTimer);
-    if (ulCount == 0)
+    switch (event)
     {
-        printf("Timeout\n");
+        case INPUT_GESTURE_SHORT:
+            printf("Short press\n");
+            break;
+        case INPUT_GESTURE_NORMAL:
+            printf("Normal press\n");
+            break;
+        case INPUT_GESTURE_LONG:
+            printf("Long press\n");
+            break;
+        case INPUT_GESTURE_DOUBLE:
+            printf("Double click\n");
+            break;
+        case INPUT_GESTURE_HOLD:
+            printf("Timeout\n");
+            break;
+        default:
+            break;
     }
 }
 
@@ -96,22 +76,37 @@ void vTaskButtonHandle(void *pvParameters)
     pvParameters value in the call to xTaskCreate() below. */
     configASSERT(((uint32_t)pvParameters) == 1);
 
+    input_gesture_t gesture;
+    input_gesture_init(&gesture, &s_gesture_config);
+
     for (;;)
     {
-        EventBits_t uxBits = xEventGroupWaitBits(
-            xCreatedEventGroup,   /* The event group being tested. */
-            BIT_EVENT_SHORT_PRESS | BIT_EVENT_NORMAL_PRESS | BIT_EVENT_LONG_PRESS, /* The bits within the event group to wait for. */
-            pdTRUE,        /* BIT_0 & BIT_4 should be cleared before returning. */
-            pdFALSE,       /* Don't wait for both bits, either bit will do. */
-            portMAX_DELAY); /* Wait a maximum of 100ms for either bit to be set. */
-        if(uxBits & BIT_EVENT_SHORT_PRESS) {
-            printf("Short press\n");
+        /* Sleep until the next edge or the next gesture deadline, whichever comes first. */
+        TickType_t wait = portMAX_DELAY;
+        int64_t deadline = input_gesture_next_deadline(&gesture);
+        if (deadline >= 0)
+        {
+            int64_t remaining_us = deadline - esp_timer_get_time();
+            wait = remaining_us > 0 ? pdMS_TO_TICKS((remaining_us + 999) / 1000) + 1 : 0;
         }
-        if(uxBits & BIT_EVENT_NORMAL_PRESS) {
-            printf("Normal press\n");
-        } 
-        if(uxBits & BIT_EVENT_LONG_PRESS) {
-            printf("Long press\n");
+
+        input_event_t edge;
+        input_gesture_event_t event;
+        if (xQueueReceive(xButtonQueue, &edge, wait) == pdTRUE)
+        {
+            while ((event = input_gesture_poll(&gesture, edge.timestamp_us)) != INPUT_GESTURE_NONE)
+            {
+                print_gesture(event);
+            }
+            print_gesture(input_gesture_feed(&gesture, edge.level, edge.timestamp_us));
+        }
+        else
+        {
+            int64_t now = esp_timer_get_time();
+            while ((event = input_gesture_poll(&gesture, now)) != INPUT_GESTURE_NONE)
+            {
+                print_gesture(event);
+            }
         }
     }
 }
@@ -122,23 +117,28 @@ void app_main(void)
 
     BaseType_t xReturned;
 
-    /* Attempt to create the event group. */
-    xCreatedEventGroup = xEventGroupCreate();
-    /* Was the event group created successfully? */
-    if (xCreatedEventGroup == NULL)
+    /* Attempt to create the button queue. */
+    xButtonQueue = xQueueCreate(16, sizeof(input_event_t));
+    /* Was the queue created successfully? */
+    if (xButtonQueue == NULL)
     {
-        /* The event group was not created because there was insufficient
+        /* The queue was not created because there was insufficient
         FreeRTOS heap available. */
     }
     else
     {
-        /* The event group was created. */
-        printf("xCreatedEventGroup is created\n");
+        /* The queue was created. */
+        printf("xButtonQueue is created\n");
     }
 
     output_io_create(2);
-    input_io_create(0, GPIO_INTR_ANYEDGE);
-    input_set_callback(button_callback);
+    input_deferred_config_t deferred_config = INPUT_DEFERRED_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(input_io_deferred_start(&deferred_config));
+    input_io_set_deferred_handler(GPIO_NUM_0, button_callback, xButtonQueue);
+    /* A floating button line on ANY_EDGE must not starve the other tasks */
+    input_storm_config_t storm_config = INPUT_STORM_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(input_io_storm_start(&storm_config, NULL, NULL));
+    input_io_create(GPIO_NUM_0, GPIO_INTR_ANYEDGE);
 
     /* Create the task, storing the handle. */
     xReturned = xTaskCreate(
@@ -152,33 +152,4 @@ void app_main(void)
     if (xReturned == pdPASS)
     {
     }
-
-    /* Create then start some timers.  Starting the timers before
-    the RTOS scheduler has been started means the timers will start
-    running immediately that the RTOS scheduler starts. */
-
-    xTimers[0] = xTimerCreate(/* Just a text name, not used by the RTOS
-                              kernel. */
-                              "TimerBlink",
-                              /* The timer period in ticks, must be
-                              greater than 0. */
-                              pdMS_TO_TICKS(7000),
-                              /* The timers will auto-reload themselves
-                              when they expire. */
-                              pdFAIL,
-                              /* The ID is used to store a count of the
-                              number of times the timer has expired, which
-                              is initialised to 0. */
-                              (void *)0,
-                              /* Each timer calls the same callback when
-                              it expires. */
-                              vTimerCallback);
-
-    if (xTimers[0] == NULL)
-    {
-        /* The timer was not created. */
-    }
-    else
-    {
-    }
 }
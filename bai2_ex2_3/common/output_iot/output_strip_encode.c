@@ -0,0 +1,43 @@
+#include "output_strip_encode.h"
+
+static uint32_t strip_item(uint32_t high_ticks, uint32_t low_ticks) {
+    return (high_ticks & 0x7fff) | (1u << 15) | ((low_ticks & 0x7fff) << 16);
+}
+
+void output_strip_symbols_init(output_strip_symbols_t *symbols, const output_strip_timing_t *timing,
+                               uint32_t counter_clk_hz) {
+    /* ns to counter ticks, rounded to nearest */
+    uint64_t clk = counter_clk_hz;
+    symbols->bit0 = strip_item((timing->t0h_ns * clk + 500000000) / 1000000000,
+                               (timing->t0l_ns * clk + 500000000) / 1000000000);
+    symbols->bit1 = strip_item((timing->t1h_ns * clk + 500000000) / 1000000000,
+                               (timing->t1l_ns * clk + 500000000) / 1000000000);
+    /* Both halves low, rounded up so the gap is never short. A zero half
+     * would read as the end marker, so each gets at least one tick. */
+    uint64_t half = ((timing->reset_us * clk + 999999) / 1000000 + 1) / 2;
+    if (half == 0) {
+        half = 1;
+    } else if (half > 0x7fff) {
+        half = 0x7fff;
+    }
+    symbols->reset = (uint32_t) half | ((uint32_t) half << 16);
+}
+
+void output_strip_encode(const output_strip_symbols_t *symbols, const uint8_t *data, size_t len,
+                         uint32_t *items) {
+    const uint32_t bit0 = symbols->bit0;
+    /* XOR mask that turns a bit0 item into a bit1 item, selected without branching */
+    const uint32_t flip = symbols->bit0 ^ symbols->bit1;
+    for (size_t i = 0; i < len; i++) {
+        uint32_t byte = data[i];
+        items[0] = bit0 ^ (flip & -((byte >> 7) & 1));
+        items[1] = bit0 ^ (flip & -((byte >> 6) & 1));
+        items[2] = bit0 ^ (flip & -((byte >> 5) & 1));
+        items[3] = bit0 ^ (flip & -((byte >> 4) & 1));
+        items[4] = bit0 ^ (flip & -((byte >> 3) & 1));
+        items[5] = bit0 ^ (flip & -((byte >> 2) & 1));
+        items[6] = bit0 ^ (flip & -((byte >> 1) & 1));
+        items[7] = bit0 ^ (flip & -(byte & 1));
+        items += OUTPUT_STRIP_ITEMS_PER_BYTE;
+    }
+}
@@ -0,0 +1,205 @@
+#include <string.h>
+#include "uart_frame.h"
+
+static const uint16_t s_crc16_nibble[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+    0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+};
+
+static const uint32_t s_crc32_nibble[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+};
+
+uint16_t uart_frame_crc16(uint16_t crc, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        crc = (crc << 4) ^ s_crc16_nibble[(crc >> 12) ^ (data[i] >> 4)];
+        crc = (crc << 4) ^ s_crc16_nibble[(crc >> 12) ^ (data[i] & 0x0f)];
+    }
+    return crc;
+}
+
+uint32_t uart_frame_crc32(uint32_t crc, const uint8_t *data, size_t len) {
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc = (crc >> 4) ^ s_crc32_nibble[(crc ^ data[i]) & 0x0f];
+        crc = (crc >> 4) ^ s_crc32_nibble[(crc ^ (data[i] >> 4)) & 0x0f];
+    }
+    return ~crc;
+}
+
+/* COBS encoder over a stream of pieces, writes straight into the output */
+typedef struct {
+    uint8_t *out;
+    size_t size;
+    size_t pos;
+    size_t code_pos;
+    uint8_t code;
+    bool overflow;
+} cobs_writer_t;
+
+static void cobs_start(cobs_writer_t *w, uint8_t *out, size_t size) {
+    w->out = out;
+    w->size = size;
+    w->code_pos = 0;
+    w->pos = 1;
+    w->code = 1;
+    w->overflow = size < 2;
+}
+
+static void cobs_put(cobs_writer_t *w, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len && !w->overflow; i++) {
+        if (data[i] == 0) {
+            w->out[w->code_pos] = w->code;
+            w->code_pos = w->pos++;
+            w->code = 1;
+        } else {
+            w->out[w->pos++] = data[i];
+            if (++w->code == 0xff) {
+                w->out[w->code_pos] = w->code;
+                w->code_pos = w->pos++;
+                w->code = 1;
+            }
+        }
+        /* pos is where the delimiter goes if this was the last byte, code
+         * bytes are always reserved behind it */
+        if (w->pos >= w->size) {
+            w->overflow = true;
+        }
+    }
+}
+
+static size_t cobs_finish(cobs_writer_t *w) {
+    if (w->overflow) {
+        return 0;
+    }
+    w->out[w->code_pos] = w->code;
+    w->out[w->pos++] = UART_FRAME_DELIMITER;
+    return w->pos;
+}
+
+size_t uart_frame_encode(uint8_t type, uint8_t seq, const uint8_t *payload, size_t len,
+                         uint8_t *out, size_t out_size) {
+    uint8_t header[UART_FRAME_HEADER_LEN] = { type, seq };
+    uint8_t crc[4];
+    size_t crc_len;
+    if (type & UART_FRAME_FLAG_CRC32) {
+        uint32_t value = uart_frame_crc32(uart_frame_crc32(0, header, sizeof(header)), payload, len);
+        crc[0] = value;
+        crc[1] = value >> 8;
+        crc[2] = value >> 16;
+        crc[3] = value >> 24;
+        crc_len = 4;
+    } else {
+        uint16_t value = uart_frame_crc16(uart_frame_crc16(0xffff, header, sizeof(header)), payload, len);
+        crc[0] = value;
+        crc[1] = value >> 8;
+        crc_len = 2;
+    }
+
+    cobs_writer_t w;
+    cobs_start(&w, out, out_size);
+    cobs_put(&w, header, sizeof(header));
+    cobs_put(&w, payload, len);
+    cobs_put(&w, crc, crc_len);
+    return cobs_finish(&w);
+}
+
+/* Decode in place, returns the decoded length or -1 on a malformed frame */
+static int cobs_decode(uint8_t *buf, size_t len) {
+    size_t in = 0;
+    size_t out = 0;
+    while (in < len) {
+        uint8_t code = buf[in++];
+        if (code == 0 || in + code - 1 > len) {
+            return -1;
+        }
+        for (uint8_t i = 1; i < code; i++) {
+            buf[out++] = buf[in++];
+        }
+        if (code != 0xff && in < len) {
+            buf[out++] = 0;
+        }
+    }
+    return out;
+}
+
+static void decoder_frame(uart_frame_decoder_t *decoder) {
+    int len = cobs_decode(decoder->buf, decoder->len);
+    if (len < UART_FRAME_HEADER_LEN + 2) {
+        decoder->stats.format_errors++;
+        return;
+    }
+    const uint8_t *buf = decoder->buf;
+    size_t crc_len = (buf[0] & UART_FRAME_FLAG_CRC32) ? 4 : 2;
+    if ((size_t) len < UART_FRAME_HEADER_LEN + crc_len) {
+        decoder->stats.format_errors++;
+        return;
+    }
+    size_t body = len - crc_len;
+    bool ok;
+    if (crc_len == 4) {
+        uint32_t crc = buf[body] | (buf[body + 1] << 8) | ((uint32_t) buf[body + 2] << 16) |
+                       ((uint32_t) buf[body + 3] << 24);
+        ok = uart_frame_crc32(0, buf, body) == crc;
+    } else {
+        uint16_t crc = buf[body] | (buf[body + 1] << 8);
+        ok = uart_frame_crc16(0xffff, buf, body) == crc;
+    }
+    if (!ok) {
+        decoder->stats.crc_errors++;
+        return;
+    }
+    decoder->stats.frames++;
+    decoder->cb(buf[0], buf[1], buf + UART_FRAME_HEADER_LEN, body - UART_FRAME_HEADER_LEN, decoder->ctx);
+}
+
+void uart_frame_decoder_init(uart_frame_decoder_t *decoder, uart_frame_cb_t cb, void *ctx) {
+    memset(decoder, 0, sizeof(*decoder));
+    decoder->cb = cb;
+    decoder->ctx = ctx;
+}
+
+void uart_frame_decoder_feed(uart_frame_decoder_t *decoder, const uint8_t *data, size_t len) {
+    const uint8_t *end = data + len;
+    while (data < end) {
+        const uint8_t *delim = memchr(data, UART_FRAME_DELIMITER, end - data);
+        size_t chunk = (delim ? delim : end) - data;
+        if (!decoder->overflow) {
+            if (decoder->len + chunk > sizeof(decoder->buf)) {
+                decoder->overflow = true;
+                decoder->stats.overflows++;
+            } else {
+                memcpy(decoder->buf + decoder->len, data, chunk);
+                decoder->len += chunk;
+            }
+        }
+        if (delim == NULL) {
+            break;
+        }
+        /* Back to back delimiters are idle fill, not frames */
+        if (!decoder->overflow && decoder->len) {
+            decoder_frame(decoder);
+        }
+        decoder->len = 0;
+        decoder->overflow = false;
+        data = delim + 1;
+    }
+}
+
+void uart_frame_batch_reset(uart_frame_batch_t *batch) {
+    batch->len = 0;
+    batch->count = 0;
+}
+
+bool uart_frame_batch_add(uart_frame_batch_t *batch, uint8_t id, const void *data, uint8_t len) {
+    if (batch->len + 2 + len > sizeof(batch->payload)) {
+        return false;
+    }
+    batch->payload[batch->len++] = id;
+    batch->payload[batch->len++] = len;
+    memcpy(batch->payload + batch->len, data, len);
+    batch->len += len;
+    batch->count++;
+    return true;
+}
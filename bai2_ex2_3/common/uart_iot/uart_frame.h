@@ -0,0 +1,69 @@
+#ifndef UART_FRAME_H
+#define UART_FRAME_H
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Binary telemetry framing: [type][seq][payload][crc] COBS encoded and ended by 0x00.
+ * CRC-16/CCITT-FALSE by default, CRC-32 when the type carries UART_FRAME_FLAG_CRC32;
+ * both are little endian and cover type, seq and payload. Pure C so the same
+ * decoder builds on the host side of the link. */
+
+#define UART_FRAME_DELIMITER        0x00
+#define UART_FRAME_TYPE_MASK        0x3f
+#define UART_FRAME_FLAG_CRC32       0x40
+#define UART_FRAME_FLAG_ACK_REQ     0x80
+
+#define UART_FRAME_TYPE_DATA        0x01
+#define UART_FRAME_TYPE_ACK         0x02
+
+#define UART_FRAME_HEADER_LEN       2
+#define UART_FRAME_CRC_MAX          4
+#define UART_FRAME_MAX_PAYLOAD      240
+#define UART_FRAME_RAW_MAX(payload_len) (UART_FRAME_HEADER_LEN + (payload_len) + UART_FRAME_CRC_MAX)
+/* Worst case COBS: the leading code byte, one more per 254 bytes, and the
+ * trailing delimiter. Sized for CRC-32, so it also covers CRC-16 frames. */
+#define UART_FRAME_ENCODED_MAX(payload_len) \
+    (UART_FRAME_RAW_MAX(payload_len) + UART_FRAME_RAW_MAX(payload_len) / 254 + 2)
+
+uint16_t uart_frame_crc16(uint16_t crc, const uint8_t *data, size_t len);
+uint32_t uart_frame_crc32(uint32_t crc, const uint8_t *data, size_t len);
+
+/* Returns the encoded length including the delimiter, 0 if out is too small */
+size_t uart_frame_encode(uint8_t type, uint8_t seq, const uint8_t *payload, size_t len,
+                         uint8_t *out, size_t out_size);
+
+typedef void (*uart_frame_cb_t) (uint8_t type, uint8_t seq, const uint8_t *payload, size_t len, void *ctx);
+
+typedef struct {
+    uint32_t frames;
+    uint32_t crc_errors;
+    uint32_t format_errors;     /* Bad COBS or too short */
+    uint32_t overflows;
+} uart_frame_stats_t;
+
+typedef struct {
+    uint8_t buf[UART_FRAME_ENCODED_MAX(UART_FRAME_MAX_PAYLOAD)];
+    size_t len;
+    bool overflow;
+    uart_frame_cb_t cb;
+    void *ctx;
+    uart_frame_stats_t stats;
+} uart_frame_decoder_t;
+
+void uart_frame_decoder_init(uart_frame_decoder_t *decoder, uart_frame_cb_t cb, void *ctx);
+/* Feed raw link bytes in chunks of any size, cb runs once per valid frame */
+void uart_frame_decoder_feed(uart_frame_decoder_t *decoder, const uint8_t *data, size_t len);
+
+/* Samples packed back to back as [id][len][bytes] inside one DATA payload */
+typedef struct {
+    uint8_t payload[UART_FRAME_MAX_PAYLOAD];
+    size_t len;
+    uint8_t count;
+} uart_frame_batch_t;
+
+void uart_frame_batch_reset(uart_frame_batch_t *batch);
+/* Returns false when the sample does not fit, flush the batch and add it again */
+bool uart_frame_batch_add(uart_frame_batch_t *batch, uint8_t id, const void *data, uint8_t len);
+
+#endif
@@ -1,43 +1,236 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <esp_log.h>
 #include <driver/gpio.h>
 #include "uart_iot.h"
 
-const char *TAG = "uart_events";
+static const char *TAG = "uart_iot";
 
-input_callback_t input_callback = NULL;
+struct uart_iot {
+    uart_port_t port;
+    QueueHandle_t queue;
+    TaskHandle_t task;
+    uart_iot_event_cb_t event_cb;
+    uart_iot_rx_cb_t rx_cb;
+    uint8_t *rx_slice;          /* Reused for every delivery, one spare byte for the terminator */
+    size_t rx_slice_size;
+    void *ctx;
+    uint8_t rx_thresh_min;
+    uint8_t rx_thresh_max;
+    portMUX_TYPE stats_lock;
+    uart_iot_stats_t stats;
+};
 
-QueueHandle_t uart0_queue;
+/* Full threshold interrupts mean the sender is streaming, so take more bytes
+ * per interrupt. An idle timeout or an overflow drops back to the floor. */
+static void uart_iot_rx_thresh_update(uart_iot_handle_t uart, uart_event_t *event) {
+    if (uart->rx_thresh_max == 0) {
+        return;
+    }
+    uint8_t thresh = uart->stats.rx_thresh;
+    if (event->type == UART_FIFO_OVF || (event->type == UART_DATA && event->timeout_flag)) {
+        thresh = uart->rx_thresh_min;
+    } else if (event->type == UART_DATA) {
+        thresh = thresh * 2 < uart->rx_thresh_max ? thresh * 2 : uart->rx_thresh_max;
+    }
+    if (thresh != uart->stats.rx_thresh && uart_set_rx_full_threshold(uart->port, thresh) == ESP_OK) {
+        uart->stats.rx_thresh = thresh;
+    }
+}
+
+static void uart_iot_account(uart_iot_handle_t uart, uart_event_t *event) {
+    UBaseType_t waiting = uxQueueMessagesWaiting(uart->queue) + 1;
+    portENTER_CRITICAL(&uart->stats_lock);
+    uart_iot_stats_t *stats = &uart->stats;
+    if (waiting > stats->queue_high_water) {
+        stats->queue_high_water = waiting;
+    }
+    switch (event->type) {
+        case UART_DATA:
+            stats->data_events++;
+            break;
+        case UART_FIFO_OVF:
+            stats->fifo_overflows++;
+            stats->lost_bytes += UART_FIFO_LEN;
+            break;
+        case UART_BUFFER_FULL:
+            stats->buffer_full++;
+            break;
+        case UART_FRAME_ERR:
+            stats->frame_errors++;
+            break;
+        case UART_PARITY_ERR:
+            stats->parity_errors++;
+            break;
+        case UART_BREAK:
+            stats->breaks++;
+            break;
+        default:
+            break;
+    }
+    portEXIT_CRITICAL(&uart->stats_lock);
+}
+
+static void uart_iot_rx_deliver(uart_iot_handle_t uart, size_t size) {
+    /* Everything already buffered goes out in as few slices as possible,
+     * later UART_DATA events for the same bytes then find nothing to read */
+    size_t buffered;
+    if (uart_get_buffered_data_len(uart->port, &buffered) == ESP_OK && buffered > size) {
+        size = buffered;
+    }
+    while (size > 0) {
+        size_t want = size < uart->rx_slice_size ? size : uart->rx_slice_size;
+        int len = uart_read_bytes(uart->port, uart->rx_slice, want, 0);
+        if (len <= 0) {
+            break;
+        }
+        uart->rx_slice[len] = 0;
+        portENTER_CRITICAL(&uart->stats_lock);
+        uart->stats.rx_bytes += len;
+        portEXIT_CRITICAL(&uart->stats_lock);
+        uart->rx_cb(uart, uart->rx_slice, len, uart->ctx);
+        size -= len;
+    }
+}
+
+static void uart_iot_task(void *pvParameters) {
+    uart_iot_handle_t uart = (uart_iot_handle_t) pvParameters;
+    uart_event_t event;
+    for (;;) {
+        //Waiting for UART event.
+        if (xQueueReceive(uart->queue, (void *) &event, (portTickType) portMAX_DELAY)) {
+            uart_iot_account(uart, &event);
+            uart_iot_rx_thresh_update(uart, &event);
+            if (event.type == UART_DATA && uart->rx_cb) {
+                uart_iot_rx_deliver(uart, event.size);
+                continue;
+            }
+            /* The driver stops reading the FIFO while the ring buffer is full,
+             * draining it is what lets reception carry on without loss */
+            if (event.type == UART_BUFFER_FULL && uart->rx_cb) {
+                uart_iot_rx_deliver(uart, 0);
+            }
+            if (uart->event_cb) {
+                uart->event_cb(uart, &event, uart->ctx);
+            }
+        }
+    }
+}
+
+esp_err_t uart_iot_create(const uart_iot_config_t *config, uart_iot_handle_t *ret_uart) {
+    if (config == NULL || ret_uart == NULL || (config->event_cb == NULL && config->rx_cb == NULL) ||
+        (config->rx_cb && config->rx_slice_size == 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uart_iot_handle_t uart = calloc(1, sizeof(struct uart_iot));
+    if (uart == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    uart->port = config->port;
+    uart->event_cb = config->event_cb;
+    uart->rx_cb = config->rx_cb;
+    uart->ctx = config->ctx;
+    portMUX_INITIALIZE(&uart->stats_lock);
+    if (config->rx_thresh_max) {
+        uart->rx_thresh_max = config->rx_thresh_max < UART_FIFO_LEN ? config->rx_thresh_max : UART_FIFO_LEN - 1;
+        /* Past the RTS level the sender is already held off before the ISR runs */
+        if (config->flow_ctrl == UART_IOT_FLOW_HW && uart->rx_thresh_max >= config->rx_flow_thresh) {
+            uart->rx_thresh_max = config->rx_flow_thresh - 1;
+        }
+        uart->rx_thresh_min = config->rx_thresh_min ? config->rx_thresh_min : 1;
+        if (uart->rx_thresh_min > uart->rx_thresh_max) {
+            uart->rx_thresh_min = uart->rx_thresh_max;
+        }
+    }
+    if (uart->rx_cb) {
+        uart->rx_slice_size = config->rx_slice_size;
+        uart->rx_slice = malloc(uart->rx_slice_size + 1);
+        if (uart->rx_slice == NULL) {
+            free(uart);
+            return ESP_ERR_NO_MEM;
+        }
+    }
 
-void uart_create(uart_port_t uart_num) {
     /* Configure parameters of an UART driver,
      * communication pins and install the driver */
     uart_config_t uart_config = {
-        .baud_rate = 115200,
+        .baud_rate = config->baud_rate,
         .data_bits = UART_DATA_8_BITS,
         .parity = UART_PARITY_DISABLE,
         .stop_bits = UART_STOP_BITS_1,
-        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .flow_ctrl = config->flow_ctrl == UART_IOT_FLOW_HW ? UART_HW_FLOWCTRL_CTS_RTS : UART_HW_FLOWCTRL_DISABLE,
+        .rx_flow_ctrl_thresh = config->rx_flow_thresh,
         .source_clk = UART_SCLK_APB,
     };
     //Install UART driver, and get the queue.
-    uart_driver_install(uart_num, BUF_SIZE * 2, BUF_SIZE * 2, 20, &uart0_queue, 0);
-    uart_param_config(uart_num, &uart_config);
-
-    //Set UART log level
-    esp_log_level_set(TAG, ESP_LOG_INFO);
-    //Set UART pins (using UART0 default pins ie no changes.)
-    uart_set_pin(uart_num, 1, 3, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    esp_err_t err = uart_driver_install(uart->port, config->rx_buffer_size, config->tx_buffer_size,
+                                        config->event_queue_size, &uart->queue, 0);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "UART%d driver install failed: %s", uart->port, esp_err_to_name(err));
+        free(uart->rx_slice);
+        free(uart);
+        return err;
+    }
+    uart_param_config(uart->port, &uart_config);
+    uart_set_pin(uart->port, config->tx_pin, config->rx_pin, config->rts_pin, config->cts_pin);
+    if (config->flow_ctrl == UART_IOT_FLOW_SW) {
+        uart_set_sw_flow_ctrl(uart->port, true, config->rx_xon_thresh, config->rx_flow_thresh);
+    }
+    if (uart->rx_thresh_max) {
+        uart_set_rx_full_threshold(uart->port, uart->rx_thresh_min);
+        uart->stats.rx_thresh = uart->rx_thresh_min;
+    }
 
-    //Set uart pattern detect function.
-    uart_enable_pattern_det_baud_intr(uart_num, '+', PATTERN_CHR_NUM, 9, 0, 0);
-    //Reset the pattern queue length to record at most 20 pattern positions.
-    uart_pattern_queue_reset(uart_num, 20);
+    if (config->pattern_chr_num) {
+        //Set uart pattern detect function.
+        uart_enable_pattern_det_baud_intr(uart->port, config->pattern_chr, config->pattern_chr_num, 9, 0, 0);
+        //Reset the pattern queue length to record at most pattern_queue_size pattern positions.
+        uart_pattern_queue_reset(uart->port, config->pattern_queue_size);
+    }
 
     //Create a task to handler UART event from ISR
-    xTaskCreate(input_callback, "uart_event_task", 2048, NULL, 12, NULL);
+    char name[configMAX_TASK_NAME_LEN];
+    snprintf(name, sizeof(name), "uart%d_event", uart->port);
+    if (xTaskCreatePinnedToCore(uart_iot_task, name, config->task_stack, uart,
+                                config->task_priority, &uart->task, config->task_core) != pdPASS) {
+        uart_driver_delete(uart->port);
+        free(uart->rx_slice);
+        free(uart);
+        return ESP_ERR_NO_MEM;
+    }
+    *ret_uart = uart;
+    return ESP_OK;
 }
 
-void uart_set_callback(void *cb) {
-    input_callback = cb;
-}
\ No newline at end of file
+esp_err_t uart_iot_delete(uart_iot_handle_t uart) {
+    if (uart == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    vTaskDelete(uart->task);
+    uart_driver_delete(uart->port);
+    free(uart->rx_slice);
+    free(uart);
+    return ESP_OK;
+}
+
+uart_port_t uart_iot_get_port(uart_iot_handle_t uart) {
+    return uart->port;
+}
+
+QueueHandle_t uart_iot_get_queue(uart_iot_handle_t uart) {
+    return uart->queue;
+}
+
+void uart_iot_get_stats(uart_iot_handle_t uart, uart_iot_stats_t *stats) {
+    portENTER_CRITICAL(&uart->stats_lock);
+    *stats = uart->stats;
+    portEXIT_CRITICAL(&uart->stats_lock);
+}
+
+void uart_iot_reset_stats(uart_iot_handle_t uart) {
+    portENTER_CRITICAL(&uart->stats_lock);
+    uint8_t rx_thresh = uart->stats.rx_thresh;
+    memset(&uart->stats, 0, sizeof(uart->stats));
+    uart->stats.rx_thresh = rx_thresh;
+    portEXIT_CRITICAL(&uart->stats_lock);
+}
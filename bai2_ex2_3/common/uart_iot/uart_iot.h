@@ -9,15 +9,99 @@
 #include "driver/uart.h"
 #include "esp_log.h"
 
-#define EX_UART_NUM UART_NUM_0
-#define PATTERN_CHR_NUM    (3)         /*!< Set the number of consecutive and identical characters received by receiver which defines a UART pattern*/
+#define UART_IOT_BUF_SIZE   (1024)
 
-#define BUF_SIZE (1024)
-#define RD_BUF_SIZE (BUF_SIZE)
+typedef struct uart_iot *uart_iot_handle_t;
 
-typedef void (*input_callback_t) (void*);
+typedef enum {
+    UART_IOT_FLOW_NONE,
+    UART_IOT_FLOW_HW,           /* RTS/CTS, needs rts_pin and cts_pin */
+    UART_IOT_FLOW_SW,           /* XON/XOFF in band */
+} uart_iot_flow_t;
 
-void uart_create(uart_port_t uart_num);
-void uart_set_callback(void *cb);
+/* Receive side counters. FIFO overflows are the only real loss: the driver
+ * resets the hardware FIFO, so lost_bytes counts its full contents per event.
+ * A full ring buffer only stalls the FIFO until the port task reads again. */
+typedef struct {
+    uint32_t rx_bytes;
+    uint32_t data_events;
+    uint32_t fifo_overflows;
+    uint32_t buffer_full;
+    uint32_t lost_bytes;
+    uint32_t frame_errors;
+    uint32_t parity_errors;
+    uint32_t breaks;
+    uint32_t queue_high_water;  /* Most events ever waiting in the queue */
+    uint8_t rx_thresh;          /* Current RX FIFO full threshold */
+} uart_iot_stats_t;
 
-#endif
\ No newline at end of file
+/* Called from the port's own task for every event the driver posts */
+typedef void (*uart_iot_event_cb_t) (uart_iot_handle_t uart, uart_event_t *event, void *ctx);
+/* Received bytes, borrowed from the port until the callback returns. data[len] is always 0. */
+typedef void (*uart_iot_rx_cb_t) (uart_iot_handle_t uart, const uint8_t *data, size_t len, void *ctx);
+
+typedef struct {
+    uart_port_t port;
+    int baud_rate;
+    int tx_pin;
+    int rx_pin;
+    int rts_pin;
+    int cts_pin;
+    int rx_buffer_size;
+    int tx_buffer_size;
+    int event_queue_size;
+    char pattern_chr;           /* Hardware pattern detect character */
+    uint8_t pattern_chr_num;    /* Repeats that make a pattern, 0 disables detection */
+    int pattern_queue_size;
+    uint32_t task_stack;
+    UBaseType_t task_priority;
+    BaseType_t task_core;       /* Core the port task is pinned to, or tskNO_AFFINITY */
+    uart_iot_flow_t flow_ctrl;
+    uint8_t rx_flow_thresh;     /* FIFO level that deasserts RTS or sends XOFF */
+    uint8_t rx_xon_thresh;      /* FIFO level that sends XON again */
+    /* RX FIFO full threshold follows the load between these two, rising while
+     * data arrives back to back and falling on idle timeouts. 0 keeps the
+     * driver default. */
+    uint8_t rx_thresh_min;
+    uint8_t rx_thresh_max;
+    uart_iot_event_cb_t event_cb;
+    uart_iot_rx_cb_t rx_cb;     /* Takes over UART_DATA events when set */
+    size_t rx_slice_size;       /* Largest slice handed to rx_cb */
+    void *ctx;
+} uart_iot_config_t;
+
+#define UART_IOT_CONFIG_DEFAULT(uart_port) {    \
+    .port = uart_port,                          \
+    .baud_rate = 115200,                        \
+    .tx_pin = UART_PIN_NO_CHANGE,               \
+    .rx_pin = UART_PIN_NO_CHANGE,               \
+    .rts_pin = UART_PIN_NO_CHANGE,              \
+    .cts_pin = UART_PIN_NO_CHANGE,              \
+    .rx_buffer_size = UART_IOT_BUF_SIZE * 2,    \
+    .tx_buffer_size = UART_IOT_BUF_SIZE * 2,    \
+    .event_queue_size = 20,                     \
+    .pattern_chr = 0,                           \
+    .pattern_chr_num = 0,                       \
+    .pattern_queue_size = 20,                   \
+    .task_stack = 2048,                         \
+    .task_priority = 12,                        \
+    .task_core = tskNO_AFFINITY,                \
+    .flow_ctrl = UART_IOT_FLOW_NONE,            \
+    .rx_flow_thresh = 122,                      \
+    .rx_xon_thresh = 64,                        \
+    .rx_thresh_min = 0,                         \
+    .rx_thresh_max = 0,                         \
+    .event_cb = NULL,                           \
+    .rx_cb = NULL,                              \
+    .rx_slice_size = UART_IOT_BUF_SIZE,         \
+    .ctx = NULL,                                \
+}
+
+esp_err_t uart_iot_create(const uart_iot_config_t *config, uart_iot_handle_t *ret_uart);
+esp_err_t uart_iot_delete(uart_iot_handle_t uart);
+uart_port_t uart_iot_get_port(uart_iot_handle_t uart);
+QueueHandle_t uart_iot_get_queue(uart_iot_handle_t uart);
+void uart_iot_get_stats(uart_iot_handle_t uart, uart_iot_stats_t *stats);
+void uart_iot_reset_stats(uart_iot_handle_t uart);
+
+#endif
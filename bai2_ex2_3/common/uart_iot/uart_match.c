@@ -0,0 +1,107 @@
+#include <string.h>
+#include "uart_match.h"
+
+#define NO_STATE    0xff
+
+bool uart_match_init(uart_match_t *match, const uart_match_pattern_t *patterns, size_t count,
+                     uart_match_cb_t cb, void *ctx) {
+    if (count == 0 || count > UART_MATCH_MAX_PATTERNS) {
+        return false;
+    }
+    memset(match, 0, sizeof(*match));
+    match->cb = cb;
+    match->ctx = ctx;
+
+    /* Alphabet compression: one class per distinct pattern byte */
+    int classes = 1;
+    for (size_t p = 0; p < count; p++) {
+        if (patterns[p].len == 0 || patterns[p].len > 0xff) {
+            return false;
+        }
+        for (size_t i = 0; i < patterns[p].len; i++) {
+            uint8_t b = patterns[p].bytes[i];
+            if (match->byte_class[b] == 0) {
+                if (classes == UART_MATCH_MAX_CLASSES) {
+                    return false;
+                }
+                match->byte_class[b] = classes++;
+            }
+        }
+    }
+
+    /* Trie, unused edges stay NO_STATE until the DFA fill below */
+    memset(match->next, NO_STATE, sizeof(match->next));
+    int states = 1;
+    for (size_t p = 0; p < count; p++) {
+        int s = 0;
+        for (size_t i = 0; i < patterns[p].len; i++) {
+            uint8_t c = match->byte_class[(uint8_t) patterns[p].bytes[i]];
+            if (match->next[s][c] == NO_STATE) {
+                if (states == UART_MATCH_MAX_STATES) {
+                    return false;
+                }
+                match->next[s][c] = states++;
+            }
+            s = match->next[s][c];
+        }
+        match->out[s] |= 1 << p;
+        match->pattern_len[p] = patterns[p].len;
+    }
+
+    /* Breadth first, so every failure state is complete before it is used */
+    uint8_t fail[UART_MATCH_MAX_STATES];
+    uint8_t queue[UART_MATCH_MAX_STATES];
+    int head = 0;
+    int tail = 0;
+    for (int c = 0; c < classes; c++) {
+        uint8_t t = match->next[0][c];
+        if (t == NO_STATE) {
+            match->next[0][c] = 0;
+        } else {
+            fail[t] = 0;
+            queue[tail++] = t;
+        }
+    }
+    while (head < tail) {
+        uint8_t s = queue[head++];
+        match->out[s] |= match->out[fail[s]];
+        for (int c = 0; c < classes; c++) {
+            uint8_t t = match->next[s][c];
+            if (t == NO_STATE) {
+                match->next[s][c] = match->next[fail[s]][c];
+            } else {
+                fail[t] = match->next[fail[s]][c];
+                queue[tail++] = t;
+            }
+        }
+    }
+    return true;
+}
+
+void uart_match_reset(uart_match_t *match) {
+    match->state = 0;
+    match->offset = 0;
+}
+
+size_t uart_match_feed(uart_match_t *match, const uint8_t *data, size_t len) {
+    size_t found = 0;
+    uint8_t s = match->state;
+    for (size_t i = 0; i < len; i++) {
+        s = match->next[s][match->byte_class[data[i]]];
+        if (match->out[s] == 0) {
+            continue;
+        }
+        uint32_t end = match->offset + i + 1;
+        for (uint8_t bits = match->out[s], p = 0; bits; bits >>= 1, p++) {
+            if (bits & 1) {
+                found++;
+                if (match->cb) {
+                    match->cb(p, end - match->pattern_len[p], match->ctx);
+                }
+            }
+        }
+    }
+    match->state = s;
+    match->offset += len;
+    return found;
+}
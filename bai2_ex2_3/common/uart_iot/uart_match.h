@@ -0,0 +1,43 @@
+#ifndef UART_MATCH_H
+#define UART_MATCH_H
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Aho-Corasick matcher over a byte stream, fed in chunks of any size.
+ * Patterns are compiled into a full DFA over byte classes (bytes that occur
+ * in no pattern share class 0), so each input byte costs one table lookup
+ * and nothing is ever rescanned. Matches that overlap or span chunk
+ * boundaries are all reported. */
+
+#define UART_MATCH_MAX_PATTERNS     8
+#define UART_MATCH_MAX_STATES       64
+#define UART_MATCH_MAX_CLASSES      32
+
+typedef struct {
+    const char *bytes;
+    size_t len;                 /* Explicit so patterns may contain 0x00 */
+} uart_match_pattern_t;
+
+/* offset is where the match starts, counted in bytes since the last reset */
+typedef void (*uart_match_cb_t) (int pattern, uint32_t offset, void *ctx);
+
+typedef struct {
+    uint8_t byte_class[256];
+    uint8_t next[UART_MATCH_MAX_STATES][UART_MATCH_MAX_CLASSES];
+    uint8_t out[UART_MATCH_MAX_STATES];     /* Bit per pattern ending in this state */
+    uint8_t pattern_len[UART_MATCH_MAX_PATTERNS];
+    uint8_t state;
+    uint32_t offset;
+    uart_match_cb_t cb;
+    void *ctx;
+} uart_match_t;
+
+/* Returns false when the patterns need more states or classes than the limits */
+bool uart_match_init(uart_match_t *match, const uart_match_pattern_t *patterns, size_t count,
+                     uart_match_cb_t cb, void *ctx);
+void uart_match_reset(uart_match_t *match);
+/* Returns the number of matches reported for this chunk */
+size_t uart_match_feed(uart_match_t *match, const uint8_t *data, size_t len);
+
+#endif
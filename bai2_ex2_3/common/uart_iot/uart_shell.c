@@ -0,0 +1,133 @@
+#include <string.h>
+#include "uart_shell.h"
+
+/* FNV-1a */
+static uint32_t shell_hash(const char *name, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint8_t) name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static int shell_lookup(const uart_shell_t *shell, const char *name, size_t len, uint32_t hash) {
+    for (uint32_t probe = 0; probe < UART_SHELL_SLOTS; probe++) {
+        uint8_t slot = shell->slots[(hash + probe) & (UART_SHELL_SLOTS - 1)];
+        if (slot == 0) {
+            return -1;
+        }
+        int index = slot - 1;
+        const char *candidate = shell->commands[index].name;
+        if (shell->hashes[index] == hash && strlen(candidate) == len && memcmp(candidate, name, len) == 0) {
+            return index;
+        }
+    }
+    return -1;
+}
+
+bool uart_shell_init(uart_shell_t *shell, const uart_shell_command_t *commands, size_t count) {
+    memset(shell, 0, sizeof(*shell));
+    if (count > UART_SHELL_MAX_COMMANDS) {
+        return false;
+    }
+    shell->commands = commands;
+    for (size_t i = 0; i < count; i++) {
+        size_t len = strlen(commands[i].name);
+        uint32_t hash = shell_hash(commands[i].name, len);
+        if (shell_lookup(shell, commands[i].name, len, hash) >= 0) {
+            return false;
+        }
+        shell->hashes[i] = hash;
+        uint32_t probe = hash;
+        while (shell->slots[probe & (UART_SHELL_SLOTS - 1)]) {
+            probe++;
+        }
+        shell->slots[probe & (UART_SHELL_SLOTS - 1)] = i + 1;
+        shell->command_count = i + 1;
+    }
+    return true;
+}
+
+bool uart_shell_dispatch(uart_shell_t *shell, const char *line, size_t len) {
+    while (len && (*line == ' ' || *line == '\t')) {
+        line++;
+        len--;
+    }
+    size_t name_len = 0;
+    while (name_len < len && line[name_len] != '=' && line[name_len] != ' ') {
+        name_len++;
+    }
+    shell->stats.lines++;
+    int index = shell_lookup(shell, line, name_len, shell_hash(line, name_len));
+    if (index < 0) {
+        shell->stats.unknown++;
+        return false;
+    }
+    size_t skip = name_len < len ? name_len + 1 : name_len;
+    shell->commands[index].handler(line + skip, len - skip, shell->commands[index].ctx);
+    return true;
+}
+
+void uart_shell_feed(uart_shell_t *shell, const uint8_t *data, size_t len) {
+    const char *p = (const char *) data;
+    const char *end = p + len;
+    while (p < end) {
+        const char *eol = p;
+        while (eol < end && *eol != '\n' && *eol != '\r') {
+            eol++;
+        }
+        size_t chunk = eol - p;
+
+        if (shell->discarding) {
+            /* Drop the rest of an oversized line */
+        } else if (shell->line_len == 0 && eol < end) {
+            /* Whole line inside this chunk, dispatch straight from the caller's data */
+            if (chunk) {
+                uart_shell_dispatch(shell, p, chunk);
+            }
+        } else if (shell->line_len + chunk > UART_SHELL_LINE_MAX) {
+            shell->discarding = true;
+            shell->line_len = 0;
+            shell->stats.overflows++;
+        } else {
+            memcpy(shell->line + shell->line_len, p, chunk);
+            shell->line_len += chunk;
+            if (eol < end) {
+                uart_shell_dispatch(shell, shell->line, shell->line_len);
+                shell->line_len = 0;
+            }
+        }
+
+        if (eol == end) {
+            break;
+        }
+        /* Terminator seen: \r, \n and \r\n all end the line, empty lines are skipped */
+        shell->discarding = false;
+        p = eol + 1;
+    }
+}
+
+bool uart_shell_parse_int(const char *args, size_t len, int *value) {
+    size_t i = 0;
+    bool negative = false;
+    int result = 0;
+    if (i < len && (args[i] == '-' || args[i] == '+')) {
+        negative = args[i] == '-';
+        i++;
+    }
+    if (i == len) {
+        return false;
+    }
+    for (; i < len; i++) {
+        if (args[i] < '0' || args[i] > '9') {
+            return false;
+        }
+        if (result > (0x7fffffff - (args[i] - '0')) / 10) {
+            return false;
+        }
+        result = result * 10 + (args[i] - '0');
+    }
+    *value = negative ? -result : result;
+    return true;
+}
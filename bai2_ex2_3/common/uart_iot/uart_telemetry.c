@@ -0,0 +1,162 @@
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "uart_telemetry.h"
+
+static const char *TAG = "uart_telemetry";
+
+struct uart_telemetry {
+    uart_tx_handle_t tx_queue;
+    uint8_t producer;
+    uart_telemetry_config_t config;
+    SemaphoreHandle_t lock;     /* Batch, sequence and tx buffer */
+    SemaphoreHandle_t acked;
+    uart_frame_batch_t batch;
+    uart_frame_decoder_t decoder;
+    uint8_t seq;
+    volatile int ack_wait;      /* Sequence being waited on, -1 for none */
+    uart_telemetry_stats_t stats;
+    uint8_t tx[UART_FRAME_ENCODED_MAX(UART_FRAME_MAX_PAYLOAD)];
+};
+
+static void uart_telemetry_frame(uint8_t type, uint8_t seq, const uint8_t *payload, size_t len, void *ctx) {
+    uart_telemetry_handle_t telemetry = ctx;
+    if ((type & UART_FRAME_TYPE_MASK) == UART_FRAME_TYPE_ACK && telemetry->ack_wait == seq) {
+        telemetry->ack_wait = -1;
+        xSemaphoreGive(telemetry->acked);
+    }
+}
+
+esp_err_t uart_telemetry_create(uart_tx_handle_t tx, uint8_t producer, const uart_telemetry_config_t *config,
+                                uart_telemetry_handle_t *ret_telemetry) {
+    if (tx == NULL || producer >= UART_TX_MAX_PRODUCERS || config == NULL || ret_telemetry == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uart_telemetry_handle_t telemetry = calloc(1, sizeof(struct uart_telemetry));
+    if (telemetry == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    telemetry->lock = xSemaphoreCreateMutex();
+    telemetry->acked = xSemaphoreCreateBinary();
+    if (telemetry->lock == NULL || telemetry->acked == NULL) {
+        uart_telemetry_delete(telemetry);
+        return ESP_ERR_NO_MEM;
+    }
+    telemetry->tx_queue = tx;
+    telemetry->producer = producer;
+    telemetry->config = *config;
+    telemetry->ack_wait = -1;
+    uart_frame_batch_reset(&telemetry->batch);
+    uart_frame_decoder_init(&telemetry->decoder, uart_telemetry_frame, telemetry);
+    *ret_telemetry = telemetry;
+    return ESP_OK;
+}
+
+void uart_telemetry_delete(uart_telemetry_handle_t telemetry) {
+    if (telemetry == NULL) {
+        return;
+    }
+    if (telemetry->lock) {
+        vSemaphoreDelete(telemetry->lock);
+    }
+    if (telemetry->acked) {
+        vSemaphoreDelete(telemetry->acked);
+    }
+    free(telemetry);
+}
+
+/* Caller holds the lock */
+static esp_err_t uart_telemetry_send(uart_telemetry_handle_t telemetry, bool ack) {
+    if (telemetry->batch.count == 0) {
+        return ESP_OK;
+    }
+    uint8_t type = UART_FRAME_TYPE_DATA;
+    if (telemetry->config.crc32) {
+        type |= UART_FRAME_FLAG_CRC32;
+    }
+    if (ack) {
+        type |= UART_FRAME_FLAG_ACK_REQ;
+    }
+    uint8_t seq = telemetry->seq;
+    size_t len = uart_frame_encode(type, seq, telemetry->batch.payload, telemetry->batch.len,
+                                   telemetry->tx, sizeof(telemetry->tx));
+    if (len == 0) {
+        /* Can't happen with tx sized by UART_FRAME_ENCODED_MAX. If it does,
+         * the batch would never encode, so it is dropped rather than kept. */
+        telemetry->stats.encode_errors++;
+        telemetry->stats.dropped += telemetry->batch.count;
+        uart_frame_batch_reset(&telemetry->batch);
+        ESP_LOGE(TAG, "Frame %u does not fit, batch dropped", seq);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    uint32_t count = telemetry->batch.count;
+    telemetry->seq++;
+    uart_frame_batch_reset(&telemetry->batch);
+
+    if (!ack) {
+        esp_err_t err = uart_tx_write(telemetry->tx_queue, telemetry->producer, telemetry->tx, len);
+        if (err != ESP_OK) {
+            /* The queue refused the whole frame, nothing of it went out */
+            telemetry->stats.dropped += count;
+            return err;
+        }
+        telemetry->stats.frames++;
+        telemetry->stats.samples += count;
+        return ESP_OK;
+    }
+    telemetry->stats.frames++;
+    telemetry->stats.samples += count;
+    /* Stale gives from a late ack of an earlier frame must not count */
+    xSemaphoreTake(telemetry->acked, 0);
+    telemetry->ack_wait = seq;
+    for (int attempt = 0; attempt <= telemetry->config.retries; attempt++) {
+        if (attempt) {
+            telemetry->stats.retransmits++;
+        }
+        /* A full queue is waited out like a lost frame, the timeout doubles as backoff */
+        uart_tx_write(telemetry->tx_queue, telemetry->producer, telemetry->tx, len);
+        if (xSemaphoreTake(telemetry->acked, telemetry->config.ack_timeout_ms / portTICK_RATE_MS) == pdTRUE) {
+            return ESP_OK;
+        }
+    }
+    telemetry->ack_wait = -1;
+    telemetry->stats.ack_failures++;
+    ESP_LOGW(TAG, "No ack for frame %u", seq);
+    return ESP_ERR_TIMEOUT;
+}
+
+esp_err_t uart_telemetry_add(uart_telemetry_handle_t telemetry, uint8_t id, const void *data, uint8_t len) {
+    if (len > UART_FRAME_MAX_PAYLOAD - 2) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(telemetry->lock, portMAX_DELAY);
+    if (!uart_frame_batch_add(&telemetry->batch, id, data, len)) {
+        err = uart_telemetry_send(telemetry, false);
+        if (err == ESP_OK && !uart_frame_batch_add(&telemetry->batch, id, data, len)) {
+            err = ESP_ERR_NO_MEM;
+        }
+        if (err != ESP_OK) {
+            telemetry->stats.dropped++;
+        }
+    }
+    xSemaphoreGive(telemetry->lock);
+    return err;
+}
+
+esp_err_t uart_telemetry_flush(uart_telemetry_handle_t telemetry, bool ack) {
+    xSemaphoreTake(telemetry->lock, portMAX_DELAY);
+    esp_err_t err = uart_telemetry_send(telemetry, ack);
+    xSemaphoreGive(telemetry->lock);
+    return err;
+}
+
+void uart_telemetry_feed(uart_telemetry_handle_t telemetry, const uint8_t *data, size_t len) {
+    uart_frame_decoder_feed(&telemetry->decoder, data, len);
+}
+
+void uart_telemetry_get_stats(uart_telemetry_handle_t telemetry, uart_telemetry_stats_t *stats) {
+    xSemaphoreTake(telemetry->lock, portMAX_DELAY);
+    *stats = telemetry->stats;
+    xSemaphoreGive(telemetry->lock);
+}
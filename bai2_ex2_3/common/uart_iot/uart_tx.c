@@ -0,0 +1,254 @@
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "uart_tx.h"
+
+typedef struct {
+    uint32_t seq;               /* Slot is free when seq == position, filled when position + 1 */
+    uint8_t len;                /* Inline bytes, 0 marks a reference */
+    const uint8_t *ref;
+    size_t ref_len;
+    uart_tx_done_cb_t done_cb;
+    void *ctx;
+    uint8_t data[UART_TX_SLOT_DATA];
+} uart_tx_slot_t;
+
+struct uart_tx {
+    uart_port_t port;
+    uart_tx_slot_t *slots;
+    uint32_t mask;
+    uint32_t tail;              /* Claimed by producers with compare and swap */
+    uint32_t head;              /* Only the worker moves it */
+    uint32_t waiting;           /* Worker is about to sleep, the next producer wakes it */
+    TaskHandle_t task;
+    TickType_t flush_ticks;
+    TickType_t deadline;        /* When the oldest buffered byte must go out */
+    uint8_t *buf;
+    size_t buf_size;
+    size_t buf_len;
+    uart_tx_stats_t stats;
+};
+
+/* Bounded multi producer queue: each slot carries its own sequence number,
+ * so producers only contend on the tail and never wait on each other. A write
+ * claims all its slots with one compare and swap, so its bytes stay together
+ * in the queue. The worker frees slots in order, so once the last one is free
+ * the ones before it are too. */
+static bool uart_tx_claim(uart_tx_handle_t tx, uint32_t count, uint32_t *ret_pos) {
+    uint32_t pos = __atomic_load_n(&tx->tail, __ATOMIC_RELAXED);
+    for (;;) {
+        uart_tx_slot_t *last = &tx->slots[(pos + count - 1) & tx->mask];
+        int32_t diff = (int32_t) (__atomic_load_n(&last->seq, __ATOMIC_ACQUIRE) - (pos + count - 1));
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&tx->tail, &pos, pos + count, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                *ret_pos = pos;
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = __atomic_load_n(&tx->tail, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+static void uart_tx_publish(uart_tx_handle_t tx, uint32_t pos, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        __atomic_store_n(&tx->slots[(pos + i) & tx->mask].seq, pos + i + 1, __ATOMIC_RELEASE);
+    }
+    /* The worker may already be past these slots, which reads as negative */
+    int32_t used = (int32_t) (pos + count - __atomic_load_n(&tx->head, __ATOMIC_RELAXED));
+    uint32_t high = __atomic_load_n(&tx->stats.high_water, __ATOMIC_RELAXED);
+    while (used > (int32_t) high &&
+           !__atomic_compare_exchange_n(&tx->stats.high_water, &high, used, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+static void uart_tx_wake(uart_tx_handle_t tx) {
+    if (__atomic_exchange_n(&tx->waiting, 0, __ATOMIC_SEQ_CST)) {
+        xTaskNotifyGive(tx->task);
+    }
+}
+
+esp_err_t uart_tx_write(uart_tx_handle_t tx, uint8_t producer, const void *data, size_t len) {
+    if (producer >= UART_TX_MAX_PRODUCERS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (len == 0) {
+        return ESP_OK;
+    }
+    size_t count = (len + UART_TX_SLOT_DATA - 1) / UART_TX_SLOT_DATA;
+    uint32_t pos;
+    if (count > tx->mask + 1) {
+        __atomic_fetch_add(&tx->stats.dropped[producer], len, __ATOMIC_RELAXED);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (!uart_tx_claim(tx, count, &pos)) {
+        __atomic_fetch_add(&tx->stats.dropped[producer], len, __ATOMIC_RELAXED);
+        return ESP_ERR_NO_MEM;
+    }
+    const uint8_t *src = data;
+    size_t left = len;
+    for (size_t i = 0; i < count; i++) {
+        uart_tx_slot_t *slot = &tx->slots[(pos + i) & tx->mask];
+        size_t chunk = left < UART_TX_SLOT_DATA ? left : UART_TX_SLOT_DATA;
+        memcpy(slot->data, src, chunk);
+        slot->len = chunk;
+        src += chunk;
+        left -= chunk;
+    }
+    uart_tx_publish(tx, pos, count);
+    __atomic_fetch_add(&tx->stats.bytes[producer], len, __ATOMIC_RELAXED);
+    uart_tx_wake(tx);
+    return ESP_OK;
+}
+
+esp_err_t uart_tx_write_ref(uart_tx_handle_t tx, uint8_t producer, const void *data, size_t len,
+                            uart_tx_done_cb_t done_cb, void *ctx) {
+    if (producer >= UART_TX_MAX_PRODUCERS || len == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint32_t pos;
+    if (!uart_tx_claim(tx, 1, &pos)) {
+        __atomic_fetch_add(&tx->stats.dropped[producer], len, __ATOMIC_RELAXED);
+        return ESP_ERR_NO_MEM;
+    }
+    uart_tx_slot_t *slot = &tx->slots[pos & tx->mask];
+    slot->len = 0;
+    slot->ref = data;
+    slot->ref_len = len;
+    slot->done_cb = done_cb;
+    slot->ctx = ctx;
+    uart_tx_publish(tx, pos, 1);
+    __atomic_fetch_add(&tx->stats.bytes[producer], len, __ATOMIC_RELAXED);
+    uart_tx_wake(tx);
+    return ESP_OK;
+}
+
+static void uart_tx_flush(uart_tx_handle_t tx) {
+    if (tx->buf_len) {
+        uart_write_bytes(tx->port, (const char *) tx->buf, tx->buf_len);
+        tx->buf_len = 0;
+        __atomic_fetch_add(&tx->stats.writes, 1, __ATOMIC_RELAXED);
+    }
+}
+
+static bool uart_tx_pending(uart_tx_handle_t tx) {
+    uart_tx_slot_t *slot = &tx->slots[tx->head & tx->mask];
+    return __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) == tx->head + 1;
+}
+
+static void uart_tx_drain(uart_tx_handle_t tx) {
+    while (uart_tx_pending(tx)) {
+        uart_tx_slot_t *slot = &tx->slots[tx->head & tx->mask];
+        if (slot->len) {
+            if (tx->buf_len + slot->len > tx->buf_size) {
+                uart_tx_flush(tx);
+            }
+            if (tx->buf_len == 0) {
+                tx->deadline = xTaskGetTickCount() + tx->flush_ticks;
+            }
+            memcpy(tx->buf + tx->buf_len, slot->data, slot->len);
+            tx->buf_len += slot->len;
+        } else {
+            /* Keep byte order, then send the referenced buffer as is */
+            uart_tx_flush(tx);
+            uart_write_bytes(tx->port, (const char *) slot->ref, slot->ref_len);
+            __atomic_fetch_add(&tx->stats.writes, 1, __ATOMIC_RELAXED);
+            if (slot->done_cb) {
+                slot->done_cb(slot->ref, slot->ref_len, slot->ctx);
+            }
+        }
+        /* head first: a producer that sees the slot free also sees it consumed */
+        uint32_t head = tx->head;
+        __atomic_store_n(&tx->head, head + 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&slot->seq, head + tx->mask + 1, __ATOMIC_RELEASE);
+    }
+}
+
+static void uart_tx_task(void *pvParameters) {
+    uart_tx_handle_t tx = (uart_tx_handle_t) pvParameters;
+    for (;;) {
+        uart_tx_drain(tx);
+        TickType_t timeout = portMAX_DELAY;
+        if (tx->buf_len >= tx->buf_size) {
+            uart_tx_flush(tx);
+            continue;
+        }
+        if (tx->buf_len) {
+            TickType_t left = tx->deadline - xTaskGetTickCount();
+            if ((int32_t) left <= 0) {
+                uart_tx_flush(tx);
+                continue;
+            }
+            timeout = left;
+        }
+        /* Announce the sleep first, then look again so a write that raced
+         * past the drain is not left waiting for the deadline */
+        __atomic_store_n(&tx->waiting, 1, __ATOMIC_SEQ_CST);
+        if (uart_tx_pending(tx)) {
+            __atomic_store_n(&tx->waiting, 0, __ATOMIC_SEQ_CST);
+            continue;
+        }
+        ulTaskNotifyTake(pdTRUE, timeout);
+    }
+}
+
+esp_err_t uart_tx_create(uart_iot_handle_t uart, const uart_tx_config_t *config, uart_tx_handle_t *ret_tx) {
+    if (uart == NULL || config == NULL || ret_tx == NULL || config->slot_count < 2 ||
+        (config->slot_count & (config->slot_count - 1)) || config->coalesce_size < UART_TX_SLOT_DATA) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uart_tx_handle_t tx = calloc(1, sizeof(struct uart_tx));
+    if (tx == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    tx->slots = calloc(config->slot_count, sizeof(uart_tx_slot_t));
+    tx->buf = malloc(config->coalesce_size);
+    if (tx->slots == NULL || tx->buf == NULL) {
+        free(tx->slots);
+        free(tx->buf);
+        free(tx);
+        return ESP_ERR_NO_MEM;
+    }
+    for (uint32_t i = 0; i < config->slot_count; i++) {
+        tx->slots[i].seq = i;
+    }
+    tx->port = uart_iot_get_port(uart);
+    tx->mask = config->slot_count - 1;
+    tx->buf_size = config->coalesce_size;
+    tx->flush_ticks = config->flush_deadline_ms / portTICK_RATE_MS;
+    if (tx->flush_ticks == 0) {
+        tx->flush_ticks = 1;
+    }
+    if (xTaskCreatePinnedToCore(uart_tx_task, "uart_tx", config->task_stack, tx,
+                                config->task_priority, &tx->task, config->task_core) != pdPASS) {
+        free(tx->slots);
+        free(tx->buf);
+        free(tx);
+        return ESP_ERR_NO_MEM;
+    }
+    *ret_tx = tx;
+    return ESP_OK;
+}
+
+esp_err_t uart_tx_delete(uart_tx_handle_t tx) {
+    if (tx == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    vTaskDelete(tx->task);
+    free(tx->slots);
+    free(tx->buf);
+    free(tx);
+    return ESP_OK;
+}
+
+void uart_tx_get_stats(uart_tx_handle_t tx, uart_tx_stats_t *stats) {
+    for (int i = 0; i < UART_TX_MAX_PRODUCERS; i++) {
+        stats->bytes[i] = __atomic_load_n(&tx->stats.bytes[i], __ATOMIC_RELAXED);
+        stats->dropped[i] = __atomic_load_n(&tx->stats.dropped[i], __ATOMIC_RELAXED);
+    }
+    stats->high_water = __atomic_load_n(&tx->stats.high_water, __ATOMIC_RELAXED);
+    stats->writes = __atomic_load_n(&tx->stats.writes, __ATOMIC_RELAXED);
+}
@@ -7,20 +7,36 @@
    CONDITIONS OF ANY KIND, either express or implied.
 */
 #include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include "driver/uart.h"
 #include "esp_log.h"
-#include "freertos/timers.h"
 #include "uart_iot.h"
+#include "uart_shell.h"
+#include "uart_telemetry.h"
+#include "uart_match.h"
+#include "uart_tx.h"
 #include "output_iot.h"
 
-#define SHELL_CHANGE_PERIOR_STR_FULL         "period="
 #define SHELL_CHANGE_PERIOR_STR         "period"
+#define SHELL_LEVEL_STR                 "level"
+#define SHELL_STATS_STR                 "stats"
+#define SHELL_TELEMETRY_STR             "telemetry"
 
-extern const char *TAG;
+#define EX_UART_NUM UART_NUM_0
+
+/* Producers on the async TX path, each gets its own byte counters */
+#define TX_PRODUCER_ECHO        0
+#define TX_PRODUCER_LOG         1
+#define TX_PRODUCER_TELEMETRY   2
+/* Long enough for the stats lines, which pass 180 characters once the counters grow */
+#define LOG_LINE_MAX        256
+
+static const char *TAG = "uart_events";
 
 /**
  * This example shows how to use the UART driver to handle special UART events.
@@ -29,179 +45,198 @@ extern const char *TAG;
  *
  * - Port: UART0
  * - Receive (Rx) buffer: on
- * - Transmit (Tx) buffer: off
- * - Flow control: off
+ * - Transmit (Tx) buffer: on, echo and log output are coalesced by uart_tx
+ * - Flow control: off, the USB bridge on UART0 has no RTS/CTS
+ * - RX FIFO threshold: adaptive, loss counted instead of flushed
  * - Event queue: on
+ * - Pattern detect: software, "+++" escapes, CRLF line ends and frame delimiters
  * - Pin assignment: TxD (default), RxD (default)
  */
 
-extern QueueHandle_t uart0_queue;
-TimerHandle_t xTimers;
+/* LED toggles every 500 ms until a "period=" command changes it */
+static output_pattern_t blink_pattern = {
+    .period_ms = 1000,
+    .duty_percent = 50,
+};
 
-void vTimerCallback(TimerHandle_t xTimer)
+static void shell_period(const char *args, size_t len, void *ctx)
 {
-    /* Optionally do something if the pxTimer parameter is NULL. */
-    configASSERT(xTimer);
-
-    /* The number of times this timer has expired is saved as the
-    timer's ID.  Obtain the count. */
-    uint32_t ulCount = (uint32_t)pvTimerGetTimerID(xTimer);
-    if (ulCount == 0)
-    {
-        printf("Blink LED\n");
-        output_io_toggle(2);
+    int x;
+    if (!uart_shell_parse_int(args, len, &x) || x <= 0) {
+        ESP_LOGI(TAG, "Period is negative or zero");
+        return;
+    }
+    /* x is the toggle interval, a full blink period is two of them */
+    blink_pattern.period_ms = 2 * x;
+    if (output_io_pattern_start(2, &blink_pattern) == ESP_OK) {
+        ESP_LOGI(TAG, "Change blink period successfully");
+    }
+    else {
+        ESP_LOGI(TAG, "Change blink period failed");
     }
 }
 
-static void uart_event_task(void *pvParameters)
+static void shell_level(const char *args, size_t len, void *ctx)
 {
-    uart_event_t event;
-    size_t buffered_size;
-    uint8_t* dtmp = (uint8_t*) malloc(RD_BUF_SIZE);
-    for(;;) {
-        //Waiting for UART event.
-        if(xQueueReceive(uart0_queue, (void * )&event, (portTickType)portMAX_DELAY)) {
-            bzero(dtmp, RD_BUF_SIZE);
-            switch(event.type) {
-                //Event of UART receving data
-                /*We'd better handler data event fast, there would be much more data events than
-                other types of events. If we take too much time on data event, the queue might
-                be full.*/
-                case UART_DATA:
-                    uart_read_bytes(EX_UART_NUM, dtmp, event.size, portMAX_DELAY);
-                    char *temp = (char *)malloc(event.size + 1);
-                    strcpy(temp, (char*) dtmp);
-                    if(strstr((char*) temp, SHELL_CHANGE_PERIOR_STR_FULL)) {
-                        // Extract the first token
-                        char *token = strtok((char*) temp, "=");
-                        // loop through the string to extract all other tokens
-                        while (token != NULL)
-                        {
-                            if(!strstr((char*) token, SHELL_CHANGE_PERIOR_STR)) {
-                                int x = atoi(token);
-                                if (x > 0) {
-                                    if (xTimerChangePeriod(xTimers, x / portTICK_PERIOD_MS, 500) == pdPASS) {
-                                        /* The command was successfully sent. */
-                                        ESP_LOGI(TAG, "Change Timer period successfully");
-                                    }
-                                    else {
-                                        /* The command could not be sent, even after waiting for 100 ticks
-                                        to pass.  Take appropriate action here. */
-                                        ESP_LOGI(TAG, "Change Timer period failed");
-                                    }
-                                } else {
-                                    ESP_LOGI(TAG, "Period is negative or zero");
-                                }
-                            }
-                            token = strtok(NULL, " ");
-                        }
-                    }
-                    uart_write_bytes(EX_UART_NUM, (const char*) dtmp, event.size);
-                    free(temp);
-                    break;
-                //Event of HW FIFO overflow detected
-                case UART_FIFO_OVF:
-                    ESP_LOGI(TAG, "hw fifo overflow");
-                    // If fifo overflow happened, you should consider adding flow control for your application.
-                    // The ISR has already reset the rx FIFO,
-                    // As an example, we directly flush the rx buffer here in order to read more data.
-                    uart_flush_input(EX_UART_NUM);
-                    xQueueReset(uart0_queue);
-                    break;
-                //Event of UART ring buffer full
-                case UART_BUFFER_FULL:
-                    ESP_LOGI(TAG, "ring buffer full");
-                    // If buffer full happened, you should consider encreasing your buffer size
-                    // As an example, we directly flush the rx buffer here in order to read more data.
-                    uart_flush_input(EX_UART_NUM);
-                    xQueueReset(uart0_queue);
-                    break;
-                //Event of UART RX break detected
-                case UART_BREAK:
-                    ESP_LOGI(TAG, "uart rx break");
-                    break;
-                //Event of UART parity check error
-                case UART_PARITY_ERR:
-                    ESP_LOGI(TAG, "uart parity error");
-                    break;
-                //Event of UART frame error
-                case UART_FRAME_ERR:
-                    ESP_LOGI(TAG, "uart frame error");
-                    break;
-                //UART_PATTERN_DET
-                case UART_PATTERN_DET:
-                    uart_get_buffered_data_len(EX_UART_NUM, &buffered_size);
-                    int pos = uart_pattern_pop_pos(EX_UART_NUM);
-                    ESP_LOGI(TAG, "[UART PATTERN DETECTED] pos: %d, buffered size: %d", pos, buffered_size);
-                    if (pos == -1) {
-                        // There used to be a UART_PATTERN_DET event, but the pattern position queue is full so that it can not
-                        // record the position. We should set a larger queue size.
-                        // As an example, we directly flush the rx buffer here.
-                        uart_flush_input(EX_UART_NUM);
-                    } else {
-                        uart_read_bytes(EX_UART_NUM, dtmp, pos, 100 / portTICK_PERIOD_MS);
-                        uint8_t pat[PATTERN_CHR_NUM + 1];
-                        memset(pat, 0, sizeof(pat));
-                        uart_read_bytes(EX_UART_NUM, pat, PATTERN_CHR_NUM, 100 / portTICK_PERIOD_MS);
-                        ESP_LOGI(TAG, "read data: %s", dtmp);
-                        ESP_LOGI(TAG, "read pat : %s", pat);
-                    }
-                    break;
-                //Others
-                default:
-                    ESP_LOGI(TAG, "uart event type: %d", event.type);
-                    break;
-            }
-        }
+    int level;
+    if (!uart_shell_parse_int(args, len, &level)) {
+        ESP_LOGI(TAG, "Level must be 0 or 1");
+        return;
     }
-    free(dtmp);
-    dtmp = NULL;
-    vTaskDelete(NULL);
+    /* A fixed level replaces the blink pattern until the next "period=" */
+    output_io_pattern_stop(2);
+    output_io_set_level(2, level != 0);
 }
 
-void app_main(void)
+static uart_shell_t shell;
+static uart_iot_handle_t uart;
+static uart_tx_handle_t uart_tx;
+static uart_match_t matcher;
+
+enum {
+    MATCH_ESCAPE,
+    MATCH_CRLF,
+    MATCH_FRAME_END,
+};
+
+static const uart_match_pattern_t match_patterns[] = {
+    [MATCH_ESCAPE] = { "+++", 3 },
+    [MATCH_CRLF] = { "\r\n", 2 },
+    [MATCH_FRAME_END] = { "\0", 1 },
+};
+
+static uint32_t match_counts[sizeof(match_patterns) / sizeof(match_patterns[0])];
+
+static void match_handler(int pattern, uint32_t offset, void *ctx)
 {
-    esp_log_level_set(TAG, ESP_LOG_INFO);
+    match_counts[pattern]++;
+    if (pattern == MATCH_ESCAPE) {
+        ESP_LOGI(TAG, "[PATTERN DETECTED] +++ at offset %u", offset);
+    }
+}
+
+static void shell_stats(const char *args, size_t len, void *ctx)
+{
+    const uart_shell_stats_t *stats = &shell.stats;
+    ESP_LOGI(TAG, "lines: %u, unknown: %u, overflows: %u", stats->lines, stats->unknown, stats->overflows);
+    uart_iot_stats_t rx;
+    uart_iot_get_stats(uart, &rx);
+    ESP_LOGI(TAG, "rx bytes: %u, fifo overflows: %u, lost bytes: %u, buffer full: %u, queue high water: %u, rx thresh: %u",
+             rx.rx_bytes, rx.fifo_overflows, rx.lost_bytes, rx.buffer_full, rx.queue_high_water, rx.rx_thresh);
+    ESP_LOGI(TAG, "escapes: %u, crlf: %u, frames: %u",
+             match_counts[MATCH_ESCAPE], match_counts[MATCH_CRLF], match_counts[MATCH_FRAME_END]);
+    uart_tx_stats_t tx;
+    uart_tx_get_stats(uart_tx, &tx);
+    ESP_LOGI(TAG, "tx echo: %u (dropped %u), log: %u (dropped %u), telemetry: %u (dropped %u), writes: %u, high water: %u",
+             tx.bytes[TX_PRODUCER_ECHO], tx.dropped[TX_PRODUCER_ECHO], tx.bytes[TX_PRODUCER_LOG],
+             tx.dropped[TX_PRODUCER_LOG], tx.bytes[TX_PRODUCER_TELEMETRY], tx.dropped[TX_PRODUCER_TELEMETRY],
+             tx.writes, tx.high_water);
+}
+static uart_telemetry_handle_t telemetry;
+
+/* Sends the shell counters as one binary frame, one sample per counter */
+static void shell_telemetry(const char *args, size_t len, void *ctx)
+{
+    const uart_shell_stats_t *stats = &shell.stats;
+    uart_telemetry_add(telemetry, 1, &stats->lines, sizeof(stats->lines));
+    uart_telemetry_add(telemetry, 2, &stats->unknown, sizeof(stats->unknown));
+    uart_telemetry_add(telemetry, 3, &stats->overflows, sizeof(stats->overflows));
+    uart_telemetry_flush(telemetry, false);
+}
 
-        output_io_create(2);
-
-    /* Create then start some timers.  Starting the timers before
-    the RTOS scheduler has been started means the timers will start
-    running immediately that the RTOS scheduler starts. */
-
-    xTimers = xTimerCreate(/* Just a text name, not used by the RTOS
-                              kernel. */
-                              "TimerBlink",
-                              /* The timer period in ticks, must be
-                              greater than 0. */
-                              pdMS_TO_TICKS(500),
-                              /* The timers will auto-reload themselves
-                              when they expire. */
-                              pdTRUE,
-                              /* The ID is used to store a count of the
-                              number of times the timer has expired, which
-                              is initialised to 0. */
-                              (void *)0,
-                              /* Each timer calls the same callback when
-                              it expires. */
-                              vTimerCallback);
-
-    if (xTimers == NULL)
-    {
-        /* The timer was not created. */
+static const uart_shell_command_t shell_commands[] = {
+    { SHELL_CHANGE_PERIOR_STR, shell_period, NULL },
+    { SHELL_LEVEL_STR, shell_level, NULL },
+    { SHELL_STATS_STR, shell_stats, NULL },
+    { SHELL_TELEMETRY_STR, shell_telemetry, NULL },
+};
+
+/* Data events are handled here, straight from the port's receive slice.
+   We'd better handle data fast, there would be much more data events than
+   other types of events. If we take too much time on data, the queue might
+   be full. */
+static void uart_rx_handler(uart_iot_handle_t uart, const uint8_t *data, size_t len, void *ctx)
+{
+    uart_tx_write(uart_tx, TX_PRODUCER_ECHO, data, len);
+    uart_shell_feed(&shell, data, len);
+    uart_match_feed(&matcher, data, len);
+    if (telemetry) {
+        uart_telemetry_feed(telemetry, data, len);
     }
-    else
-    {
-        /* Start the timer.  No block time is specified, and
-        even if one was it would be ignored because the RTOS
-        scheduler has not yet been started. */
-        if (xTimerStart(xTimers, 0) != pdPASS)
-        {
-            /* The timer could not be set into the Active
-            state. */
-        }
+}
+
+/* Log lines join the echo on the async path instead of blocking the caller on the driver */
+static int log_vprintf(const char *fmt, va_list args)
+{
+    static const char cut[] = "..." LOG_RESET_COLOR "\n";
+    char line[LOG_LINE_MAX];
+    int len = vsnprintf(line, sizeof(line), fmt, args);
+    if (len > (int) sizeof(line) - 1) {
+        /* A cut line still ends its color and its line, the next one starts clean */
+        len = sizeof(line) - 1;
+        memcpy(line + len - (sizeof(cut) - 1), cut, sizeof(cut) - 1);
     }
+    if (len > 0) {
+        uart_tx_write(uart_tx, TX_PRODUCER_LOG, line, len);
+    }
+    return len;
+}
+
+static void uart_event_handler(uart_iot_handle_t uart, uart_event_t *event, void *ctx)
+{
+    switch(event->type) {
+        //Event of HW FIFO overflow detected
+        case UART_FIFO_OVF:
+            // The ISR has already reset the rx FIFO, uart_iot counts the bytes that went with it.
+            // Buffered data is still good, so nothing is flushed here.
+            ESP_LOGI(TAG, "hw fifo overflow");
+            break;
+        //Event of UART ring buffer full
+        case UART_BUFFER_FULL:
+            // uart_iot has already drained the ring buffer, the FIFO held the rest meanwhile
+            ESP_LOGI(TAG, "ring buffer full");
+            break;
+        //Event of UART RX break detected
+        case UART_BREAK:
+            ESP_LOGI(TAG, "uart rx break");
+            break;
+        //Event of UART parity check error
+        case UART_PARITY_ERR:
+            ESP_LOGI(TAG, "uart parity error");
+            break;
+        //Event of UART frame error
+        case UART_FRAME_ERR:
+            ESP_LOGI(TAG, "uart frame error");
+            break;
+        //Others
+        default:
+            ESP_LOGI(TAG, "uart event type: %d", event->type);
+            break;
+    }
+}
+
+void app_main(void)
+{
+    esp_log_level_set(TAG, ESP_LOG_INFO);
+
+    output_io_create(2);
+
+    output_io_pattern_start(2, &blink_pattern);
+    uart_shell_init(&shell, shell_commands, sizeof(shell_commands) / sizeof(shell_commands[0]));
+    uart_match_init(&matcher, match_patterns, sizeof(match_patterns) / sizeof(match_patterns[0]), match_handler, NULL);
 
-    uart_set_callback(uart_event_task);
-    uart_create(EX_UART_NUM);
+    uart_iot_config_t uart_config = UART_IOT_CONFIG_DEFAULT(EX_UART_NUM);
+    //Set UART pins (using UART0 default pins ie no changes.)
+    uart_config.tx_pin = 1;
+    uart_config.rx_pin = 3;
+    uart_config.event_cb = uart_event_handler;
+    uart_config.rx_cb = uart_rx_handler;
+    uart_config.rx_thresh_min = 8;
+    uart_config.rx_thresh_max = 100;
+    ESP_ERROR_CHECK(uart_iot_create(&uart_config, &uart));
+    uart_tx_config_t tx_config = UART_TX_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(uart_tx_create(uart, &tx_config, &uart_tx));
+    esp_log_set_vprintf(log_vprintf);
+    uart_telemetry_config_t telemetry_config = UART_TELEMETRY_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(uart_telemetry_create(uart_tx, TX_PRODUCER_TELEMETRY, &telemetry_config, &telemetry));
 }
@@ -0,0 +1,6 @@
+#
+# "main" pseudo-component makefile.
+#
+# (Uses default behaviour of compiling all source files in directory, adding 'include' to include path.)
+COMPONENT_ADD_INCLUDEDIRS := .
+COMPONENT_SRCDIRS := .
\ No newline at end of file
@@ -0,0 +1,249 @@
+#include <stdio.h>
+#include <string.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "lwip/netdb.h"
+#include "dns_cache.h"
+
+static const char *TAG = "dns_cache";
+
+typedef struct {
+    char host[DNS_CACHE_HOST_MAX];
+    struct in_addr addr;
+    bool valid;                 /* addr holds a good answer, maybe expired */
+    bool resolving;             /* A query is running, the entry is not evicted meanwhile */
+    int64_t expires_us;
+    int64_t stale_until_us;
+    int64_t last_used_us;
+} dns_cache_entry_t;
+
+static dns_cache_config_t s_config;
+static dns_cache_entry_t s_entries[DNS_CACHE_MAX_ENTRIES];
+static dns_cache_stats_t s_stats;
+static SemaphoreHandle_t s_lock;
+/* Bit i is set whenever entry i has no query running */
+static EventGroupHandle_t s_done;
+static TaskHandle_t s_refresh_task;
+
+static esp_err_t dns_cache_getaddrinfo(const char *host, struct in_addr *addr, uint32_t *ttl_s, void *ctx) {
+    const struct addrinfo hints = {
+        .ai_family = AF_INET,
+        .ai_socktype = SOCK_STREAM,
+    };
+    struct addrinfo *res;
+    int err = getaddrinfo(host, NULL, &hints, &res);
+    if (err != 0 || res == NULL) {
+        ESP_LOGW(TAG, "lookup of %s failed err=%d", host, err);
+        return ESP_ERR_NOT_FOUND;
+    }
+    *addr = ((struct sockaddr_in *) res->ai_addr)->sin_addr;
+    freeaddrinfo(res);
+    return ESP_OK;
+}
+
+static dns_cache_entry_t *dns_cache_find(const char *host) {
+    for (int i = 0; i < DNS_CACHE_MAX_ENTRIES; i++) {
+        if (s_entries[i].host[0] && strcmp(s_entries[i].host, host) == 0) {
+            return &s_entries[i];
+        }
+    }
+    return NULL;
+}
+
+/* Empty slot first, else the least recently used one not being resolved */
+static dns_cache_entry_t *dns_cache_alloc(const char *host) {
+    dns_cache_entry_t *victim = NULL;
+    for (int i = 0; i < DNS_CACHE_MAX_ENTRIES; i++) {
+        dns_cache_entry_t *e = &s_entries[i];
+        if (e->host[0] == 0) {
+            victim = e;
+            break;
+        }
+        if (!e->resolving && (victim == NULL || e->last_used_us < victim->last_used_us)) {
+            victim = e;
+        }
+    }
+    if (victim) {
+        memset(victim, 0, sizeof(*victim));
+        snprintf(victim->host, sizeof(victim->host), "%s", host);
+    }
+    return victim;
+}
+
+static void dns_cache_begin(dns_cache_entry_t *e) {
+    e->resolving = true;
+    xEventGroupClearBits(s_done, (1 << (e - s_entries)));
+}
+
+static esp_err_t dns_cache_resolve(const char *host, struct in_addr *addr, uint32_t *ttl_s) {
+    *ttl_s = 0;
+    return s_config.resolver(host, addr, ttl_s, s_config.resolver_ctx);
+}
+
+/* Called with the lock held. A failed query keeps the old answer until it goes stale. */
+static void dns_cache_complete(dns_cache_entry_t *e, esp_err_t err, const struct in_addr *addr, uint32_t ttl_s) {
+    if (err == ESP_OK) {
+        if (ttl_s == 0) {
+            ttl_s = s_config.default_ttl_s;
+        }
+        if (ttl_s < s_config.min_ttl_s) {
+            ttl_s = s_config.min_ttl_s;
+        }
+        int64_t now = esp_timer_get_time();
+        e->addr = *addr;
+        e->valid = true;
+        e->expires_us = now + (int64_t) ttl_s * 1000000;
+        e->stale_until_us = e->expires_us + (int64_t) s_config.max_stale_s * 1000000;
+    } else {
+        s_stats.failures++;
+    }
+    e->resolving = false;
+    xEventGroupSetBits(s_done, (1 << (e - s_entries)));
+}
+
+static void dns_cache_refresh_task(void *pvParameters) {
+    for (;;) {
+        uint32_t pending;
+        xTaskNotifyWait(0, UINT32_MAX, &pending, portMAX_DELAY);
+        for (int i = 0; i < DNS_CACHE_MAX_ENTRIES; i++) {
+            if ((pending & (1 << i)) == 0) {
+                continue;
+            }
+            /* A resolving entry is never evicted, so the name stays put */
+            dns_cache_entry_t *e = &s_entries[i];
+            char host[DNS_CACHE_HOST_MAX];
+            xSemaphoreTake(s_lock, portMAX_DELAY);
+            memcpy(host, e->host, sizeof(host));
+            xSemaphoreGive(s_lock);
+            struct in_addr addr;
+            uint32_t ttl_s;
+            esp_err_t err = dns_cache_resolve(host, &addr, &ttl_s);
+            xSemaphoreTake(s_lock, portMAX_DELAY);
+            if (err == ESP_OK) {
+                s_stats.refreshes++;
+            }
+            dns_cache_complete(e, err, &addr, ttl_s);
+            xSemaphoreGive(s_lock);
+        }
+    }
+}
+
+esp_err_t dns_cache_lookup(const char *host, struct in_addr *addr, TickType_t timeout) {
+    if (host == NULL || addr == NULL || strlen(host) >= DNS_CACHE_HOST_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int64_t now = esp_timer_get_time();
+    dns_cache_entry_t *e = dns_cache_find(host);
+    if (e && e->valid && now < e->stale_until_us) {
+        e->last_used_us = now;
+        *addr = e->addr;
+        if (now < e->expires_us) {
+            s_stats.hits++;
+        } else {
+            s_stats.stale_hits++;
+            if (!e->resolving) {
+                dns_cache_begin(e);
+                xTaskNotify(s_refresh_task, (1 << (e - s_entries)), eSetBits);
+            }
+        }
+        xSemaphoreGive(s_lock);
+        return ESP_OK;
+    }
+
+    if (e && e->resolving) {
+        /* Someone else's query is running, share its answer */
+        s_stats.shared++;
+        EventBits_t bit = (1 << (e - s_entries));
+        xSemaphoreGive(s_lock);
+        xEventGroupWaitBits(s_done, bit, pdFALSE, pdTRUE, timeout);
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        esp_err_t err = ESP_ERR_TIMEOUT;
+        if (!e->resolving) {
+            /* The slot may have been reused for another name meanwhile */
+            err = strcmp(e->host, host) == 0 && e->valid ? ESP_OK : ESP_ERR_NOT_FOUND;
+            if (err == ESP_OK) {
+                *addr = e->addr;
+            }
+        }
+        xSemaphoreGive(s_lock);
+        return err;
+    }
+
+    s_stats.misses++;
+    if (e == NULL) {
+        e = dns_cache_alloc(host);
+        if (e == NULL) {
+            xSemaphoreGive(s_lock);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    e->last_used_us = now;
+    dns_cache_begin(e);
+    xSemaphoreGive(s_lock);
+
+    uint32_t ttl_s;
+    esp_err_t err = dns_cache_resolve(host, addr, &ttl_s);
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    dns_cache_complete(e, err, addr, ttl_s);
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+void dns_cache_expire(const char *host) {
+    if (s_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    dns_cache_entry_t *e = dns_cache_find(host);
+    if (e && e->valid) {
+        e->expires_us = esp_timer_get_time();
+    }
+    xSemaphoreGive(s_lock);
+}
+
+void dns_cache_get_stats(dns_cache_stats_t *stats) {
+    if (s_lock == NULL) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *stats = s_stats;
+    xSemaphoreGive(s_lock);
+}
+
+esp_err_t dns_cache_init(const dns_cache_config_t *config) {
+    if (config == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_config = *config;
+    if (s_config.resolver == NULL) {
+        s_config.resolver = dns_cache_getaddrinfo;
+    }
+    s_lock = xSemaphoreCreateMutex();
+    s_done = xEventGroupCreate();
+    if (s_lock == NULL || s_done == NULL ||
+        xTaskCreate(dns_cache_refresh_task, "dns_cache", s_config.task_stack, NULL,
+                    s_config.task_priority, &s_refresh_task) != pdPASS) {
+        if (s_lock) {
+            vSemaphoreDelete(s_lock);
+            s_lock = NULL;
+        }
+        if (s_done) {
+            vEventGroupDelete(s_done);
+            s_done = NULL;
+        }
+        return ESP_ERR_NO_MEM;
+    }
+    xEventGroupSetBits(s_done, (1 << DNS_CACHE_MAX_ENTRIES) - 1);
+    return ESP_OK;
+}
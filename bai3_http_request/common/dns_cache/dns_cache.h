@@ -0,0 +1,59 @@
+#ifndef DNS_CACHE_H
+#define DNS_CACHE_H
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "lwip/sockets.h"
+
+/* Process wide IPv4 host name cache. A fresh entry is answered from memory.
+ * An expired one is still answered while a background task refreshes it,
+ * for up to max_stale_s, so a DNS outage does not hold up callers that
+ * already had an address. Callers asking for a name that is being resolved
+ * wait for that lookup instead of starting their own. */
+
+#define DNS_CACHE_MAX_ENTRIES   8
+#define DNS_CACHE_HOST_MAX      64
+
+/* Resolves host to an IPv4 address. ttl_s is the record TTL if the
+ * resolver knows it, left at 0 otherwise. */
+typedef esp_err_t (*dns_cache_resolver_t) (const char *host, struct in_addr *addr, uint32_t *ttl_s, void *ctx);
+
+typedef struct {
+    dns_cache_resolver_t resolver;  /* NULL uses getaddrinfo */
+    void *resolver_ctx;
+    uint32_t default_ttl_s;         /* Used when the resolver gives no TTL */
+    uint32_t min_ttl_s;             /* Floor for very short TTLs */
+    uint32_t max_stale_s;           /* How long past expiry an address is still served */
+    uint32_t task_stack;
+    UBaseType_t task_priority;
+} dns_cache_config_t;
+
+#define DNS_CACHE_CONFIG_DEFAULT() {    \
+    .resolver = NULL,                   \
+    .resolver_ctx = NULL,               \
+    .default_ttl_s = 300,               \
+    .min_ttl_s = 30,                    \
+    .max_stale_s = 3600,                \
+    .task_stack = 3072,                 \
+    .task_priority = 5,                 \
+}
+
+typedef struct {
+    uint32_t hits;
+    uint32_t stale_hits;        /* Answered from an expired entry while it refreshed */
+    uint32_t misses;
+    uint32_t shared;            /* Lookups that waited on another caller's query */
+    uint32_t refreshes;         /* Background queries that succeeded */
+    uint32_t failures;
+} dns_cache_stats_t;
+
+esp_err_t dns_cache_init(const dns_cache_config_t *config);
+/* Blocks only on a miss, for the query itself or up to timeout for one
+ * already running. */
+esp_err_t dns_cache_lookup(const char *host, struct in_addr *addr, TickType_t timeout);
+/* Marks host expired, e.g. after its address refused a connection. The
+ * old address is still served while the refresh runs. */
+void dns_cache_expire(const char *host);
+void dns_cache_get_stats(dns_cache_stats_t *stats);
+
+#endif
@@ -0,0 +1,254 @@
+#include <stdlib.h>
+#include <string.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include "lwip/sockets.h"
+#include "dns_cache.h"
+#include "http_resp.h"
+#include "http_iot.h"
+
+static const char *TAG = "http_iot";
+
+struct http_iot {
+    char *host;
+    char *port;
+    uint32_t timeout_ms;
+    int64_t idle_timeout_us;
+    int sock;                   /* -1 while closed */
+    int64_t last_used_us;
+    uint8_t *rx;
+    size_t rx_size;
+    http_resp_t resp;
+    http_iot_stats_t stats;
+};
+
+/* Outcome of one attempt, tells the caller whether resending is safe */
+typedef enum {
+    HTTP_IOT_OK,
+    HTTP_IOT_DEAD,              /* Connection found closed before any of the response came */
+    HTTP_IOT_FAIL,
+} http_iot_result_t;
+
+/* A reused connection the peer has already dropped fails with EOF, a reset
+ * or a broken pipe. A timeout is different: the server may be processing
+ * the request, so it must not be sent again. */
+static bool http_iot_stale(int n) {
+    return n == 0 || (n < 0 && (errno == ECONNRESET || errno == EPIPE || errno == ENOTCONN));
+}
+
+/* RFC 9110 idempotent methods, sending one twice has the effect of sending it once */
+static bool http_iot_idempotent(const struct iovec *request) {
+    static const char *const methods[] = { "GET ", "HEAD ", "PUT ", "DELETE ", "OPTIONS ", "TRACE " };
+    for (int i = 0; i < sizeof(methods) / sizeof(methods[0]); i++) {
+        size_t len = strlen(methods[i]);
+        if (request->iov_len >= len && memcmp(request->iov_base, methods[i], len) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* A server that closed a kept connection while it sat idle has its FIN or
+ * RST queued already, so a look costs no round trip. Unasked-for bytes
+ * count as dead too, the stream would be out of step. */
+static bool http_iot_alive(http_iot_handle_t http) {
+    uint8_t byte;
+    int n = recv(http->sock, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+static esp_err_t http_iot_connect(http_iot_handle_t http) {
+    struct sockaddr_in dest = {
+        .sin_family = AF_INET,
+        .sin_port = htons(atoi(http->port)),
+    };
+    esp_err_t err = dns_cache_lookup(http->host, &dest.sin_addr, pdMS_TO_TICKS(http->timeout_ms));
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "DNS lookup of %s failed: %s", http->host, esp_err_to_name(err));
+        return err;
+    }
+    int s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s < 0) {
+        return ESP_ERR_NO_MEM;
+    }
+    struct timeval timeout = {
+        .tv_sec = http->timeout_ms / 1000,
+        .tv_usec = (http->timeout_ms % 1000) * 1000,
+    };
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    int opt = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+    if (connect(s, (struct sockaddr *) &dest, sizeof(dest)) != 0) {
+        ESP_LOGE(TAG, "connect to %s failed errno=%d", http->host, errno);
+        close(s);
+        /* The server may have moved, look it up again next time */
+        dns_cache_expire(http->host);
+        return ESP_FAIL;
+    }
+    http->sock = s;
+    http->stats.connects++;
+    return ESP_OK;
+}
+
+void http_iot_close(http_iot_handle_t http) {
+    if (http->sock >= 0) {
+        close(http->sock);
+        http->sock = -1;
+    }
+}
+
+/* One writev per pass so header and body leave in the same segments */
+static http_iot_result_t http_iot_send_all(http_iot_handle_t http, const struct iovec *request, int count) {
+    struct iovec iov[HTTP_IOT_IOV_MAX];
+    memcpy(iov, request, count * sizeof(struct iovec));
+    struct iovec *next = iov;
+    while (count > 0) {
+        int n = writev(http->sock, next, count);
+        if (n < 0) {
+            return http_iot_stale(n) ? HTTP_IOT_DEAD : HTTP_IOT_FAIL;
+        }
+        while (count > 0 && (size_t) n >= next->iov_len) {
+            n -= next->iov_len;
+            next++;
+            count--;
+        }
+        if (count > 0) {
+            next->iov_base = (uint8_t *) next->iov_base + n;
+            next->iov_len -= n;
+        }
+    }
+    return HTTP_IOT_OK;
+}
+
+static http_iot_result_t http_iot_read_response(http_iot_handle_t http, int *status,
+                                                http_iot_body_cb_t body_cb, void *ctx) {
+    http_resp_t *resp = &http->resp;
+    http_resp_init(resp, NULL, body_cb, ctx);
+    bool any = false;
+    bool leftover = false;
+    /* Reads stop as soon as the response is complete, no waiting for close or timeout */
+    while (resp->state != HTTP_RESP_DONE && resp->state != HTTP_RESP_ERROR) {
+        int n = recv(http->sock, http->rx, http->rx_size, 0);
+        if (n == 0 && http_resp_finish(resp)) {
+            break;
+        }
+        if (n <= 0) {
+            return !any && http_iot_stale(n) ? HTTP_IOT_DEAD : HTTP_IOT_FAIL;
+        }
+        any = true;
+        leftover = http_resp_feed(resp, http->rx, n) < (size_t) n;
+    }
+    if (resp->state == HTTP_RESP_ERROR) {
+        ESP_LOGE(TAG, "malformed response from %s", http->host);
+        return HTTP_IOT_FAIL;
+    }
+    *status = resp->status;
+    /* Bytes past the end of the response mean the stream is out of step */
+    if (!resp->keep_alive || leftover) {
+        http_iot_close(http);
+    }
+    return HTTP_IOT_OK;
+}
+
+esp_err_t http_iot_request(http_iot_handle_t http, const void *request, size_t len, int *status,
+                           http_iot_body_cb_t body_cb, void *ctx) {
+    const struct iovec iov = {
+        .iov_base = (void *) request,
+        .iov_len = len,
+    };
+    return http_iot_requestv(http, &iov, 1, status, body_cb, ctx);
+}
+
+esp_err_t http_iot_requestv(http_iot_handle_t http, const struct iovec *request, int count, int *status,
+                            http_iot_body_cb_t body_cb, void *ctx) {
+    if (count < 1 || count > HTTP_IOT_IOV_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    int dummy_status;
+    if (status == NULL) {
+        status = &dummy_status;
+    }
+    http->stats.requests++;
+    int64_t now = esp_timer_get_time();
+    if (http->sock >= 0 && http->idle_timeout_us && now - http->last_used_us > http->idle_timeout_us) {
+        http_iot_close(http);
+    }
+    if (http->sock >= 0 && !http_iot_alive(http)) {
+        http->stats.dropped++;
+        http_iot_close(http);
+    }
+    bool idempotent = http_iot_idempotent(request);
+    for (int attempt = 0; attempt < 2; attempt++) {
+        bool reused = http->sock >= 0;
+        if (!reused) {
+            esp_err_t err = http_iot_connect(http);
+            if (err != ESP_OK) {
+                http->stats.errors++;
+                return err;
+            }
+        } else {
+            http->stats.reused++;
+        }
+        http_iot_result_t result = http_iot_send_all(http, request, count);
+        if (result == HTTP_IOT_OK) {
+            result = http_iot_read_response(http, status, body_cb, ctx);
+        }
+        if (result == HTTP_IOT_OK) {
+            http->last_used_us = esp_timer_get_time();
+            return ESP_OK;
+        }
+        http_iot_close(http);
+        /* Only a reused connection can be stale, a fresh one failing is a real
+         * error, and so is a timeout on either. A connection that dies once
+         * the request is out may have done so after the server acted on it,
+         * so only a request that is safe to repeat goes out again. */
+        if (result == HTTP_IOT_FAIL || !reused || !idempotent) {
+            break;
+        }
+        ESP_LOGI(TAG, "connection to %s was dropped, reconnecting", http->host);
+        http->stats.retries++;
+    }
+    http->stats.errors++;
+    return ESP_FAIL;
+}
+
+esp_err_t http_iot_create(const http_iot_config_t *config, http_iot_handle_t *ret_http) {
+    if (config == NULL || ret_http == NULL || config->host == NULL || config->port == NULL ||
+        config->rx_buffer_size < 64) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    http_iot_handle_t http = calloc(1, sizeof(struct http_iot));
+    if (http == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    /* Before anything can fail, http_iot_delete closes a sock that is >= 0 */
+    http->sock = -1;
+    http->host = strdup(config->host);
+    http->port = strdup(config->port);
+    http->rx = malloc(config->rx_buffer_size);
+    if (http->host == NULL || http->port == NULL || http->rx == NULL) {
+        http_iot_delete(http);
+        return ESP_ERR_NO_MEM;
+    }
+    http->rx_size = config->rx_buffer_size;
+    http->timeout_ms = config->timeout_ms;
+    http->idle_timeout_us = (int64_t) config->idle_timeout_ms * 1000;
+    *ret_http = http;
+    return ESP_OK;
+}
+
+void http_iot_delete(http_iot_handle_t http) {
+    if (http == NULL) {
+        return;
+    }
+    http_iot_close(http);
+    free(http->host);
+    free(http->port);
+    free(http->rx);
+    free(http);
+}
+
+void http_iot_get_stats(http_iot_handle_t http, http_iot_stats_t *stats) {
+    *stats = http->stats;
+}
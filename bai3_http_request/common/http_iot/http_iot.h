@@ -0,0 +1,66 @@
+#ifndef HTTP_IOT_H
+#define HTTP_IOT_H
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "lwip/sockets.h"
+
+/* Minimal HTTP/1.1 client that keeps one connection to one server open across
+ * requests. A kept connection the server has closed is found before the
+ * request goes out and replaced. One that dies after the request was sent,
+ * before any of the response arrived, may have lost the request or may not,
+ * so the request is sent again once on a fresh connection only if its method
+ * is idempotent (GET, HEAD, PUT, DELETE, OPTIONS, TRACE). A POST fails
+ * instead and the caller decides whether to repeat it, as sample_batch does
+ * after its retry delay. Responses are parsed as they arrive, Content-Length
+ * and chunked bodies keep the connection, without either the body runs to
+ * the end of the connection. The server address comes from dns_cache, which
+ * has to be initialised first. */
+
+#define HTTP_IOT_IOV_MAX    8
+
+typedef struct http_iot *http_iot_handle_t;
+
+typedef struct {
+    const char *host;
+    const char *port;
+    uint32_t timeout_ms;        /* Connect and per-read timeout */
+    uint32_t idle_timeout_ms;   /* Reconnect instead of reusing a connection idle this long, 0 never */
+    size_t rx_buffer_size;      /* Socket read size */
+} http_iot_config_t;
+
+#define HTTP_IOT_CONFIG_DEFAULT(server, server_port) {  \
+    .host = server,                                     \
+    .port = server_port,                                \
+    .timeout_ms = 5000,                                 \
+    .idle_timeout_ms = 60000,                           \
+    .rx_buffer_size = 1024,                             \
+}
+
+/* Body bytes as they arrive, borrowed until the callback returns */
+typedef void (*http_iot_body_cb_t) (const uint8_t *data, size_t len, void *ctx);
+
+typedef struct {
+    uint32_t requests;
+    uint32_t connects;
+    uint32_t reused;            /* Requests that went out on an already open connection */
+    uint32_t dropped;           /* Kept connections found closed before a request went out */
+    uint32_t retries;           /* Idempotent requests resent after the connection died under them */
+    uint32_t errors;
+} http_iot_stats_t;
+
+esp_err_t http_iot_create(const http_iot_config_t *config, http_iot_handle_t *ret_http);
+void http_iot_delete(http_iot_handle_t http);
+/* Sends one complete request (request line, headers and body, no
+ * "Connection: close") and reads its response. status is the HTTP status
+ * code, body_cb may be NULL. */
+esp_err_t http_iot_request(http_iot_handle_t http, const void *request, size_t len, int *status,
+                           http_iot_body_cb_t body_cb, void *ctx);
+/* Same, with the request gathered from up to HTTP_IOT_IOV_MAX pieces, e.g. a
+ * header built on the stack and a body that stays where it was encoded */
+esp_err_t http_iot_requestv(http_iot_handle_t http, const struct iovec *request, int count, int *status,
+                            http_iot_body_cb_t body_cb, void *ctx);
+void http_iot_close(http_iot_handle_t http);
+void http_iot_get_stats(http_iot_handle_t http, http_iot_stats_t *stats);
+
+#endif
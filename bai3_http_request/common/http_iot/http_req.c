@@ -0,0 +1,125 @@
+#include <string.h>
+#include "http_req.h"
+
+static const char s_digit_pairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/* Writes value right aligned ending at end, two digits per step, returns the start */
+static char *http_req_utoa(char *end, uint32_t value) {
+    while (value >= 100) {
+        const char *pair = &s_digit_pairs[(value % 100) * 2];
+        value /= 100;
+        *--end = pair[1];
+        *--end = pair[0];
+    }
+    if (value >= 10) {
+        *--end = s_digit_pairs[value * 2 + 1];
+        *--end = s_digit_pairs[value * 2];
+    } else {
+        *--end = '0' + value;
+    }
+    return end;
+}
+
+void http_req_init(http_req_t *req, char *buf, size_t size) {
+    req->count = 0;
+    req->buf = buf;
+    req->size = size;
+    req->used = 0;
+    req->len = 0;
+    req->overflow = false;
+}
+
+bool http_req_ref(http_req_t *req, const void *data, size_t len) {
+    if (req->overflow) {
+        return false;
+    }
+    if (len == 0) {
+        return true;
+    }
+    if (req->count == HTTP_IOT_IOV_MAX) {
+        req->overflow = true;
+        return false;
+    }
+    req->iov[req->count].iov_base = (void *) data;
+    req->iov[req->count].iov_len = len;
+    req->count++;
+    req->len += len;
+    return true;
+}
+
+/* Appends rendered text to the buffer, growing the last entry when it
+ * already ends there so back to back numbers share one entry */
+static bool http_req_render(http_req_t *req, const char *text, size_t len) {
+    if (req->overflow) {
+        return false;
+    }
+    if (len > req->size - req->used) {
+        req->overflow = true;
+        return false;
+    }
+    char *dst = req->buf + req->used;
+    memcpy(dst, text, len);
+    req->used += len;
+    struct iovec *last = req->count ? &req->iov[req->count - 1] : NULL;
+    if (last && (char *) last->iov_base + last->iov_len == dst) {
+        last->iov_len += len;
+        req->len += len;
+        return true;
+    }
+    return http_req_ref(req, dst, len);
+}
+
+bool http_req_uint(http_req_t *req, uint32_t value) {
+    char tmp[10];
+    char *start = http_req_utoa(tmp + sizeof(tmp), value);
+    return http_req_render(req, start, tmp + sizeof(tmp) - start);
+}
+
+bool http_req_int(http_req_t *req, int32_t value) {
+    char tmp[11];
+    /* Negating in unsigned keeps INT32_MIN right */
+    char *start = http_req_utoa(tmp + sizeof(tmp), value < 0 ? 0u - (uint32_t) value : (uint32_t) value);
+    if (value < 0) {
+        *--start = '-';
+    }
+    return http_req_render(req, start, tmp + sizeof(tmp) - start);
+}
+
+bool http_req_fixed(http_req_t *req, int32_t value, uint8_t decimals) {
+    if (decimals > 9) {
+        req->overflow = true;
+        return false;
+    }
+    uint32_t magnitude = value < 0 ? 0u - (uint32_t) value : (uint32_t) value;
+    char tmp[22];
+    char *end = tmp + sizeof(tmp);
+    char *start = end;
+    if (decimals) {
+        uint32_t scale = 1;
+        for (int i = 0; i < decimals; i++) {
+            scale *= 10;
+        }
+        /* Fraction digits, zero padded to the full width */
+        start = http_req_utoa(end, magnitude % scale);
+        while (end - start < decimals) {
+            *--start = '0';
+        }
+        *--start = '.';
+        magnitude /= scale;
+    }
+    start = http_req_utoa(start, magnitude);
+    if (value < 0) {
+        *--start = '-';
+    }
+    return http_req_render(req, start, end - start);
+}
@@ -0,0 +1,35 @@
+#ifndef HTTP_REQ_H
+#define HTTP_REQ_H
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "lwip/sockets.h"
+#include "http_iot.h"
+
+/* Builds a request as a scatter list for http_iot_requestv. Constant text
+ * is referenced where it lives, only numbers are rendered, into a buffer the
+ * caller owns, so nothing is allocated and template bytes are never copied.
+ * Running out of buffer or list entries sets overflow, later appends are
+ * ignored and the request must not be sent. */
+
+typedef struct {
+    struct iovec iov[HTTP_IOT_IOV_MAX];
+    int count;
+    char *buf;                  /* Rendered numbers, referenced by iov */
+    size_t size;
+    size_t used;
+    size_t len;                 /* Bytes in the whole request */
+    bool overflow;
+} http_req_t;
+
+void http_req_init(http_req_t *req, char *buf, size_t size);
+/* data must stay valid until the request has been sent */
+bool http_req_ref(http_req_t *req, const void *data, size_t len);
+/* Literal template segment, nothing is copied */
+#define http_req_static(req, literal) http_req_ref(req, literal, sizeof(literal) - 1)
+bool http_req_uint(http_req_t *req, uint32_t value);
+bool http_req_int(http_req_t *req, int32_t value);
+/* value / 10^decimals with exactly decimals digits after the point, e.g. 2050, 2 -> "20.50" */
+bool http_req_fixed(http_req_t *req, int32_t value, uint8_t decimals);
+
+#endif
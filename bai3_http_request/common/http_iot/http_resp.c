@@ -0,0 +1,242 @@
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include "http_resp.h"
+
+/* Largest chunk accepted, keeps the hex size well inside uint32_t */
+#define HTTP_RESP_CHUNK_MAX     0x0fffffff
+
+void http_resp_init(http_resp_t *resp, http_resp_header_cb_t header_cb, http_resp_body_cb_t body_cb, void *ctx) {
+    memset(resp, 0, sizeof(*resp));
+    resp->state = HTTP_RESP_STATUS;
+    resp->content_length = -1;
+    resp->header_cb = header_cb;
+    resp->body_cb = body_cb;
+    resp->ctx = ctx;
+}
+
+/* Collects one line across calls, returns true once it is complete with
+ * CR/LF stripped. *used is what was taken from data either way. */
+static bool http_resp_line(http_resp_t *resp, const uint8_t *data, size_t len, size_t *used) {
+    const uint8_t *nl = memchr(data, '\n', len);
+    size_t take = nl ? (size_t) (nl - data) : len;
+    size_t room = HTTP_RESP_LINE_MAX - 1 - resp->line_len;
+    if (take > room) {
+        resp->line_overflow = true;
+    }
+    memcpy(resp->line + resp->line_len, data, take < room ? take : room);
+    resp->line_len += take < room ? take : room;
+    *used = nl ? take + 1 : take;
+    if (nl == NULL) {
+        return false;
+    }
+    if (resp->line_len && resp->line[resp->line_len - 1] == '\r') {
+        resp->line_len--;
+    }
+    resp->line[resp->line_len] = 0;
+    return true;
+}
+
+static bool http_resp_status_line(http_resp_t *resp, const char *line) {
+    /* HTTP/1.x NNN reason */
+    if (strncmp(line, "HTTP/1.", 7) != 0 || !isdigit((unsigned char) line[7]) || line[8] != ' ' ||
+        !isdigit((unsigned char) line[9]) || !isdigit((unsigned char) line[10]) ||
+        !isdigit((unsigned char) line[11]) || (line[12] != ' ' && line[12] != 0)) {
+        return false;
+    }
+    resp->status = (line[9] - '0') * 100 + (line[10] - '0') * 10 + (line[11] - '0');
+    resp->keep_alive = line[7] != '0';
+    resp->chunked = false;
+    resp->content_length = -1;
+    return true;
+}
+
+/* true when the comma separated list in value holds token */
+static bool http_resp_has_token(const char *value, const char *token) {
+    size_t len = strlen(token);
+    for (const char *p = value; *p; ) {
+        while (*p == ' ' || *p == '\t' || *p == ',') {
+            p++;
+        }
+        const char *end = p;
+        while (*end && *end != ',' && *end != ' ' && *end != '\t') {
+            end++;
+        }
+        if ((size_t) (end - p) == len && strncasecmp(p, token, len) == 0) {
+            return true;
+        }
+        p = end;
+    }
+    return false;
+}
+
+static bool http_resp_header_line(http_resp_t *resp, char *line) {
+    char *colon = strchr(line, ':');
+    bool needed = strncasecmp(line, "content-length", 14) == 0 ||
+                  strncasecmp(line, "transfer-encoding", 17) == 0;
+    if (resp->line_overflow) {
+        /* Framing can't be guessed from half a header */
+        return !needed;
+    }
+    if (colon == NULL || colon == line) {
+        return line[0] == ' ' || line[0] == '\t';   /* Obsolete folding, ignored */
+    }
+    *colon = 0;
+    char *value = colon + 1;
+    while (*value == ' ' || *value == '\t') {
+        value++;
+    }
+    char *end = value + strlen(value);
+    while (end > value && (end[-1] == ' ' || end[-1] == '\t')) {
+        *--end = 0;
+    }
+    if (strcasecmp(line, "content-length") == 0) {
+        if (*value == 0) {
+            return false;
+        }
+        int32_t length = 0;
+        for (const char *p = value; *p; p++) {
+            if (!isdigit((unsigned char) *p) || length > (INT32_MAX - 9) / 10) {
+                return false;
+            }
+            length = length * 10 + (*p - '0');
+        }
+        if (resp->content_length >= 0 && resp->content_length != length) {
+            return false;
+        }
+        resp->content_length = length;
+    } else if (strcasecmp(line, "transfer-encoding") == 0) {
+        resp->chunked = http_resp_has_token(value, "chunked");
+    } else if (strcasecmp(line, "connection") == 0) {
+        if (http_resp_has_token(value, "close")) {
+            resp->keep_alive = false;
+        } else if (http_resp_has_token(value, "keep-alive")) {
+            resp->keep_alive = true;
+        }
+    }
+    if (resp->header_cb) {
+        resp->header_cb(line, value, resp->ctx);
+    }
+    return true;
+}
+
+/* Blank line after the headers, picks how the body is framed */
+static http_resp_state_t http_resp_headers_done(http_resp_t *resp) {
+    if (resp->status / 100 == 1) {
+        /* Interim response, the real one follows */
+        return HTTP_RESP_STATUS;
+    }
+    if (resp->status == 204 || resp->status == 304) {
+        return HTTP_RESP_DONE;
+    }
+    if (resp->chunked) {
+        return HTTP_RESP_CHUNK_SIZE;
+    }
+    if (resp->content_length >= 0) {
+        resp->remaining = resp->content_length;
+        return resp->remaining ? HTTP_RESP_BODY : HTTP_RESP_DONE;
+    }
+    resp->keep_alive = false;
+    return HTTP_RESP_BODY_EOF;
+}
+
+static bool http_resp_chunk_size(http_resp_t *resp, const char *line) {
+    uint32_t size = 0;
+    const char *p = line;
+    for (; isxdigit((unsigned char) *p); p++) {
+        if (size > HTTP_RESP_CHUNK_MAX >> 4) {
+            return false;
+        }
+        size = size << 4 | (isdigit((unsigned char) *p) ? *p - '0' : (tolower((unsigned char) *p) - 'a' + 10));
+    }
+    /* Chunk extensions after ';' are ignored */
+    if (p == line || (*p && *p != ';' && *p != ' ' && *p != '\t')) {
+        return false;
+    }
+    resp->remaining = size;
+    return true;
+}
+
+static http_resp_state_t http_resp_on_line(http_resp_t *resp) {
+    char *line = resp->line;
+    switch (resp->state) {
+        case HTTP_RESP_STATUS:
+            /* Stray CRLF left over from the previous response */
+            if (resp->line_len == 0 && !resp->line_overflow) {
+                return HTTP_RESP_STATUS;
+            }
+            return !resp->line_overflow && http_resp_status_line(resp, line) ? HTTP_RESP_HEADER : HTTP_RESP_ERROR;
+        case HTTP_RESP_HEADER:
+            if (resp->line_len == 0 && !resp->line_overflow) {
+                return http_resp_headers_done(resp);
+            }
+            return http_resp_header_line(resp, line) ? HTTP_RESP_HEADER : HTTP_RESP_ERROR;
+        case HTTP_RESP_CHUNK_SIZE:
+            if (resp->line_overflow || !http_resp_chunk_size(resp, line)) {
+                return HTTP_RESP_ERROR;
+            }
+            return resp->remaining ? HTTP_RESP_CHUNK_DATA : HTTP_RESP_TRAILER;
+        case HTTP_RESP_CHUNK_END:
+            return resp->line_len == 0 && !resp->line_overflow ? HTTP_RESP_CHUNK_SIZE : HTTP_RESP_ERROR;
+        case HTTP_RESP_TRAILER:
+            return resp->line_len == 0 && !resp->line_overflow ? HTTP_RESP_DONE : HTTP_RESP_TRAILER;
+        default:
+            return HTTP_RESP_ERROR;
+    }
+}
+
+static size_t http_resp_body(http_resp_t *resp, const uint8_t *data, size_t len) {
+    size_t n = len < resp->remaining ? len : resp->remaining;
+    if (resp->body_cb && n) {
+        resp->body_cb(data, n, resp->ctx);
+    }
+    resp->remaining -= n;
+    return n;
+}
+
+size_t http_resp_feed(http_resp_t *resp, const uint8_t *data, size_t len) {
+    size_t off = 0;
+    while (off < len && resp->state != HTTP_RESP_DONE && resp->state != HTTP_RESP_ERROR) {
+        size_t used;
+        switch (resp->state) {
+            case HTTP_RESP_BODY:
+                off += http_resp_body(resp, data + off, len - off);
+                if (resp->remaining == 0) {
+                    resp->state = HTTP_RESP_DONE;
+                }
+                break;
+            case HTTP_RESP_CHUNK_DATA:
+                off += http_resp_body(resp, data + off, len - off);
+                if (resp->remaining == 0) {
+                    resp->state = HTTP_RESP_CHUNK_END;
+                }
+                break;
+            case HTTP_RESP_BODY_EOF:
+                if (resp->body_cb) {
+                    resp->body_cb(data + off, len - off, resp->ctx);
+                }
+                off = len;
+                break;
+            default:
+                if (http_resp_line(resp, data + off, len - off, &used)) {
+                    resp->state = http_resp_on_line(resp);
+                    resp->line_len = 0;
+                    resp->line_overflow = false;
+                }
+                off += used;
+                break;
+        }
+    }
+    return off;
+}
+
+bool http_resp_finish(http_resp_t *resp) {
+    if (resp->state == HTTP_RESP_BODY_EOF) {
+        resp->state = HTTP_RESP_DONE;
+    }
+    if (resp->state != HTTP_RESP_DONE) {
+        resp->state = HTTP_RESP_ERROR;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,56 @@
+#ifndef HTTP_RESP_H
+#define HTTP_RESP_H
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Incremental HTTP/1.x response parser. Bytes go in as they come off the
+ * socket, split anywhere, and body bytes come out through body_cb as slices
+ * of the input, chunked framing already removed. Nothing is allocated: the
+ * only buffer is one line of status, header or chunk size. A header line
+ * longer than that is skipped unless it is one the parser needs.
+ * Interim 1xx responses are skipped. */
+
+#define HTTP_RESP_LINE_MAX  128
+
+typedef enum {
+    HTTP_RESP_STATUS,
+    HTTP_RESP_HEADER,
+    HTTP_RESP_BODY,             /* Content-Length bytes */
+    HTTP_RESP_BODY_EOF,         /* No length, the body ends with the connection */
+    HTTP_RESP_CHUNK_SIZE,
+    HTTP_RESP_CHUNK_DATA,
+    HTTP_RESP_CHUNK_END,        /* CRLF after a chunk */
+    HTTP_RESP_TRAILER,
+    HTTP_RESP_DONE,
+    HTTP_RESP_ERROR,
+} http_resp_state_t;
+
+/* name and value are NUL terminated and only valid during the call */
+typedef void (*http_resp_header_cb_t) (const char *name, const char *value, void *ctx);
+typedef void (*http_resp_body_cb_t) (const uint8_t *data, size_t len, void *ctx);
+
+typedef struct {
+    http_resp_state_t state;
+    int status;
+    bool keep_alive;            /* The connection can carry another request afterwards */
+    bool chunked;
+    int32_t content_length;     /* -1 when the response has none */
+    uint32_t remaining;         /* Left in the body or the current chunk */
+    char line[HTTP_RESP_LINE_MAX];
+    size_t line_len;
+    bool line_overflow;
+    http_resp_header_cb_t header_cb;
+    http_resp_body_cb_t body_cb;
+    void *ctx;
+} http_resp_t;
+
+/* Either callback may be NULL. Call again before each response. */
+void http_resp_init(http_resp_t *resp, http_resp_header_cb_t header_cb, http_resp_body_cb_t body_cb, void *ctx);
+/* Returns the bytes used. It stops at the end of the response, so fewer than
+ * len means the rest belongs to whatever follows. Check state for DONE and ERROR. */
+size_t http_resp_feed(http_resp_t *resp, const uint8_t *data, size_t len);
+/* The connection closed, returns true when that completes the response */
+bool http_resp_finish(http_resp_t *resp);
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef INPUT_SCAN_H
+#define INPUT_SCAN_H
+#include <stdint.h>
+
+/* Debounced change detection over 64-bit GPIO snapshots. Pure C so synthetic
+ * register traces can be pushed through it off-target. */
+
+#define INPUT_SCAN_MAX_PINS     64
+
+typedef struct {
+    uint64_t mask;              /* Pins being scanned */
+    uint64_t stable;            /* Debounced levels */
+    uint64_t pending;           /* Pins whose raw level currently differs from stable */
+    uint8_t debounce_samples;   /* Consecutive differing samples needed to accept a change */
+    uint8_t count[INPUT_SCAN_MAX_PINS];
+} input_scan_t;
+
+void input_scan_init(input_scan_t *scan, uint64_t mask, uint64_t initial, uint8_t debounce_samples);
+
+/* Feed one raw snapshot, returns the mask of pins whose debounced level changed.
+ * The new levels are in scan->stable. */
+uint64_t input_scan_update(input_scan_t *scan, uint64_t sample);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef OUTPUT_STRIP_ENCODE_H
+#define OUTPUT_STRIP_ENCODE_H
+#include <stdint.h>
+#include <stddef.h>
+
+/* Addressable LED bit encoding into RMT items. An item is packed the same way as
+ * rmt_item32_t: duration0 in bits 0-14, level0 in bit 15, duration1 in bits 16-30,
+ * level1 in bit 31. Free of driver dependencies so it can be benchmarked off-target. */
+
+#define OUTPUT_STRIP_ITEMS_PER_BYTE     8
+
+typedef struct {
+    uint32_t t0h_ns;
+    uint32_t t0l_ns;
+    uint32_t t1h_ns;
+    uint32_t t1l_ns;
+    uint32_t reset_us;          /* Low time that latches a frame */
+} output_strip_timing_t;
+
+/* WS2812 datasheet timings, WS2812B parts from V5 on want reset_us = 280 */
+#define OUTPUT_STRIP_TIMING_WS2812() { \
+    .t0h_ns = 350,                     \
+    .t0l_ns = 800,                     \
+    .t1h_ns = 700,                     \
+    .t1l_ns = 600,                     \
+    .reset_us = 50,                    \
+}
+
+typedef struct {
+    uint32_t bit0;
+    uint32_t bit1;
+    uint32_t reset;             /* Sent after the last bit so back to back frames still latch */
+} output_strip_symbols_t;
+
+/* Turn the timing into the items for a given RMT counter clock */
+void output_strip_symbols_init(output_strip_symbols_t *symbols, const output_strip_timing_t *timing,
+                               uint32_t counter_clk_hz);
+
+/* Encode len bytes MSB first, items must hold len * OUTPUT_STRIP_ITEMS_PER_BYTE words */
+void output_strip_encode(const output_strip_symbols_t *symbols, const uint8_t *data, size_t len,
+                         uint32_t *items);
+
+#endif
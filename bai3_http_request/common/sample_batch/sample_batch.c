@@ -0,0 +1,190 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "sample_batch.h"
+
+/* Room kept free at the end of the body for the closing "]}" */
+#define SAMPLE_BATCH_TAIL   2
+
+typedef enum {
+    SAMPLE_BATCH_BY_COUNT,
+    SAMPLE_BATCH_BY_AGE,
+    SAMPLE_BATCH_BY_BYTES,
+    SAMPLE_BATCH_BY_CALLER,
+} sample_batch_reason_t;
+
+struct sample_batch {
+    char *body;
+    size_t size;
+    size_t len;
+    size_t prefix_len;          /* {"write_api_key":"...","updates":[ */
+    uint32_t count;
+    uint32_t oldest_ms;
+    uint32_t last_ms;
+    bool have_last;
+    uint32_t now_ms;            /* Latest time seen from add or poll */
+    bool held;                  /* Last flush failed, automatic ones wait for held_until_ms */
+    uint32_t held_until_ms;
+    uint32_t max_samples;
+    uint32_t max_age_ms;
+    uint32_t retry_ms;
+    sample_batch_flush_cb_t flush_cb;
+    void *ctx;
+    sample_batch_stats_t stats;
+};
+
+/* Encodes one update object at dst, 0 when it does not fit in room */
+static size_t sample_batch_encode(sample_batch_handle_t batch, const sample_batch_sample_t *sample,
+                                  char *dst, size_t room) {
+    uint32_t delta_s = batch->have_last ? sample->time_ms / 1000 - batch->last_ms / 1000 : 0;
+    int n = snprintf(dst, room, "%s{\"delta_t\":%u", batch->count ? "," : "", delta_s);
+    if (n < 0 || (size_t) n >= room) {
+        return 0;
+    }
+    size_t len = n;
+    for (int i = 0; i < SAMPLE_BATCH_FIELDS; i++) {
+        if ((sample->field_mask & (1 << i)) == 0) {
+            continue;
+        }
+        n = snprintf(dst + len, room - len, ",\"field%d\":%g", i + 1, sample->fields[i]);
+        if (n < 0 || (size_t) n >= room - len) {
+            return 0;
+        }
+        len += n;
+    }
+    if (len == room) {
+        return 0;
+    }
+    dst[len++] = '}';
+    return len;
+}
+
+static esp_err_t sample_batch_flush_reason(sample_batch_handle_t batch, sample_batch_reason_t reason) {
+    if (batch->count == 0) {
+        return ESP_OK;
+    }
+    memcpy(batch->body + batch->len, "]}", SAMPLE_BATCH_TAIL);
+    esp_err_t err = batch->flush_cb(batch->body, batch->len + SAMPLE_BATCH_TAIL, batch->count, batch->ctx);
+    if (err != ESP_OK) {
+        batch->stats.failed++;
+        batch->held = true;
+        batch->held_until_ms = batch->now_ms + batch->retry_ms;
+        return err;
+    }
+    batch->stats.flushes++;
+    batch->stats.bytes += batch->len + SAMPLE_BATCH_TAIL;
+    switch (reason) {
+        case SAMPLE_BATCH_BY_COUNT:
+            batch->stats.by_count++;
+            break;
+        case SAMPLE_BATCH_BY_AGE:
+            batch->stats.by_age++;
+            break;
+        case SAMPLE_BATCH_BY_BYTES:
+            batch->stats.by_bytes++;
+            break;
+        default:
+            break;
+    }
+    batch->len = batch->prefix_len;
+    batch->count = 0;
+    batch->held = false;
+    return ESP_OK;
+}
+
+/* Automatic flushes only, a held batch waits out its retry delay */
+static esp_err_t sample_batch_check(sample_batch_handle_t batch) {
+    if (batch->count == 0 || (batch->held && (int32_t) (batch->now_ms - batch->held_until_ms) < 0)) {
+        return ESP_OK;
+    }
+    if (batch->count >= batch->max_samples) {
+        return sample_batch_flush_reason(batch, SAMPLE_BATCH_BY_COUNT);
+    }
+    if (batch->now_ms - batch->oldest_ms >= batch->max_age_ms) {
+        return sample_batch_flush_reason(batch, SAMPLE_BATCH_BY_AGE);
+    }
+    return ESP_OK;
+}
+
+esp_err_t sample_batch_add(sample_batch_handle_t batch, const sample_batch_sample_t *sample) {
+    batch->now_ms = sample->time_ms;
+    size_t room = batch->size - SAMPLE_BATCH_TAIL - batch->len;
+    size_t len = sample_batch_encode(batch, sample, batch->body + batch->len, room);
+    if (len == 0 && batch->count) {
+        bool held = batch->held && (int32_t) (batch->now_ms - batch->held_until_ms) < 0;
+        if (held || sample_batch_flush_reason(batch, SAMPLE_BATCH_BY_BYTES) != ESP_OK) {
+            batch->stats.dropped++;
+            return ESP_ERR_NO_MEM;
+        }
+        room = batch->size - SAMPLE_BATCH_TAIL - batch->len;
+        len = sample_batch_encode(batch, sample, batch->body + batch->len, room);
+    }
+    if (len == 0) {
+        batch->stats.dropped++;
+        return ESP_ERR_INVALID_SIZE;
+    }
+    batch->len += len;
+    if (batch->count++ == 0) {
+        batch->oldest_ms = sample->time_ms;
+    }
+    batch->last_ms = sample->time_ms;
+    batch->have_last = true;
+    batch->stats.samples++;
+    return sample_batch_check(batch);
+}
+
+esp_err_t sample_batch_poll(sample_batch_handle_t batch, uint32_t now_ms) {
+    batch->now_ms = now_ms;
+    return sample_batch_check(batch);
+}
+
+esp_err_t sample_batch_flush(sample_batch_handle_t batch) {
+    return sample_batch_flush_reason(batch, SAMPLE_BATCH_BY_CALLER);
+}
+
+uint32_t sample_batch_count(sample_batch_handle_t batch) {
+    return batch->count;
+}
+
+void sample_batch_get_stats(sample_batch_handle_t batch, sample_batch_stats_t *stats) {
+    *stats = batch->stats;
+}
+
+esp_err_t sample_batch_create(const sample_batch_config_t *config, sample_batch_handle_t *ret_batch) {
+    if (config == NULL || ret_batch == NULL || config->write_api_key == NULL || config->flush_cb == NULL ||
+        config->max_samples == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sample_batch_handle_t batch = calloc(1, sizeof(struct sample_batch));
+    if (batch == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    batch->size = config->max_bytes;
+    batch->body = malloc(batch->size);
+    if (batch->body == NULL) {
+        free(batch);
+        return ESP_ERR_NO_MEM;
+    }
+    int n = snprintf(batch->body, batch->size, "{\"write_api_key\":\"%s\",\"updates\":[", config->write_api_key);
+    if (n < 0 || (size_t) n + SAMPLE_BATCH_TAIL >= batch->size) {
+        sample_batch_delete(batch);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    batch->prefix_len = batch->len = n;
+    batch->max_samples = config->max_samples;
+    batch->max_age_ms = config->max_age_ms;
+    batch->retry_ms = config->retry_ms;
+    batch->flush_cb = config->flush_cb;
+    batch->ctx = config->ctx;
+    *ret_batch = batch;
+    return ESP_OK;
+}
+
+void sample_batch_delete(sample_batch_handle_t batch) {
+    if (batch == NULL) {
+        return;
+    }
+    free(batch->body);
+    free(batch);
+}
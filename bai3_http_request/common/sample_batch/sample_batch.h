@@ -0,0 +1,70 @@
+#ifndef SAMPLE_BATCH_H
+#define SAMPLE_BATCH_H
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/* Collects timestamped samples into one ThingSpeak bulk_update.json body,
+ * {"write_api_key":"...","updates":[{"delta_t":0,"field1":20,...},...]}.
+ * Samples are encoded as they are added, so the buffer is the request body
+ * and a flush hands it out without copying. A flush happens when the batch
+ * holds max_samples, when its oldest sample is max_age_ms old, or when the
+ * next sample would not fit in max_bytes. delta_t is whole seconds since the
+ * previous sample, carried across flushes. The clock is the caller's. */
+
+#define SAMPLE_BATCH_FIELDS     8
+
+typedef struct sample_batch *sample_batch_handle_t;
+
+typedef struct {
+    uint32_t time_ms;
+    uint8_t field_mask;         /* Bit n set when fields[n] holds field<n+1> */
+    float fields[SAMPLE_BATCH_FIELDS];
+} sample_batch_sample_t;
+
+/* Uploads one body. On failure the samples stay and the flush is tried
+ * again retry_ms later. */
+typedef esp_err_t (*sample_batch_flush_cb_t) (const char *body, size_t len, uint32_t count, void *ctx);
+
+typedef struct {
+    const char *write_api_key;
+    uint32_t max_samples;
+    uint32_t max_age_ms;
+    size_t max_bytes;           /* Body buffer size */
+    uint32_t retry_ms;
+    sample_batch_flush_cb_t flush_cb;
+    void *ctx;
+} sample_batch_config_t;
+
+#define SAMPLE_BATCH_CONFIG_DEFAULT(api_key, cb) {  \
+    .write_api_key = api_key,                       \
+    .max_samples = 60,                              \
+    .max_age_ms = 60000,                            \
+    .max_bytes = 2048,                              \
+    .retry_ms = 15000,                              \
+    .flush_cb = cb,                                 \
+    .ctx = NULL,                                    \
+}
+
+typedef struct {
+    uint32_t samples;
+    uint32_t flushes;
+    uint32_t by_count;
+    uint32_t by_age;
+    uint32_t by_bytes;
+    uint32_t failed;            /* Flushes the callback refused */
+    uint32_t dropped;           /* Samples lost because a failed batch filled the buffer */
+    uint32_t bytes;             /* Body bytes handed out by successful flushes */
+} sample_batch_stats_t;
+
+esp_err_t sample_batch_create(const sample_batch_config_t *config, sample_batch_handle_t *ret_batch);
+void sample_batch_delete(sample_batch_handle_t batch);
+/* Appends a sample, flushing first or after as the thresholds require */
+esp_err_t sample_batch_add(sample_batch_handle_t batch, const sample_batch_sample_t *sample);
+/* Flushes on age, call it periodically when samples come in slowly */
+esp_err_t sample_batch_poll(sample_batch_handle_t batch, uint32_t now_ms);
+esp_err_t sample_batch_flush(sample_batch_handle_t batch);
+uint32_t sample_batch_count(sample_batch_handle_t batch);
+void sample_batch_get_stats(sample_batch_handle_t batch, sample_batch_stats_t *stats);
+
+#endif
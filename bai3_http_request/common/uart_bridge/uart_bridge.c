@@ -0,0 +1,245 @@
+#include <stdlib.h>
+#include <string.h>
+#include <esp_log.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "lwip/sockets.h"
+#include "uart_bridge.h"
+
+static const char *TAG = "uart_bridge";
+
+struct uart_bridge {
+    uart_iot_handle_t uart;
+    uart_port_t port;
+    uint16_t tcp_port;
+    int client;                 /* -1 while nobody is connected */
+    int sending;                /* Client the uplink is in send() on, -1 if none */
+    int orphan;                 /* Client that left mid send, the uplink closes it */
+    SemaphoreHandle_t client_lock;  /* Guards the three above, never held across a socket call that blocks */
+    portMUX_TYPE stats_lock;
+    TaskHandle_t uplink;
+    TickType_t latency_ticks;
+    uint8_t *batch;
+    size_t batch_size;
+    uint8_t *rx;
+    size_t rx_size;
+    uart_bridge_stats_t stats;
+};
+
+/* Runs in the uart_iot port task, the uplink does the reading */
+static void uart_bridge_event(uart_iot_handle_t uart, uart_event_t *event, void *ctx) {
+    uart_bridge_handle_t bridge = ctx;
+    if (event->type == UART_DATA || event->type == UART_BUFFER_FULL) {
+        xTaskNotifyGive(bridge->uplink);
+    }
+}
+
+/* Sends on a snapshot of the client so the downlink can hand clients over
+ * while a send is blocked on a slow reader. A client that disconnects in
+ * the meantime is shut down, which wakes the send, and closed here once
+ * the send is done with its descriptor. */
+static void uart_bridge_send(uart_bridge_handle_t bridge, size_t len) {
+    xSemaphoreTake(bridge->client_lock, portMAX_DELAY);
+    int client = bridge->client;
+    bridge->sending = client;
+    xSemaphoreGive(bridge->client_lock);
+    if (client < 0) {
+        portENTER_CRITICAL(&bridge->stats_lock);
+        bridge->stats.dropped += len;
+        portEXIT_CRITICAL(&bridge->stats_lock);
+        return;
+    }
+
+    size_t sent = 0;
+    while (sent < len) {
+        int n = send(client, bridge->batch + sent, len - sent, 0);
+        if (n < 0) {
+            ESP_LOGW(TAG, "send failed errno=%d", errno);
+            /* Wakes the downlink out of recv() so it drops the client */
+            shutdown(client, SHUT_RDWR);
+            break;
+        }
+        sent += n;
+    }
+
+    xSemaphoreTake(bridge->client_lock, portMAX_DELAY);
+    bridge->sending = -1;
+    if (bridge->orphan >= 0) {
+        close(bridge->orphan);
+        bridge->orphan = -1;
+    }
+    xSemaphoreGive(bridge->client_lock);
+    portENTER_CRITICAL(&bridge->stats_lock);
+    bridge->stats.uart_to_tcp += sent;
+    bridge->stats.sends++;
+    portEXIT_CRITICAL(&bridge->stats_lock);
+}
+
+static void uart_bridge_uplink_task(void *pvParameters) {
+    uart_bridge_handle_t bridge = (uart_bridge_handle_t) pvParameters;
+    size_t len = 0;
+    size_t buffered = 0;
+    TickType_t deadline = 0;
+    for (;;) {
+        TickType_t wait = portMAX_DELAY;
+        if (buffered) {
+            wait = 0;
+        } else if (len) {
+            TickType_t left = deadline - xTaskGetTickCount();
+            wait = (int32_t) left > 0 ? left : 0;
+        }
+        ulTaskNotifyTake(pdTRUE, wait);
+
+        uart_get_buffered_data_len(bridge->port, &buffered);
+        while (buffered && len < bridge->batch_size) {
+            size_t want = bridge->batch_size - len;
+            int n = uart_read_bytes(bridge->port, bridge->batch + len, buffered < want ? buffered : want, 0);
+            if (n <= 0) {
+                break;
+            }
+            if (len == 0) {
+                deadline = xTaskGetTickCount() + bridge->latency_ticks;
+            }
+            len += n;
+            buffered -= n;
+        }
+        if (len && (len >= bridge->batch_size || (int32_t) (xTaskGetTickCount() - deadline) >= 0)) {
+            uart_bridge_send(bridge, len);
+            len = 0;
+        }
+    }
+}
+
+static int uart_bridge_listen(uint16_t tcp_port) {
+    int s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s < 0) {
+        return -1;
+    }
+    int opt = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(tcp_port),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (bind(s, (struct sockaddr *) &addr, sizeof(addr)) != 0 || listen(s, 1) != 0) {
+        close(s);
+        return -1;
+    }
+    return s;
+}
+
+/* Accepts one client at a time and feeds whatever it sends to the UART */
+static void uart_bridge_downlink_task(void *pvParameters) {
+    uart_bridge_handle_t bridge = (uart_bridge_handle_t) pvParameters;
+    int listener;
+    while ((listener = uart_bridge_listen(bridge->tcp_port)) < 0) {
+        ESP_LOGE(TAG, "listen on port %u failed errno=%d", bridge->tcp_port, errno);
+        vTaskDelay(1000 / portTICK_PERIOD_MS);
+    }
+    ESP_LOGI(TAG, "UART%d bridged on TCP port %u", bridge->port, bridge->tcp_port);
+    for (;;) {
+        struct sockaddr_in peer;
+        socklen_t peer_len = sizeof(peer);
+        int client = accept(listener, (struct sockaddr *) &peer, &peer_len);
+        if (client < 0) {
+            ESP_LOGW(TAG, "accept failed errno=%d", errno);
+            vTaskDelay(100 / portTICK_PERIOD_MS);
+            continue;
+        }
+        int opt = 1;
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+        ESP_LOGI(TAG, "client %s connected", inet_ntoa(peer.sin_addr));
+        xSemaphoreTake(bridge->client_lock, portMAX_DELAY);
+        bridge->client = client;
+        xSemaphoreGive(bridge->client_lock);
+        portENTER_CRITICAL(&bridge->stats_lock);
+        bridge->stats.connections++;
+        portEXIT_CRITICAL(&bridge->stats_lock);
+
+        int n;
+        while ((n = recv(client, bridge->rx, bridge->rx_size, 0)) > 0) {
+            uart_write_bytes(bridge->port, (const char *) bridge->rx, n);
+            portENTER_CRITICAL(&bridge->stats_lock);
+            bridge->stats.tcp_to_uart += n;
+            portEXIT_CRITICAL(&bridge->stats_lock);
+        }
+
+        xSemaphoreTake(bridge->client_lock, portMAX_DELAY);
+        bridge->client = -1;
+        if (bridge->sending == client) {
+            shutdown(client, SHUT_RDWR);
+            bridge->orphan = client;
+        } else {
+            close(client);
+        }
+        xSemaphoreGive(bridge->client_lock);
+        ESP_LOGI(TAG, "client disconnected");
+    }
+}
+
+static void uart_bridge_free(uart_bridge_handle_t bridge) {
+    if (bridge->client_lock) {
+        vSemaphoreDelete(bridge->client_lock);
+    }
+    free(bridge->batch);
+    free(bridge->rx);
+    free(bridge);
+}
+
+esp_err_t uart_bridge_start(const uart_bridge_config_t *config, uart_bridge_handle_t *ret_bridge) {
+    if (config == NULL || ret_bridge == NULL || config->batch_size == 0 || config->rx_size == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uart_bridge_handle_t bridge = calloc(1, sizeof(struct uart_bridge));
+    if (bridge == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    bridge->client = -1;
+    bridge->sending = -1;
+    bridge->orphan = -1;
+    portMUX_INITIALIZE(&bridge->stats_lock);
+    bridge->port = config->uart.port;
+    bridge->tcp_port = config->tcp_port;
+    bridge->batch_size = config->batch_size;
+    bridge->rx_size = config->rx_size;
+    bridge->latency_ticks = config->latency_ms / portTICK_RATE_MS;
+    bridge->batch = malloc(config->batch_size);
+    bridge->rx = malloc(config->rx_size);
+    bridge->client_lock = xSemaphoreCreateMutex();
+    if (bridge->batch == NULL || bridge->rx == NULL || bridge->client_lock == NULL) {
+        uart_bridge_free(bridge);
+        return ESP_ERR_NO_MEM;
+    }
+    /* The uplink has to exist before the first UART event can notify it */
+    if (xTaskCreate(uart_bridge_uplink_task, "bridge_up", config->task_stack, bridge,
+                    config->task_priority, &bridge->uplink) != pdPASS) {
+        uart_bridge_free(bridge);
+        return ESP_ERR_NO_MEM;
+    }
+
+    uart_iot_config_t uart_config = config->uart;
+    uart_config.event_cb = uart_bridge_event;
+    uart_config.rx_cb = NULL;
+    uart_config.ctx = bridge;
+    esp_err_t err = uart_iot_create(&uart_config, &bridge->uart);
+    if (err == ESP_OK && xTaskCreate(uart_bridge_downlink_task, "bridge_down", config->task_stack, bridge,
+                                     config->task_priority, NULL) != pdPASS) {
+        uart_iot_delete(bridge->uart);
+        err = ESP_ERR_NO_MEM;
+    }
+    if (err != ESP_OK) {
+        vTaskDelete(bridge->uplink);
+        uart_bridge_free(bridge);
+        return err;
+    }
+    *ret_bridge = bridge;
+    return ESP_OK;
+}
+
+void uart_bridge_get_stats(uart_bridge_handle_t bridge, uart_bridge_stats_t *stats) {
+    portENTER_CRITICAL(&bridge->stats_lock);
+    *stats = bridge->stats;
+    portEXIT_CRITICAL(&bridge->stats_lock);
+}
@@ -0,0 +1,46 @@
+#ifndef UART_BRIDGE_H
+#define UART_BRIDGE_H
+#include "esp_err.h"
+#include "uart_iot.h"
+
+/* Serial to TCP gateway, ser2net style: one client at a time on tcp_port,
+ * bytes pass through unchanged both ways. UART data is copied from the
+ * driver ring buffer into the send batch, TCP data goes from the socket
+ * receive chunk straight into the driver. The batch goes
+ * out once it holds batch_size bytes or its first byte is latency_ms old,
+ * with Nagle off on the socket since the bridge does the batching itself. */
+
+typedef struct uart_bridge *uart_bridge_handle_t;
+
+typedef struct {
+    uart_iot_config_t uart;     /* event_cb, rx_cb and ctx are taken over by the bridge */
+    uint16_t tcp_port;
+    size_t batch_size;          /* Around one TCP segment works best */
+    uint32_t latency_ms;        /* Longest a received byte waits for its batch */
+    size_t rx_size;             /* TCP receive chunk handed to the driver */
+    uint32_t task_stack;
+    UBaseType_t task_priority;
+} uart_bridge_config_t;
+
+#define UART_BRIDGE_CONFIG_DEFAULT(uart_port, port) {   \
+    .uart = UART_IOT_CONFIG_DEFAULT(uart_port),         \
+    .tcp_port = port,                                   \
+    .batch_size = 1460,                                 \
+    .latency_ms = 20,                                   \
+    .rx_size = 512,                                     \
+    .task_stack = 3072,                                 \
+    .task_priority = 8,                                 \
+}
+
+typedef struct {
+    uint32_t uart_to_tcp;
+    uint32_t tcp_to_uart;
+    uint32_t sends;             /* uart_to_tcp / sends is the batching gain */
+    uint32_t connections;
+    uint32_t dropped;           /* UART bytes that arrived with no client connected */
+} uart_bridge_stats_t;
+
+esp_err_t uart_bridge_start(const uart_bridge_config_t *config, uart_bridge_handle_t *ret_bridge);
+void uart_bridge_get_stats(uart_bridge_handle_t bridge, uart_bridge_stats_t *stats);
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef UART_SHELL_H
+#define UART_SHELL_H
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Streaming line framer and command dispatcher. Chunks can split a line anywhere,
+ * the partial line is kept until its terminator arrives. Commands are looked up in
+ * an open addressing hash table built once by uart_shell_init(). Pure C so it can
+ * be exercised off-target. */
+
+#define UART_SHELL_LINE_MAX         128
+#define UART_SHELL_MAX_COMMANDS     32
+#define UART_SHELL_SLOTS            64      /* Power of two, at least twice UART_SHELL_MAX_COMMANDS */
+
+/* args is not terminated, it runs for len bytes after the "name=" or "name " prefix */
+typedef void (*uart_shell_handler_t) (const char *args, size_t len, void *ctx);
+
+typedef struct {
+    const char *name;
+    uart_shell_handler_t handler;
+    void *ctx;
+} uart_shell_command_t;
+
+typedef struct {
+    uint32_t lines;
+    uint32_t unknown;
+    uint32_t overflows;     /* Lines dropped for exceeding UART_SHELL_LINE_MAX */
+} uart_shell_stats_t;
+
+typedef struct {
+    const uart_shell_command_t *commands;
+    size_t command_count;
+    uint32_t hashes[UART_SHELL_MAX_COMMANDS];
+    uint8_t slots[UART_SHELL_SLOTS];        /* Command index + 1, 0 marks an empty slot */
+    char line[UART_SHELL_LINE_MAX];
+    size_t line_len;
+    bool discarding;
+    uart_shell_stats_t stats;
+} uart_shell_t;
+
+/* Returns false when there are too many or duplicate commands */
+bool uart_shell_init(uart_shell_t *shell, const uart_shell_command_t *commands, size_t count);
+void uart_shell_feed(uart_shell_t *shell, const uint8_t *data, size_t len);
+/* Run one complete line, returns false if no command matched */
+bool uart_shell_dispatch(uart_shell_t *shell, const char *line, size_t len);
+/* Parse a decimal integer from a non-terminated argument */
+bool uart_shell_parse_int(const char *args, size_t len, int *value);
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef UART_TELEMETRY_H
+#define UART_TELEMETRY_H
+#include <stdbool.h>
+#include "esp_err.h"
+#include "uart_tx.h"
+#include "uart_frame.h"
+
+typedef struct uart_telemetry *uart_telemetry_handle_t;
+
+typedef struct {
+    bool crc32;                 /* CRC-32 instead of CRC-16 on every frame */
+    uint32_t ack_timeout_ms;    /* Wait per attempt for acked frames */
+    uint8_t retries;            /* Resends of an unacked frame before giving up */
+} uart_telemetry_config_t;
+
+#define UART_TELEMETRY_CONFIG_DEFAULT() {   \
+    .crc32 = false,                         \
+    .ack_timeout_ms = 100,                  \
+    .retries = 3,                           \
+}
+
+typedef struct {
+    uint32_t frames;
+    uint32_t samples;
+    uint32_t retransmits;
+    uint32_t ack_failures;
+    uint32_t encode_errors;     /* Batches that failed to encode */
+    uint32_t dropped;           /* Samples lost to those, to a full tx queue, or refused by add */
+} uart_telemetry_stats_t;
+
+/* Frames go out through tx as producer, so they never split other writes */
+esp_err_t uart_telemetry_create(uart_tx_handle_t tx, uint8_t producer, const uart_telemetry_config_t *config,
+                                uart_telemetry_handle_t *ret_telemetry);
+void uart_telemetry_delete(uart_telemetry_handle_t telemetry);
+/* Queues a sample in the current batch, a full batch goes out unacked first.
+ * Fails, and counts the sample as dropped, when that send fails. */
+esp_err_t uart_telemetry_add(uart_telemetry_handle_t telemetry, uint8_t id, const void *data, uint8_t len);
+/* Sends the current batch. With ack set this blocks until the peer acks the
+ * sequence number or the retries run out (ESP_ERR_TIMEOUT), so it must not
+ * be called from the port's own task. */
+esp_err_t uart_telemetry_flush(uart_telemetry_handle_t telemetry, bool ack);
+/* Hand received bytes over from the port's rx callback to pick up acks */
+void uart_telemetry_feed(uart_telemetry_handle_t telemetry, const uint8_t *data, size_t len);
+void uart_telemetry_get_stats(uart_telemetry_handle_t telemetry, uart_telemetry_stats_t *stats);
+
+#endif
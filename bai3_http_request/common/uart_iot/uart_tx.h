@@ -0,0 +1,58 @@
+#ifndef UART_TX_H
+#define UART_TX_H
+#include <stdbool.h>
+#include "esp_err.h"
+#include "uart_iot.h"
+
+/* Asynchronous transmit path for a uart_iot port. Producers never touch the
+ * driver: they claim slots in a lock-free queue and return, a worker task
+ * gathers small writes into one buffer and hands it to the driver once it is
+ * full or the oldest byte has waited flush_deadline_ms. Writes are task
+ * context only, the worker is woken with a task notification. */
+
+#define UART_TX_MAX_PRODUCERS   8
+#define UART_TX_SLOT_DATA       48      /* Bytes copied per slot, longer writes take several in a row */
+
+typedef struct uart_tx *uart_tx_handle_t;
+
+/* Called from the worker once a referenced buffer has gone to the driver */
+typedef void (*uart_tx_done_cb_t) (const uint8_t *data, size_t len, void *ctx);
+
+typedef struct {
+    uint32_t slot_count;        /* Power of two */
+    size_t coalesce_size;       /* Driver write size the worker aims for */
+    uint32_t flush_deadline_ms;
+    uint32_t task_stack;
+    UBaseType_t task_priority;
+    BaseType_t task_core;
+} uart_tx_config_t;
+
+#define UART_TX_CONFIG_DEFAULT() {  \
+    .slot_count = 64,               \
+    .coalesce_size = 256,           \
+    .flush_deadline_ms = 10,        \
+    .task_stack = 2048,             \
+    .task_priority = 10,            \
+    .task_core = tskNO_AFFINITY,    \
+}
+
+typedef struct {
+    uint32_t bytes[UART_TX_MAX_PRODUCERS];
+    uint32_t dropped[UART_TX_MAX_PRODUCERS];   /* Bytes refused because the queue was full */
+    uint32_t high_water;                        /* Most slots ever in use */
+    uint32_t writes;                            /* Driver writes, bytes / writes is the coalescing gain */
+} uart_tx_stats_t;
+
+esp_err_t uart_tx_create(uart_iot_handle_t uart, const uart_tx_config_t *config, uart_tx_handle_t *ret_tx);
+esp_err_t uart_tx_delete(uart_tx_handle_t tx);
+/* Copies data into the queue as one unit, it never interleaves with other
+ * producers. ESP_ERR_NO_MEM means there weren't enough free slots, and
+ * ESP_ERR_INVALID_SIZE that data is longer than the whole queue; either way
+ * none of it is sent and it is counted as dropped against the producer. */
+esp_err_t uart_tx_write(uart_tx_handle_t tx, uint8_t producer, const void *data, size_t len);
+/* Queues data by reference, it must stay valid until done_cb runs */
+esp_err_t uart_tx_write_ref(uart_tx_handle_t tx, uint8_t producer, const void *data, size_t len,
+                            uart_tx_done_cb_t done_cb, void *ctx);
+void uart_tx_get_stats(uart_tx_handle_t tx, uart_tx_stats_t *stats);
+
+#endif
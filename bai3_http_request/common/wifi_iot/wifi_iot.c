@@ -1,5 +1,9 @@
 #include <stdio.h>
 #include <esp_log.h>
+#include <stdlib.h>
+#include <esp_timer.h>
+#include "esp_system.h"
+#include "nvs.h"
 #include "wifi_iot.h"
 
 /* The examples use WiFi configuration that you can set via project configuration menu
@@ -10,71 +14,479 @@
 #define EXAMPLE_ESP_WIFI_SSID      CONFIG_ESP_WIFI_SSID
 #define EXAMPLE_ESP_WIFI_PASS      CONFIG_ESP_WIFI_PASSWORD
 #define EXAMPLE_ESP_MAXIMUM_RETRY  CONFIG_ESP_MAXIMUM_RETRY
+#define WIFI_BACKOFF_BASE_MS       CONFIG_ESP_WIFI_BACKOFF_BASE_MS
+#define WIFI_BACKOFF_MAX_MS        CONFIG_ESP_WIFI_BACKOFF_MAX_MS
+#define WIFI_MIN_RSSI              CONFIG_ESP_WIFI_MIN_RSSI
+#define WIFI_ROAM_RSSI             CONFIG_ESP_WIFI_ROAM_RSSI
+#define WIFI_ROAM_WINDOW           CONFIG_ESP_WIFI_ROAM_WINDOW
+#define WIFI_ROAM_INTERVAL_MS      CONFIG_ESP_WIFI_ROAM_INTERVAL_MS
+#define WIFI_ROAM_MARGIN_DB        CONFIG_ESP_WIFI_ROAM_MARGIN_DB
+#define WIFI_SCAN_MAX_APS          16
 
 static const char *TAG = "example";
 
-/* FreeRTOS event group to signal when we are connected*/
+/* FreeRTOS event group to signal when we are connected. It lives for the whole
+ * run, so tasks can wait on it whenever the link matters to them. */
 static EventGroupHandle_t s_wifi_event_group;
 
-/* The event group allows multiple bits for each event, but we only care about two events:
- * - we are connected to the AP with an IP
- * - we failed to connect after the maximum amount of retries */
-#define WIFI_CONNECTED_BIT BIT0
-#define WIFI_FAIL_BIT      BIT1
+static wifi_iot_status_t s_status;
+static portMUX_TYPE s_status_lock = portMUX_INITIALIZER_UNLOCKED;
+static esp_timer_handle_t s_retry_timer = NULL;
+static wifi_iot_cb_t s_cb = NULL;
+static void *s_cb_ctx = NULL;
+static esp_netif_t *s_netif = NULL;
+static wifi_config_t s_wifi_config;
 
-static int s_retry_num = 0;
+#define WIFI_NVS_NAMESPACE      "wifi_iot"
+#define WIFI_CACHE_KEY          "fast"
+#define WIFI_PROFILES_KEY       "profiles"
+
+/* AP profiles, from NVS or the single menuconfig SSID when NVS has none */
+static wifi_profile_t s_profiles[WIFI_IOT_MAX_PROFILES];
+static size_t s_profile_count;
+static portMUX_TYPE s_profiles_lock = portMUX_INITIALIZER_UNLOCKED;
+static int s_profile = -1;              /* Profile of the current attempt */
+
+static esp_timer_handle_t s_roam_timer = NULL;
+static wifi_roam_t s_roam;
+static volatile bool s_scanning = false;
+static volatile bool s_roam_scan = false;       /* Scan was started to look for a better AP */
+/* Scan state is shared by the event handler and the timers */
+static portMUX_TYPE s_scan_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool s_roaming = false;          /* Disconnect was ours, target already configured */
+
+/* Last good association, kept in NVS so the next boot can skip the scan */
+
+typedef struct {
+    uint8_t ssid[32];           /* Cache only applies to the SSID it was made for */
+    uint8_t bssid[6];
+    uint8_t channel;
+    esp_netif_ip_info_t ip_info;
+    esp_ip4_addr_t dns;
+} wifi_iot_cache_t;
+
+static wifi_iot_cache_t s_cache;       /* As stored in NVS */
+static uint8_t s_bssid[6];              /* AP of the current association */
+static uint8_t s_channel;
+static bool s_cache_valid = false;
+static bool s_fast_attempt = false;     /* Current attempt is the directed one */
+static bool s_static_ip = false;        /* DHCP is stopped for the cached lease */
+static int64_t s_connect_start_us;
+
+static void wifi_iot_cache_load(void)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(WIFI_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return;
+    }
+    size_t len = sizeof(s_cache);
+    s_cache_valid = nvs_get_blob(nvs, WIFI_CACHE_KEY, &s_cache, &len) == ESP_OK && len == sizeof(s_cache);
+    nvs_close(nvs);
+}
+
+static void wifi_iot_cache_save(const wifi_iot_cache_t *cache)
+{
+    if (s_cache_valid && memcmp(cache, &s_cache, sizeof(s_cache)) == 0) {
+        return;
+    }
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(WIFI_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(nvs, WIFI_CACHE_KEY, cache, sizeof(*cache));
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "saving fast reconnect cache failed: %s", esp_err_to_name(err));
+        return;
+    }
+    s_cache = *cache;
+    s_cache_valid = true;
+}
+
+static void wifi_iot_profiles_load(void)
+{
+    nvs_handle_t nvs;
+    size_t len = sizeof(s_profiles);
+    if (nvs_open(WIFI_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+        if (nvs_get_blob(nvs, WIFI_PROFILES_KEY, s_profiles, &len) == ESP_OK) {
+            s_profile_count = len / sizeof(wifi_profile_t);
+        }
+        nvs_close(nvs);
+    }
+    if (s_profile_count == 0) {
+        snprintf(s_profiles[0].ssid, sizeof(s_profiles[0].ssid), "%s", EXAMPLE_ESP_WIFI_SSID);
+        snprintf(s_profiles[0].password, sizeof(s_profiles[0].password), "%s", EXAMPLE_ESP_WIFI_PASS);
+        s_profiles[0].priority = 0;
+        s_profile_count = 1;
+    }
+}
+
+static int wifi_iot_profile_find(const uint8_t *ssid)
+{
+    for (size_t i = 0; i < s_profile_count; i++) {
+        if (strncmp(s_profiles[i].ssid, (const char *) ssid, 32) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Points the station at one AP of one profile, no scan of its own */
+static void wifi_iot_config_target(int profile, const uint8_t *bssid, uint8_t channel)
+{
+    portENTER_CRITICAL(&s_profiles_lock);
+    memcpy(s_wifi_config.sta.ssid, s_profiles[profile].ssid, sizeof(s_wifi_config.sta.ssid));
+    memcpy(s_wifi_config.sta.password, s_profiles[profile].password, sizeof(s_wifi_config.sta.password));
+    portEXIT_CRITICAL(&s_profiles_lock);
+    memcpy(s_wifi_config.sta.bssid, bssid, sizeof(s_wifi_config.sta.bssid));
+    s_wifi_config.sta.bssid_set = true;
+    s_wifi_config.sta.channel = channel;
+    s_wifi_config.sta.scan_method = WIFI_FAST_SCAN;
+    s_profile = profile;
+    esp_wifi_set_config(WIFI_IF_STA, &s_wifi_config);
+}
+
+/* Leaves the cached lease, anything but the fast path needs DHCP again */
+static void wifi_iot_dhcp_restore(void)
+{
+    s_fast_attempt = false;
+    if (s_static_ip) {
+        esp_netif_dhcpc_start(s_netif);
+        s_static_ip = false;
+    }
+}
+
+static void wifi_iot_connect(void)
+{
+    if (s_connect_start_us == 0) {
+        s_connect_start_us = esp_timer_get_time();
+    }
+    esp_wifi_connect();
+}
+
+static void wifi_iot_notify(wifi_iot_event_t event)
+{
+    if (s_cb) {
+        s_cb(event, s_cb_ctx);
+    }
+}
+
+static void wifi_iot_set_link(wifi_iot_link_t link)
+{
+    portENTER_CRITICAL(&s_status_lock);
+    s_status.link = link;
+    portEXIT_CRITICAL(&s_status_lock);
+}
+
+/* Capped exponential backoff with equal jitter: the delay is at least half the
+ * step, so retries stay spaced out, and the random half spreads a fleet that
+ * lost the same AP at the same moment. */
+static uint32_t wifi_iot_backoff_ms(uint32_t attempt)
+{
+    uint32_t step = WIFI_BACKOFF_MAX_MS;
+    if (attempt < 16 && ((uint32_t) WIFI_BACKOFF_BASE_MS << attempt) < WIFI_BACKOFF_MAX_MS) {
+        step = (uint32_t) WIFI_BACKOFF_BASE_MS << attempt;
+    }
+    return step / 2 + esp_random() % (step / 2 + 1);
+}
+
+/* Never give up, just back off further with every failed attempt */
+static void wifi_iot_schedule_retry(void)
+{
+    uint32_t delay_ms = wifi_iot_backoff_ms(s_status.attempt);
+    portENTER_CRITICAL(&s_status_lock);
+    s_status.attempt++;
+    s_status.next_retry_ms = delay_ms;
+    s_status.link = WIFI_IOT_LINK_BACKOFF;
+    portEXIT_CRITICAL(&s_status_lock);
+    if (s_status.attempt == EXAMPLE_ESP_MAXIMUM_RETRY) {
+        xEventGroupSetBits(s_wifi_event_group, WIFI_IOT_FAIL_BIT);
+        wifi_iot_notify(WIFI_IOT_EVENT_FAILED);
+    }
+    ESP_LOGI(TAG, "retry %u to connect to the AP in %u ms", s_status.attempt, delay_ms);
+    esp_timer_start_once(s_retry_timer, (uint64_t) delay_ms * 1000);
+    wifi_iot_notify(WIFI_IOT_EVENT_BACKOFF);
+}
+
+static void wifi_iot_scan(bool roam)
+{
+    portENTER_CRITICAL(&s_scan_lock);
+    s_roam_scan = roam;
+    s_scanning = true;
+    portEXIT_CRITICAL(&s_scan_lock);
+    if (esp_wifi_scan_start(NULL, false) != ESP_OK) {
+        s_scanning = false;
+        if (!roam) {
+            wifi_iot_schedule_retry();
+        }
+    }
+}
+
+/* One connection attempt: the cached AP straight away the first time, a scan
+ * and ranking of every profile after that */
+static void wifi_iot_attempt(void)
+{
+    wifi_iot_set_link(WIFI_IOT_LINK_CONNECTING);
+    if (s_connect_start_us == 0) {
+        s_connect_start_us = esp_timer_get_time();
+    }
+    /* The link dropped while a roam scan was running. Starting another scan
+     * would fail and a connect would race the scan, so that scan becomes
+     * this attempt and wifi_iot_scan_done connects from its results. */
+    portENTER_CRITICAL(&s_scan_lock);
+    bool scanning = s_scanning;
+    s_roam_scan = false;
+    portEXIT_CRITICAL(&s_scan_lock);
+    if (scanning) {
+        ESP_LOGI(TAG, "scan already running, connecting from its results");
+        return;
+    }
+#if CONFIG_ESP_WIFI_FAST_RECONNECT
+    static bool fast_tried = false;
+    int profile = s_cache_valid ? wifi_iot_profile_find(s_cache.ssid) : -1;
+    if (!fast_tried && profile >= 0) {
+        fast_tried = true;
+        ESP_LOGI(TAG, "fast reconnect to cached AP on channel %d", s_cache.channel);
+        wifi_iot_config_target(profile, s_cache.bssid, s_cache.channel);
+        s_fast_attempt = true;
+        wifi_iot_connect();
+        return;
+    }
+#endif
+    wifi_iot_dhcp_restore();
+    wifi_iot_scan(false);
+}
+
+static void wifi_iot_retry_timer_cb(void *arg)
+{
+    wifi_iot_attempt();
+}
+
+static void wifi_iot_roam_timer_cb(void *arg)
+{
+    wifi_ap_record_t ap;
+    if (s_status.link != WIFI_IOT_LINK_UP || s_scanning || esp_wifi_sta_get_ap_info(&ap) != ESP_OK) {
+        return;
+    }
+    if (wifi_roam_sample(&s_roam, ap.rssi)) {
+        ESP_LOGI(TAG, "RSSI %d below %d for %d samples, looking for a better AP", ap.rssi, WIFI_ROAM_RSSI, WIFI_ROAM_WINDOW);
+        wifi_iot_scan(true);
+    }
+}
+
+static void wifi_iot_scan_done(void)
+{
+    uint16_t count = WIFI_SCAN_MAX_APS;
+    wifi_ap_record_t *records = calloc(count, sizeof(wifi_ap_record_t));
+    wifi_select_ap_t *aps = calloc(count, sizeof(wifi_select_ap_t));
+    portENTER_CRITICAL(&s_scan_lock);
+    bool roam = s_roam_scan;
+    s_scanning = false;
+    portEXIT_CRITICAL(&s_scan_lock);
+    if (records == NULL || aps == NULL || esp_wifi_scan_get_ap_records(&count, records) != ESP_OK) {
+        count = 0;
+    }
+    for (int i = 0; i < count; i++) {
+        memcpy(aps[i].ssid, records[i].ssid, sizeof(aps[i].ssid) - 1);
+        memcpy(aps[i].bssid, records[i].bssid, sizeof(aps[i].bssid));
+        aps[i].channel = records[i].primary;
+        aps[i].rssi = records[i].rssi;
+    }
+
+    wifi_select_candidate_t best[2];
+    portENTER_CRITICAL(&s_profiles_lock);
+    size_t found = wifi_select_rank(s_profiles, s_profile_count, aps, count, WIFI_MIN_RSSI, best, 2);
+    int current_score = INT16_MIN;
+    for (int i = 0; roam && s_profile >= 0 && i < count; i++) {
+        if (memcmp(aps[i].bssid, s_bssid, sizeof(s_bssid)) == 0) {
+            current_score = wifi_select_score(&s_profiles[s_profile], aps[i].rssi);
+        }
+    }
+    portEXIT_CRITICAL(&s_profiles_lock);
+
+    if (roam) {
+        /* The current AP may well rank first, the best other one has to beat it clearly */
+        const wifi_select_candidate_t *target = NULL;
+        for (size_t i = 0; i < found && target == NULL; i++) {
+            if (memcmp(aps[best[i].ap].bssid, s_bssid, sizeof(s_bssid)) != 0) {
+                target = &best[i];
+            }
+        }
+        if (target && s_status.link == WIFI_IOT_LINK_UP && target->score >= current_score + WIFI_ROAM_MARGIN_DB) {
+            ESP_LOGI(TAG, "roaming to %s on channel %d, RSSI %d", aps[target->ap].ssid,
+                     aps[target->ap].channel, aps[target->ap].rssi);
+            s_roaming = true;
+            wifi_iot_config_target(target->profile, aps[target->ap].bssid, aps[target->ap].channel);
+            esp_wifi_disconnect();
+        }
+    } else if (found) {
+        ESP_LOGI(TAG, "connecting to %s on channel %d, RSSI %d", aps[best[0].ap].ssid,
+                 aps[best[0].ap].channel, aps[best[0].ap].rssi);
+        wifi_iot_config_target(best[0].profile, aps[best[0].ap].bssid, aps[best[0].ap].channel);
+        wifi_iot_connect();
+    } else {
+        ESP_LOGI(TAG, "no known AP in range");
+        portENTER_CRITICAL(&s_status_lock);
+        s_status.disconnects[WIFI_IOT_REASON_NO_AP]++;
+        portEXIT_CRITICAL(&s_status_lock);
+        wifi_iot_schedule_retry();
+    }
+    free(records);
+    free(aps);
+}
+
+static wifi_iot_reason_t wifi_iot_reason(uint8_t reason)
+{
+    switch (reason) {
+        case WIFI_REASON_NO_AP_FOUND:
+            return WIFI_IOT_REASON_NO_AP;
+        case WIFI_REASON_AUTH_FAIL:
+        case WIFI_REASON_AUTH_EXPIRE:
+        case WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT:
+        case WIFI_REASON_HANDSHAKE_TIMEOUT:
+            return WIFI_IOT_REASON_AUTH;
+        case WIFI_REASON_ASSOC_FAIL:
+        case WIFI_REASON_ASSOC_EXPIRE:
+        case WIFI_REASON_ASSOC_LEAVE:
+        case WIFI_REASON_ASSOC_TOOMANY:
+        case WIFI_REASON_CONNECTION_FAIL:
+            return WIFI_IOT_REASON_ASSOC;
+        case WIFI_REASON_BEACON_TIMEOUT:
+            return WIFI_IOT_REASON_BEACON;
+        default:
+            return WIFI_IOT_REASON_OTHER;
+    }
+}
 
 static void event_handler(void* arg, esp_event_base_t event_base,
                                 int32_t event_id, void* event_data)
 {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-        esp_wifi_connect();
+        wifi_iot_attempt();
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_SCAN_DONE) {
+        wifi_iot_scan_done();
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        wifi_event_sta_connected_t* event = (wifi_event_sta_connected_t*) event_data;
+        memcpy(s_bssid, event->bssid, sizeof(s_bssid));
+        s_channel = event->channel;
+#if CONFIG_ESP_WIFI_REUSE_IP
+        /* Setting the address posts IP_EVENT_STA_GOT_IP, no DHCP round trip */
+        if (s_fast_attempt && s_cache_valid && esp_netif_dhcpc_stop(s_netif) == ESP_OK) {
+            s_static_ip = true;
+            esp_netif_dns_info_t dns = { .ip.u_addr.ip4 = s_cache.dns, .ip.type = ESP_IPADDR_TYPE_V4 };
+            esp_netif_set_ip_info(s_netif, &s_cache.ip_info);
+            esp_netif_set_dns_info(s_netif, ESP_NETIF_DNS_MAIN, &dns);
+        }
+#endif
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        if (s_retry_num < EXAMPLE_ESP_MAXIMUM_RETRY) {
-            esp_wifi_connect();
-            s_retry_num++;
-            ESP_LOGI(TAG, "retry to connect to the AP");
+        wifi_event_sta_disconnected_t* event = (wifi_event_sta_disconnected_t*) event_data;
+        bool was_connected = xEventGroupGetBits(s_wifi_event_group) & WIFI_IOT_CONNECTED_BIT;
+        portENTER_CRITICAL(&s_status_lock);
+        s_status.disconnects[wifi_iot_reason(event->reason)]++;
+        s_status.last_reason = event->reason;
+        portEXIT_CRITICAL(&s_status_lock);
+        ESP_LOGI(TAG, "disconnected, reason %d", event->reason);
+        if (was_connected) {
+            xEventGroupClearBits(s_wifi_event_group, WIFI_IOT_CONNECTED_BIT);
+            s_connect_start_us = 0;
+            wifi_iot_notify(WIFI_IOT_EVENT_LOST);
+        }
+        if (s_roaming) {
+            /* Our own disconnect, the better AP is already configured */
+            s_roaming = false;
+            portENTER_CRITICAL(&s_status_lock);
+            s_status.roams++;
+            portEXIT_CRITICAL(&s_status_lock);
+            wifi_iot_dhcp_restore();
+            wifi_iot_set_link(WIFI_IOT_LINK_CONNECTING);
+            wifi_iot_connect();
+        } else if (s_fast_attempt && !was_connected) {
+            /* Cached AP is gone or moved, scan like a first boot without using up a retry */
+            ESP_LOGI(TAG, "fast reconnect failed, falling back to a full scan");
+            wifi_iot_attempt();
         } else {
-            xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
+            wifi_iot_schedule_retry();
         }
-        ESP_LOGI(TAG,"connect to the AP fail");
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
-        ESP_LOGI(TAG, "got ip:" IPSTR, IP2STR(&event->ip_info.ip));
-        s_retry_num = 0;
-        xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+        ESP_LOGI(TAG, "got ip:" IPSTR " in %d ms (%s)", IP2STR(&event->ip_info.ip),
+                 (int) ((esp_timer_get_time() - s_connect_start_us) / 1000), s_fast_attempt ? "fast" : "scan");
+        s_connect_start_us = 0;
+        portENTER_CRITICAL(&s_status_lock);
+        s_status.attempt = 0;
+        s_status.next_retry_ms = 0;
+        s_status.connects++;
+        s_status.link = WIFI_IOT_LINK_UP;
+        portEXIT_CRITICAL(&s_status_lock);
+        wifi_roam_init(&s_roam, WIFI_ROAM_RSSI, WIFI_ROAM_WINDOW);
+        /* A lease reused from the cache is not news, only DHCP results get saved */
+        if (!s_static_ip) {
+            wifi_iot_cache_t cache = { 0 };
+            memcpy(cache.ssid, s_wifi_config.sta.ssid, sizeof(cache.ssid));
+            memcpy(cache.bssid, s_bssid, sizeof(cache.bssid));
+            cache.channel = s_channel;
+            cache.ip_info = event->ip_info;
+            esp_netif_dns_info_t dns;
+            if (esp_netif_get_dns_info(s_netif, ESP_NETIF_DNS_MAIN, &dns) == ESP_OK) {
+                cache.dns = dns.ip.u_addr.ip4;
+            }
+            wifi_iot_cache_save(&cache);
+        }
+        xEventGroupClearBits(s_wifi_event_group, WIFI_IOT_FAIL_BIT);
+        xEventGroupSetBits(s_wifi_event_group, WIFI_IOT_CONNECTED_BIT);
+        wifi_iot_notify(WIFI_IOT_EVENT_CONNECTED);
     }
 }
 
-void wifi_init_sta(void)
+esp_err_t wifi_iot_start(wifi_iot_cb_t cb, void *ctx)
 {
+    if (s_wifi_event_group) {
+        return ESP_ERR_INVALID_STATE;
+    }
     s_wifi_event_group = xEventGroupCreate();
+    if (s_wifi_event_group == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_cb = cb;
+    s_cb_ctx = ctx;
+
+    const esp_timer_create_args_t retry_timer_args = {
+        .callback = wifi_iot_retry_timer_cb,
+        .name = "wifi_retry",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&retry_timer_args, &s_retry_timer));
+    const esp_timer_create_args_t roam_timer_args = {
+        .callback = wifi_iot_roam_timer_cb,
+        .name = "wifi_roam",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&roam_timer_args, &s_roam_timer));
 
     ESP_ERROR_CHECK(esp_netif_init());
 
     ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_sta();
+    s_netif = esp_netif_create_default_wifi_sta();
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
 
-    esp_event_handler_instance_t instance_any_id;
-    esp_event_handler_instance_t instance_got_ip;
+    /* Handlers stay registered for good, later disconnects must still be reported */
     ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT,
                                                         ESP_EVENT_ANY_ID,
                                                         &event_handler,
                                                         NULL,
-                                                        &instance_any_id));
+                                                        NULL));
     ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT,
                                                         IP_EVENT_STA_GOT_IP,
                                                         &event_handler,
                                                         NULL,
-                                                        &instance_got_ip));
+                                                        NULL));
 
-    wifi_config_t wifi_config = {
+    /* SSID, password and AP are filled in per attempt from the profile table */
+    s_wifi_config = (wifi_config_t) {
         .sta = {
-            .ssid = EXAMPLE_ESP_WIFI_SSID,
-            .password = EXAMPLE_ESP_WIFI_PASS,
             /* Setting a password implies station will connect to all security modes including WEP/WPA.
              * However these modes are deprecated and not advisable to be used. Incase your Access point
              * doesn't support WPA2, these mode can be enabled by commenting below line */
@@ -86,34 +498,87 @@ void wifi_init_sta(void)
             },
         },
     };
+    wifi_iot_profiles_load();
+#if CONFIG_ESP_WIFI_FAST_RECONNECT
+    wifi_iot_cache_load();
+#endif
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA) );
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config) );
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &s_wifi_config) );
     ESP_ERROR_CHECK(esp_wifi_start() );
+    ESP_ERROR_CHECK(esp_timer_start_periodic(s_roam_timer, (uint64_t) WIFI_ROAM_INTERVAL_MS * 1000));
+
+    ESP_LOGI(TAG, "wifi_iot_start finished.");
+    return ESP_OK;
+}
+
+void wifi_iot_get_status(wifi_iot_status_t *status)
+{
+    portENTER_CRITICAL(&s_status_lock);
+    *status = s_status;
+    portEXIT_CRITICAL(&s_status_lock);
+}
 
-    ESP_LOGI(TAG, "wifi_init_sta finished.");
+esp_err_t wifi_iot_set_profiles(const wifi_profile_t *profiles, size_t count)
+{
+    if (profiles == NULL || count == 0 || count > WIFI_IOT_MAX_PROFILES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(WIFI_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_blob(nvs, WIFI_PROFILES_KEY, profiles, count * sizeof(wifi_profile_t));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    if (err == ESP_OK) {
+        /* Used from the next scan on */
+        portENTER_CRITICAL(&s_profiles_lock);
+        memcpy(s_profiles, profiles, count * sizeof(wifi_profile_t));
+        s_profile_count = count;
+        s_profile = -1;
+        portEXIT_CRITICAL(&s_profiles_lock);
+    }
+    return err;
+}
 
-    /* Waiting until either the connection is established (WIFI_CONNECTED_BIT) or connection failed for the maximum
-     * number of re-tries (WIFI_FAIL_BIT). The bits are set by event_handler() (see above) */
+size_t wifi_iot_get_profiles(wifi_profile_t *profiles, size_t max)
+{
+    portENTER_CRITICAL(&s_profiles_lock);
+    size_t count = s_profile_count < max ? s_profile_count : max;
+    memcpy(profiles, s_profiles, count * sizeof(wifi_profile_t));
+    portEXIT_CRITICAL(&s_profiles_lock);
+    return count;
+}
+
+EventGroupHandle_t wifi_iot_get_event_group(void)
+{
+    return s_wifi_event_group;
+}
+
+bool wifi_iot_wait_connected(TickType_t timeout)
+{
     EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
-            WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
+            WIFI_IOT_CONNECTED_BIT | WIFI_IOT_FAIL_BIT,
             pdFALSE,
             pdFALSE,
-            portMAX_DELAY);
+            timeout);
+    return (bits & WIFI_IOT_CONNECTED_BIT) != 0;
+}
 
-    /* xEventGroupWaitBits() returns the bits before the call returned, hence we can test which event actually
-     * happened. */
-    if (bits & WIFI_CONNECTED_BIT) {
+void wifi_init_sta(void)
+{
+    ESP_ERROR_CHECK(wifi_iot_start(NULL, NULL));
+
+    /* Waiting until either the connection is established (WIFI_IOT_CONNECTED_BIT) or connection failed for the maximum
+     * number of re-tries (WIFI_IOT_FAIL_BIT). The bits are set by event_handler() (see above) */
+    if (wifi_iot_wait_connected(portMAX_DELAY)) {
         ESP_LOGI(TAG, "connected to ap SSID:%s password:%s",
                  EXAMPLE_ESP_WIFI_SSID, EXAMPLE_ESP_WIFI_PASS);
-    } else if (bits & WIFI_FAIL_BIT) {
+    } else {
         ESP_LOGI(TAG, "Failed to connect to SSID:%s, password:%s",
                  EXAMPLE_ESP_WIFI_SSID, EXAMPLE_ESP_WIFI_PASS);
-    } else {
-        ESP_LOGE(TAG, "UNEXPECTED EVENT");
     }
-
-    /* The event will not be processed after unregister */
-    ESP_ERROR_CHECK(esp_event_handler_instance_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, instance_got_ip));
-    ESP_ERROR_CHECK(esp_event_handler_instance_unregister(WIFI_EVENT, ESP_EVENT_ANY_ID, instance_any_id));
-    vEventGroupDelete(s_wifi_event_group);
-}
\ No newline at end of file
+}
@@ -2,6 +2,7 @@
 #define WIFI_IOT_H
 #include <esp_log.h>
 #include <stdio.h>
+#include <stdbool.h>
 #include <string.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
@@ -25,7 +26,64 @@
 
 #include "lwip/err.h"
 #include "lwip/sys.h"
+#include "wifi_select.h"
 
+#define WIFI_IOT_MAX_PROFILES   4
+
+/* Bits of the event group returned by wifi_iot_get_event_group(). CONNECTED
+ * follows the link, FAIL is set after CONFIG_ESP_MAXIMUM_RETRY failed attempts
+ * in a row and cleared by the next connection. */
+#define WIFI_IOT_CONNECTED_BIT  BIT0
+#define WIFI_IOT_FAIL_BIT       BIT1
+
+typedef enum {
+    WIFI_IOT_EVENT_CONNECTED,   /* Got an IP */
+    WIFI_IOT_EVENT_LOST,        /* Was connected, reconnecting */
+    WIFI_IOT_EVENT_FAILED,      /* CONFIG_ESP_MAXIMUM_RETRY attempts failed, still retrying */
+    WIFI_IOT_EVENT_BACKOFF,     /* Next attempt scheduled, see wifi_iot_get_status() */
+} wifi_iot_event_t;
+
+typedef enum {
+    WIFI_IOT_LINK_DOWN,
+    WIFI_IOT_LINK_CONNECTING,
+    WIFI_IOT_LINK_BACKOFF,
+    WIFI_IOT_LINK_UP,
+} wifi_iot_link_t;
+
+/* Disconnect reasons folded into the causes that need different fixes in the field */
+typedef enum {
+    WIFI_IOT_REASON_NO_AP,          /* Not found in the scan */
+    WIFI_IOT_REASON_AUTH,           /* Wrong password, handshake timeouts */
+    WIFI_IOT_REASON_ASSOC,          /* AP refused or dropped the association */
+    WIFI_IOT_REASON_BEACON,         /* Lost beacons, out of range or AP rebooted */
+    WIFI_IOT_REASON_OTHER,
+    WIFI_IOT_REASON_MAX,
+} wifi_iot_reason_t;
+
+typedef struct {
+    wifi_iot_link_t link;
+    uint32_t attempt;               /* Failed attempts since the last connection */
+    uint32_t next_retry_ms;         /* Backoff delay of the pending retry */
+    uint32_t connects;
+    uint32_t roams;
+    uint32_t disconnects[WIFI_IOT_REASON_MAX];
+    uint8_t last_reason;            /* Raw wifi_err_reason_t of the last disconnect */
+} wifi_iot_status_t;
+
+/* Called from the default event loop task, keep it short */
+typedef void (*wifi_iot_cb_t) (wifi_iot_event_t event, void *ctx);
+
+/* Starts station mode and returns straight away, association runs in the background */
+esp_err_t wifi_iot_start(wifi_iot_cb_t cb, void *ctx);
+EventGroupHandle_t wifi_iot_get_event_group(void);
+/* Returns true once connected, false on timeout or after the station gave up */
+bool wifi_iot_wait_connected(TickType_t timeout);
+void wifi_iot_get_status(wifi_iot_status_t *status);
+/* Stores the AP profile table in NVS. Every connect or reconnect scans once and
+ * joins the best ranked AP of any profile, see wifi_select_rank(). */
+esp_err_t wifi_iot_set_profiles(const wifi_profile_t *profiles, size_t count);
+size_t wifi_iot_get_profiles(wifi_profile_t *profiles, size_t max);
+/* Blocking bring-up, wifi_iot_start() followed by a wait for the outcome */
 void wifi_init_sta(void);
 
 #endif
\ No newline at end of file
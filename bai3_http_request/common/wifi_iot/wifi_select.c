@@ -0,0 +1,69 @@
+#include <string.h>
+#include "wifi_select.h"
+
+int wifi_select_score(const wifi_profile_t *profile, int8_t rssi) {
+    return rssi + profile->priority * WIFI_SELECT_PRIORITY_DB;
+}
+
+static bool wifi_select_better(const wifi_select_candidate_t *a, const wifi_select_candidate_t *b,
+                               const wifi_select_ap_t *aps) {
+    if (a->score != b->score) {
+        return a->score > b->score;
+    }
+    return aps[a->ap].rssi > aps[b->ap].rssi;
+}
+
+size_t wifi_select_rank(const wifi_profile_t *profiles, size_t profile_count,
+                        const wifi_select_ap_t *aps, size_t ap_count, int8_t min_rssi,
+                        wifi_select_candidate_t *out, size_t max_out) {
+    size_t count = 0;
+    for (size_t a = 0; a < ap_count; a++) {
+        if (aps[a].rssi < min_rssi) {
+            continue;
+        }
+        for (size_t p = 0; p < profile_count; p++) {
+            if (strcmp(aps[a].ssid, profiles[p].ssid) != 0) {
+                continue;
+            }
+            wifi_select_candidate_t c = {
+                .profile = p,
+                .ap = a,
+                .score = wifi_select_score(&profiles[p], aps[a].rssi),
+            };
+            /* Insertion into the sorted output, strict comparison keeps scan order on ties */
+            size_t i = count < max_out ? count : max_out;
+            while (i > 0 && wifi_select_better(&c, &out[i - 1], aps)) {
+                if (i < max_out) {
+                    out[i] = out[i - 1];
+                }
+                i--;
+            }
+            if (i < max_out) {
+                out[i] = c;
+                if (count < max_out) {
+                    count++;
+                }
+            }
+            break;
+        }
+    }
+    return count;
+}
+
+void wifi_roam_init(wifi_roam_t *roam, int8_t threshold, uint8_t window) {
+    roam->threshold = threshold;
+    roam->window = window ? window : 1;
+    roam->below = 0;
+}
+
+bool wifi_roam_sample(wifi_roam_t *roam, int8_t rssi) {
+    if (rssi >= roam->threshold) {
+        roam->below = 0;
+        return false;
+    }
+    if (++roam->below < roam->window) {
+        return false;
+    }
+    roam->below = 0;
+    return true;
+}
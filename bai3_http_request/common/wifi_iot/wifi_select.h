@@ -0,0 +1,52 @@
+#ifndef WIFI_SELECT_H
+#define WIFI_SELECT_H
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* AP selection and roaming decisions, kept apart from the Wi-Fi driver so they
+ * are plain functions of their inputs and can be exercised off-target. */
+
+#define WIFI_SELECT_PRIORITY_DB     5       /* RSSI worth one step of profile priority */
+
+typedef struct {
+    char ssid[33];
+    char password[65];
+    int8_t priority;
+} wifi_profile_t;
+
+/* One scan result */
+typedef struct {
+    char ssid[33];
+    uint8_t bssid[6];
+    uint8_t channel;
+    int8_t rssi;
+} wifi_select_ap_t;
+
+typedef struct {
+    uint8_t profile;            /* Index into the profile table */
+    uint8_t ap;                 /* Index into the scan results */
+    int16_t score;
+} wifi_select_candidate_t;
+
+int wifi_select_score(const wifi_profile_t *profile, int8_t rssi);
+
+/* Pairs every scan result at or above min_rssi with the profile for its SSID
+ * and writes the best max_out of them to out, best first. Equal scores keep
+ * the stronger signal first, then scan order. Returns the number written. */
+size_t wifi_select_rank(const wifi_profile_t *profiles, size_t profile_count,
+                        const wifi_select_ap_t *aps, size_t ap_count, int8_t min_rssi,
+                        wifi_select_candidate_t *out, size_t max_out);
+
+/* Roaming trigger: fires once the RSSI has stayed below threshold for
+ * window samples in a row, then starts counting again */
+typedef struct {
+    int8_t threshold;
+    uint8_t window;
+    uint8_t below;
+} wifi_roam_t;
+
+void wifi_roam_init(wifi_roam_t *roam, int8_t threshold, uint8_t window);
+bool wifi_roam_sample(wifi_roam_t *roam, int8_t rssi);
+
+#endif
@@ -32,6 +32,14 @@
 #include "lwip/err.h"
 #include "lwip/sys.h"
 #include "wifi_iot.h"
+#include "http_iot.h"
+#include "http_req.h"
+#include "dns_cache.h"
+#include "sample_batch.h"
+#include "esp_timer.h"
+#ifdef CONFIG_UART_BRIDGE_ENABLE
+#include "uart_bridge.h"
+#endif
 
 /* Constants that aren't configurable in menuconfig */
 #define WEB_SERVER "api.thingspeak.com"
@@ -40,104 +48,103 @@
 
 static const char *TAG = "example";
 
-char REQUEST[512];
-char SUBREQUEST[100];
-char recv_buf[512];
+#define WRITE_API_KEY "4SZZ5PNW6UZ1ZVWP"
 
-// static const char *fsdfsdf = "GET " WEB_PATH " HTTP/1.1\r\n"
-//     "Host: "WEB_SERVER":"WEB_PORT"\r\n"
-//     "Connection: close\r\n"
-//     "Content-Type: application/x-www-form-urlencoded\r\n"
-//     "Content-Length:%d\r\n"
-//     "\r\n";
+#define STR_(x) #x
+#define STR(x) STR_(x)
 
-static void http_get_task(void *pvParameters)
-{
-    const struct addrinfo hints = {
-        .ai_family = AF_INET,
-        .ai_socktype = SOCK_STREAM,
-    };
-    struct addrinfo *res;
-    struct in_addr *addr;
-    int s, r;
-    // char recv_buf[64];
-
-    while(1) {
-        int err = getaddrinfo(WEB_SERVER, WEB_PORT, &hints, &res);
+/* Everything up to the body length is fixed at build time */
+static const char BULK_HEAD[] = "POST /channels/" STR(CONFIG_THINGSPEAK_CHANNEL_ID) "/bulk_update.json HTTP/1.1\r\n"
+    "Host: "WEB_SERVER"\r\n"
+    "Content-Type: application/json\r\n"
+    "Content-Length: ";
 
-        if(err != 0 || res == NULL) {
-            ESP_LOGE(TAG, "DNS lookup failed err=%d res=%p", err, res);
-            vTaskDelay(1000 / portTICK_PERIOD_MS);
-            continue;
-        }
-
-        /* Code to print the resolved IP.
+static void http_body_cb(const uint8_t *data, size_t len, void *ctx)
+{
+    for(int i = 0; i < len; i++) {
+        putchar(data[i]);
+    }
+}
 
-           Note: inet_ntoa is non-reentrant, look at ipaddr_ntoa_r for "real" code */
-        addr = &((struct sockaddr_in *)res->ai_addr)->sin_addr;
-        ESP_LOGI(TAG, "DNS lookup succeeded. IP=%s", inet_ntoa(*addr));
+/* One bulk_update.json POST per batch, the body goes out from the batch buffer as is */
+static esp_err_t upload_batch(const char *body, size_t len, uint32_t count, void *ctx)
+{
+    http_iot_handle_t http = ctx;
+    /* Samples stay queued while the link is down */
+    if (!wifi_iot_wait_connected(0)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    /* Only the length is rendered, the rest is referenced in place */
+    char numbers[16];
+    http_req_t req;
+    http_req_init(&req, numbers, sizeof(numbers));
+    http_req_static(&req, BULK_HEAD);
+    http_req_uint(&req, len);
+    http_req_static(&req, "\r\n\r\n");
+    http_req_ref(&req, body, len);
+    if (req.overflow) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    int status = 0;
+    esp_err_t err = http_iot_requestv(http, req.iov, req.count, &status, http_body_cb, NULL);
+    putchar('\n');
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "... upload failed: %s", esp_err_to_name(err));
+        return err;
+    }
+    ESP_LOGI(TAG, "... %u samples in %u bytes, status %d", count, req.len, status);
+    return status / 100 == 2 ? ESP_OK : ESP_FAIL;
+}
 
-        s = socket(res->ai_family, res->ai_socktype, 0);
-        if(s < 0) {
-            ESP_LOGE(TAG, "... Failed to allocate socket.");
-            freeaddrinfo(res);
-            vTaskDelay(1000 / portTICK_PERIOD_MS);
-            continue;
-        }
-        ESP_LOGI(TAG, "... allocated socket");
-
-        if(connect(s, res->ai_addr, res->ai_addrlen) != 0) {
-            ESP_LOGE(TAG, "... socket connect failed errno=%d", errno);
-            close(s);
-            freeaddrinfo(res);
-            vTaskDelay(4000 / portTICK_PERIOD_MS);
-            continue;
+static void http_get_task(void *pvParameters)
+{
+    http_iot_handle_t http;
+    http_iot_config_t http_config = HTTP_IOT_CONFIG_DEFAULT(WEB_SERVER, WEB_PORT);
+    ESP_ERROR_CHECK(http_iot_create(&http_config, &http));
+
+    sample_batch_handle_t batch;
+    sample_batch_config_t batch_config = SAMPLE_BATCH_CONFIG_DEFAULT(WRITE_API_KEY, upload_batch);
+    batch_config.max_samples = CONFIG_SAMPLE_BATCH_MAX_SAMPLES;
+    batch_config.max_age_ms = CONFIG_SAMPLE_BATCH_MAX_AGE_MS;
+    batch_config.ctx = http;
+    ESP_ERROR_CHECK(sample_batch_create(&batch_config, &batch));
+
+    /* Sampling carries on while Wi-Fi is down, the batch holds what it can */
+    TickType_t wake = xTaskGetTickCount();
+    while(1) {
+        sample_batch_sample_t sample = {
+            .time_ms = esp_timer_get_time() / 1000,
+            .field_mask = BIT0 | BIT1,
+            .fields = { 20, 80 },
+        };
+        sample_batch_add(batch, &sample);
+
+        if (sample_batch_count(batch) == 0) {
+            sample_batch_stats_t stats;
+            sample_batch_get_stats(batch, &stats);
+            dns_cache_stats_t dns;
+            dns_cache_get_stats(&dns);
+            ESP_LOGI(TAG, "... %u samples in %u uploads, %u dropped, dns hits %u, stale %u, misses %u",
+                     stats.samples, stats.flushes, stats.dropped, dns.hits, dns.stale_hits, dns.misses);
         }
+        vTaskDelayUntil(&wake, CONFIG_SAMPLE_PERIOD_MS / portTICK_PERIOD_MS);
+    }
+}
 
-        ESP_LOGI(TAG, "... connected");
-        freeaddrinfo(res);
-
-        // sprintf(SUBREQUEST, "api_key=4SZZ5PNW6UZ1ZVWP&field1=%d&field2=%d", 25, 25);
-        // sprintf(REQUEST, "POST /update HTTP/1.1\nHost: api.thinkspeak.com\nConnection: close\nContent-Type: application/x-www-form-urlencoded\nContent-Length:%d\n\n%s\n", strlen(SUBREQUEST), SUBREQUEST);
-        sprintf(REQUEST, "GET http://api.thingspeak.com/update.json?api_key=4SZZ5PNW6UZ1ZVWP&field1=20&field2=80\n\n");
-        // sprintf(REQUEST, "GET http://api.thingspeak.com/channels/1686054/feeds.json?api_key=GLVLA2DR0E6ZTIZU&results=2\n\n");
-
-        if (write(s, REQUEST, strlen(REQUEST)) < 0) {
-            ESP_LOGE(TAG, "... socket send failed");
-            close(s);
-            vTaskDelay(4000 / portTICK_PERIOD_MS);
-            continue;
-        }
-        ESP_LOGI(TAG, "... socket send success");
-
-        struct timeval receiving_timeout;
-        receiving_timeout.tv_sec = 5;
-        receiving_timeout.tv_usec = 0;
-        if (setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &receiving_timeout,
-                sizeof(receiving_timeout)) < 0) {
-            ESP_LOGE(TAG, "... failed to set socket receiving timeout");
-            close(s);
-            vTaskDelay(4000 / portTICK_PERIOD_MS);
-            continue;
-        }
-        ESP_LOGI(TAG, "... set socket receiving timeout success");
-
-        /* Read HTTP response */
-        do {
-            bzero(recv_buf, sizeof(recv_buf));
-            r = read(s, recv_buf, sizeof(recv_buf)-1);
-            for(int i = 0; i < r; i++) {
-                putchar(recv_buf[i]);
-                    }
-        } while(r > 0);
-
-        ESP_LOGI(TAG, "... done reading from socket. Last read return=%d errno=%d.", r, errno);
-        close(s);
-        for(int countdown = 10; countdown >= 0; countdown--) {
-            ESP_LOGI(TAG, "%d... ", countdown);
-            vTaskDelay(1000 / portTICK_PERIOD_MS);
-        }
-        ESP_LOGI(TAG, "Starting again!");
+static void wifi_event_cb(wifi_iot_event_t event, void *ctx)
+{
+    switch (event) {
+        case WIFI_IOT_EVENT_CONNECTED:
+            ESP_LOGI(TAG, "Wi-Fi connected");
+            break;
+        case WIFI_IOT_EVENT_LOST:
+            ESP_LOGW(TAG, "Wi-Fi lost, reconnecting");
+            break;
+        case WIFI_IOT_EVENT_FAILED:
+            ESP_LOGE(TAG, "Wi-Fi failed, still retrying");
+            break;
+        case WIFI_IOT_EVENT_BACKOFF:
+            break;
     }
 }
 
@@ -151,7 +158,18 @@ void app_main(void)
      */
     // ESP_ERROR_CHECK(example_connect());
     ESP_LOGI(TAG, "ESP_WIFI_MODE_STA");
-    wifi_init_sta();
+    ESP_ERROR_CHECK(wifi_iot_start(wifi_event_cb, NULL));
+    dns_cache_config_t dns_config = DNS_CACHE_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(dns_cache_init(&dns_config));
 
     xTaskCreate(&http_get_task, "http_get_task", 4096, NULL, 5, NULL);
+
+#ifdef CONFIG_UART_BRIDGE_ENABLE
+    uart_bridge_config_t bridge_config = UART_BRIDGE_CONFIG_DEFAULT(UART_NUM_2, CONFIG_UART_BRIDGE_TCP_PORT);
+    bridge_config.uart.baud_rate = CONFIG_UART_BRIDGE_BAUD_RATE;
+    bridge_config.uart.tx_pin = 17;
+    bridge_config.uart.rx_pin = 16;
+    uart_bridge_handle_t bridge;
+    ESP_ERROR_CHECK(uart_bridge_start(&bridge_config, &bridge));
+#endif
 }
@@ -0,0 +1,157 @@
+#include "input_gesture.h"
+
+enum {
+    GESTURE_IDLE = 0,
+    GESTURE_PRESSED,
+    GESTURE_WAIT_SECOND,
+};
+
+#define GESTURE_NO_DEADLINE     (-1)
+#define GESTURE_LONG_AGO        (INT64_MIN / 2)
+
+static input_gesture_event_t gesture_classify(const input_gesture_config_t *config, int64_t duration_us) {
+    if (duration_us <= 0) {
+        return INPUT_GESTURE_NONE;
+    }
+    for (size_t i = 0; i < config->class_count; i++) {
+        if (duration_us <= config->classes[i].max_us) {
+            return config->classes[i].event;
+        }
+    }
+    return INPUT_GESTURE_NONE;
+}
+
+static input_gesture_event_t gesture_accept(input_gesture_t *gesture, int level, int64_t timestamp_us) {
+    const input_gesture_config_t *config = gesture->config;
+    gesture->stable_level = level;
+    gesture->last_edge_us = timestamp_us;
+
+    if (level == config->active_level) {
+        gesture->second_click = (gesture->state == GESTURE_WAIT_SECOND);
+        gesture->state = GESTURE_PRESSED;
+        gesture->press_us = timestamp_us;
+        gesture->held = false;
+        gesture->hold_next_us = config->hold_start_us > 0 ?
+                                timestamp_us + config->hold_start_us : GESTURE_NO_DEADLINE;
+        return INPUT_GESTURE_NONE;
+    }
+
+    if (gesture->state != GESTURE_PRESSED) {
+        gesture->state = GESTURE_IDLE;
+        return INPUT_GESTURE_NONE;
+    }
+    gesture->state = GESTURE_IDLE;
+    if (gesture->held) {
+        return INPUT_GESTURE_NONE;
+    }
+    input_gesture_event_t event = gesture_classify(config, timestamp_us - gesture->press_us);
+    if (gesture->second_click && event != INPUT_GESTURE_SHORT) {
+        /* Not a double click after all, the first click still counts */
+        gesture->second_click = false;
+        gesture->pending = event;
+        return INPUT_GESTURE_SHORT;
+    }
+    if (event == INPUT_GESTURE_SHORT && config->double_click_us > 0) {
+        if (gesture->second_click) {
+            return INPUT_GESTURE_DOUBLE;
+        }
+        /* Hold the click back until we know no second one follows */
+        gesture->state = GESTURE_WAIT_SECOND;
+        gesture->release_us = timestamp_us;
+        return INPUT_GESTURE_NONE;
+    }
+    return event;
+}
+
+void input_gesture_init(input_gesture_t *gesture, const input_gesture_config_t *config) {
+    gesture->config = config;
+    gesture->state = GESTURE_IDLE;
+    gesture->stable_level = !config->active_level;
+    gesture->raw_level = gesture->stable_level;
+    gesture->raw_edge_us = GESTURE_LONG_AGO;
+    gesture->last_edge_us = GESTURE_LONG_AGO;
+    gesture->press_us = 0;
+    gesture->release_us = 0;
+    gesture->hold_next_us = GESTURE_NO_DEADLINE;
+    gesture->second_click = false;
+    gesture->held = false;
+    gesture->pending = INPUT_GESTURE_NONE;
+}
+
+input_gesture_event_t input_gesture_feed(input_gesture_t *gesture, int level, int64_t timestamp_us) {
+    level = level ? 1 : 0;
+    gesture->raw_level = level;
+    gesture->raw_edge_us = timestamp_us;
+    if (level == gesture->stable_level) {
+        return INPUT_GESTURE_NONE;
+    }
+    /* Inside the debounce window: remember the level, input_gesture_poll() settles it */
+    if (timestamp_us - gesture->last_edge_us < gesture->config->debounce_us) {
+        return INPUT_GESTURE_NONE;
+    }
+    return gesture_accept(gesture, level, timestamp_us);
+}
+
+input_gesture_event_t input_gesture_poll(input_gesture_t *gesture, int64_t now_us) {
+    const input_gesture_config_t *config = gesture->config;
+
+    if (gesture->pending != INPUT_GESTURE_NONE) {
+        input_gesture_event_t event = gesture->pending;
+        gesture->pending = INPUT_GESTURE_NONE;
+        return event;
+    }
+
+    if (gesture->raw_level != gesture->stable_level &&
+        now_us >= gesture->last_edge_us + config->debounce_us) {
+        /* The line settled on the level of its last bounce, date the edge from there */
+        input_gesture_event_t event = gesture_accept(gesture, gesture->raw_level, gesture->raw_edge_us);
+        if (event != INPUT_GESTURE_NONE) {
+            return event;
+        }
+    }
+
+    if (gesture->state == GESTURE_PRESSED && gesture->hold_next_us != GESTURE_NO_DEADLINE &&
+        now_us >= gesture->hold_next_us) {
+        if (gesture->second_click) {
+            /* The held-back click goes first, the hold is reported on the next poll */
+            gesture->second_click = false;
+            return INPUT_GESTURE_SHORT;
+        }
+        gesture->held = true;
+        gesture->hold_next_us = config->hold_repeat_us > 0 ?
+                                gesture->hold_next_us + config->hold_repeat_us : GESTURE_NO_DEADLINE;
+        return INPUT_GESTURE_HOLD;
+    }
+
+    if (gesture->state == GESTURE_WAIT_SECOND &&
+        now_us >= gesture->release_us + config->double_click_us) {
+        gesture->state = GESTURE_IDLE;
+        return INPUT_GESTURE_SHORT;
+    }
+
+    return INPUT_GESTURE_NONE;
+}
+
+int64_t input_gesture_next_deadline(const input_gesture_t *gesture) {
+    const input_gesture_config_t *config = gesture->config;
+    int64_t deadline = GESTURE_NO_DEADLINE;
+
+    if (gesture->pending != INPUT_GESTURE_NONE) {
+        /* Already due */
+        return gesture->last_edge_us;
+    }
+    if (gesture->raw_level != gesture->stable_level) {
+        deadline = gesture->last_edge_us + config->debounce_us;
+    }
+    if (gesture->state == GESTURE_PRESSED && gesture->hold_next_us != GESTURE_NO_DEADLINE &&
+        (deadline == GESTURE_NO_DEADLINE || gesture->hold_next_us < deadline)) {
+        deadline = gesture->hold_next_us;
+    }
+    if (gesture->state == GESTURE_WAIT_SECOND) {
+        int64_t window_end = gesture->release_us + config->double_click_us;
+        if (deadline == GESTURE_NO_DEADLINE || window_end < deadline) {
+            deadline = window_end;
+        }
+    }
+    return deadline;
+}
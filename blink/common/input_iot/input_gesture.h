@@ -0,0 +1,65 @@
+#ifndef INPUT_GESTURE_H
+#define INPUT_GESTURE_H
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Button gesture state machine driven purely by edge timestamps (esp_timer_get_time()
+ * microseconds). It has no RTOS or driver dependencies so recorded edge traces can be
+ * replayed through it off-target. */
+
+typedef enum {
+    INPUT_GESTURE_NONE = 0,
+    INPUT_GESTURE_SHORT,
+    INPUT_GESTURE_NORMAL,
+    INPUT_GESTURE_LONG,
+    INPUT_GESTURE_DOUBLE,
+    INPUT_GESTURE_HOLD,         /* Emitted once after hold_start_us, then every hold_repeat_us */
+} input_gesture_event_t;
+
+/* One row of the press classification table, rows sorted by ascending max_us */
+typedef struct {
+    int64_t max_us;
+    input_gesture_event_t event;
+} input_gesture_class_t;
+
+typedef struct {
+    int active_level;           /* Level while pressed, 0 for pull-up buttons */
+    int64_t debounce_us;
+    const input_gesture_class_t *classes;
+    size_t class_count;
+    int64_t double_click_us;    /* Window for a second INPUT_GESTURE_SHORT, 0 disables */
+    int64_t hold_start_us;      /* 0 disables hold events */
+    int64_t hold_repeat_us;     /* 0 emits a single INPUT_GESTURE_HOLD */
+} input_gesture_config_t;
+
+typedef struct {
+    const input_gesture_config_t *config;
+    int state;
+    int stable_level;
+    int raw_level;
+    int64_t raw_edge_us;
+    int64_t last_edge_us;
+    int64_t press_us;
+    int64_t release_us;
+    int64_t hold_next_us;
+    bool second_click;
+    bool held;
+    input_gesture_event_t pending;  /* Second event of a release, reported by the next poll */
+} input_gesture_t;
+
+void input_gesture_init(input_gesture_t *gesture, const input_gesture_config_t *config);
+
+/* Feed one raw edge. Call input_gesture_poll() up to timestamp_us first so that expired
+ * deadlines are reported in order. A release can produce two events (a held-back
+ * SHORT followed by the second press), the second one comes from the next poll. */
+input_gesture_event_t input_gesture_feed(input_gesture_t *gesture, int level, int64_t timestamp_us);
+
+/* Report at most one timed event that is due at now_us. Call repeatedly until it
+ * returns INPUT_GESTURE_NONE. */
+input_gesture_event_t input_gesture_poll(input_gesture_t *gesture, int64_t now_us);
+
+/* Earliest time at which input_gesture_poll() may report something, -1 if none */
+int64_t input_gesture_next_deadline(const input_gesture_t *gesture);
+
+#endif
@@ -1,18 +1,93 @@
 #ifndef INPUT_IOT_H
 #define INPUT_IOT_H
+#include <stdint.h>
+#include <stdbool.h>
 #include <esp_log.h>
+#include <esp_err.h>
 #include <hal/gpio_types.h>
+#include "freertos/FreeRTOS.h"
 
 typedef enum {
-    HI_TO_LO = 0,
-    LO_TO_HI,
-    ANY_EDGE
+    HI_TO_LO = GPIO_INTR_NEGEDGE,
+    LO_TO_HI = GPIO_INTR_POSEDGE,
+    ANY_EDGE = GPIO_INTR_ANYEDGE
 } interrupt_type_edge_t;
 
-typedef void (*input_callback_t) (int);
+/* Edge captured by the ISR and handed to the deferred worker task */
+typedef struct {
+    gpio_num_t gpio_num;
+    int level;
+    int64_t timestamp_us;
+    uint32_t dropped;       /* Events lost to a full ring just before this one */
+} input_event_t;
 
-void input_io_create(gpio_num_t gpio_num, interrupt_type_edge_t type);
+typedef struct {
+    uint32_t ring_size;     /* Number of records, must be a power of two */
+    uint32_t batch_size;    /* Max records handled per worker wake-up */
+    uint32_t task_stack;
+    UBaseType_t task_priority;
+} input_deferred_config_t;
+
+typedef struct {
+    uint32_t pushed;
+    uint32_t dropped;
+    uint32_t high_water;    /* Deepest ring occupancy seen by the ISR */
+} input_deferred_stats_t;
+
+#define INPUT_DEFERRED_CONFIG_DEFAULT() { \
+    .ring_size = 64,                      \
+    .batch_size = 16,                     \
+    .task_stack = 2048,                   \
+    .task_priority = 10,                  \
+}
+
+typedef struct {
+    uint64_t mask;              /* Pins to scan, bit n is GPIO n */
+    uint32_t period_ms;
+    uint8_t debounce_samples;
+    uint32_t task_stack;
+    UBaseType_t task_priority;
+} input_scan_config_t;
+
+typedef struct {
+    uint32_t max_edges_per_sec; /* Ceiling applied to every pin, 0 only meters */
+    uint32_t backoff_ms;        /* How long a storming pin stays masked */
+} input_storm_config_t;
+
+typedef struct {
+    uint32_t edges;             /* Edges seen since boot */
+    uint32_t rate;              /* Edges over the last second */
+    uint32_t storms;            /* Times the pin was masked */
+    bool masked;
+} input_health_t;
+
+#define INPUT_STORM_CONFIG_DEFAULT() { \
+    .max_edges_per_sec = 1000,         \
+    .backoff_ms = 1000,                \
+}
+
+/* Called from the GPIO ISR with the pin that fired and the context registered for it */
+typedef void (*input_callback_t) (gpio_num_t gpio_num, void *ctx);
+/* Called from the deferred worker task for every queued edge */
+typedef void (*input_event_callback_t) (const input_event_t *event, void *ctx);
+/* Called from the scan task with the pins whose debounced level changed */
+typedef void (*input_scan_callback_t) (uint64_t changed, uint64_t levels, void *ctx);
+/* Called from the esp_timer task after a pin has been masked for storming */
+typedef void (*input_storm_callback_t) (gpio_num_t gpio_num, uint32_t rate, void *ctx);
+
+void input_io_create(gpio_num_t gpio_num, gpio_int_type_t type);
 int input_io_get_level(gpio_num_t gpio_num);
-void input_set_callback(void *cb);
+esp_err_t input_io_set_handler(gpio_num_t gpio_num, input_callback_t cb, void *ctx);
+
+esp_err_t input_io_deferred_start(const input_deferred_config_t *config);
+esp_err_t input_io_set_deferred_handler(gpio_num_t gpio_num, input_event_callback_t cb, void *ctx);
+void input_io_get_deferred_stats(input_deferred_stats_t *stats);
+
+uint64_t input_io_get_levels(void);
+esp_err_t input_io_scan_start(const input_scan_config_t *config, input_scan_callback_t cb, void *ctx);
+
+esp_err_t input_io_storm_start(const input_storm_config_t *config, input_storm_callback_t cb, void *ctx);
+esp_err_t input_io_set_storm_limit(gpio_num_t gpio_num, uint32_t max_edges_per_sec);
+esp_err_t input_io_get_health(gpio_num_t gpio_num, input_health_t *health);
 
-#endif
\ No newline at end of file
+#endif
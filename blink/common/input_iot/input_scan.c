@@ -0,0 +1,37 @@
+#include <string.h>
+#include "input_scan.h"
+
+void input_scan_init(input_scan_t *scan, uint64_t mask, uint64_t initial, uint8_t debounce_samples) {
+    scan->mask = mask;
+    scan->stable = initial & mask;
+    scan->pending = 0;
+    scan->debounce_samples = debounce_samples ? debounce_samples : 1;
+    memset(scan->count, 0, sizeof(scan->count));
+}
+
+uint64_t input_scan_update(input_scan_t *scan, uint64_t sample) {
+    uint64_t diff = (sample ^ scan->stable) & scan->mask;
+    uint64_t changed = 0;
+
+    /* Pins that bounced back to their stable level start counting from scratch */
+    uint64_t bounced = scan->pending & ~diff;
+    while (bounced) {
+        scan->count[__builtin_ctzll(bounced)] = 0;
+        bounced &= bounced - 1;
+    }
+
+    /* Only pins that differ are visited, a quiet bank costs one XOR */
+    uint64_t walk = diff;
+    while (walk) {
+        int pin = __builtin_ctzll(walk);
+        if (++scan->count[pin] >= scan->debounce_samples) {
+            scan->count[pin] = 0;
+            changed |= 1ULL << pin;
+        }
+        walk &= walk - 1;
+    }
+
+    scan->stable ^= changed;
+    scan->pending = diff & ~changed;
+    return changed;
+}
@@ -1,10 +1,23 @@
 #ifndef OUTPUT_IOT_H
 #define OUTPUT_IOT_H
+#include <stdint.h>
 #include <esp_log.h>
+#include <esp_err.h>
 #include <hal/gpio_types.h>
+#include "output_pattern.h"
+
+#define OUTPUT_IO_BIT(gpio_num)     (1ULL << (gpio_num))
 
 void output_io_create(gpio_num_t gpio_num);
 void output_io_set_level(gpio_num_t gpio_num, int level);
 void output_io_toggle(gpio_num_t gpio_num);
+int output_io_get_level(gpio_num_t gpio_num);
+/* Drive every pin in set_mask high and every pin in clear_mask low, bit n is GPIO n */
+void output_io_write_mask(uint64_t set_mask, uint64_t clear_mask);
+
+/* Drive a blink pattern on the pin, from an LEDC channel when one is free and
+ * from esp_timer otherwise. Starting a pattern on a running pin reprograms it. */
+esp_err_t output_io_pattern_start(gpio_num_t gpio_num, const output_pattern_t *pattern);
+esp_err_t output_io_pattern_stop(gpio_num_t gpio_num);
 
-#endif
\ No newline at end of file
+#endif
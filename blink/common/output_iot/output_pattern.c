@@ -0,0 +1,87 @@
+#include <stddef.h>
+#include "output_pattern.h"
+
+bool output_pattern_is_valid(const output_pattern_t *pattern) {
+    return pattern != NULL && pattern->period_ms > 0 && pattern->duty_percent <= 100;
+}
+
+/* Position inside one period: level and time to the next edge inside that period.
+ * Returns the period length when the level does not change before the period ends. */
+static uint64_t pattern_period_eval(uint64_t period_us, uint64_t on_us, uint64_t pos_us, int *level) {
+    if (pos_us < on_us) {
+        *level = 1;
+        return on_us - pos_us;
+    }
+    *level = 0;
+    return period_us - pos_us;
+}
+
+bool output_pattern_eval(const output_pattern_t *pattern, uint64_t t_us, int *level, uint64_t *next_us) {
+    uint64_t period_us = (uint64_t) pattern->period_ms * 1000;
+    uint64_t on_us = period_us * pattern->duty_percent / 100;
+
+    if (on_us == 0) {
+        *level = 0;
+        return false;
+    }
+
+    if (pattern->burst_count == 0) {
+        if (on_us == period_us) {
+            *level = 1;
+            return false;
+        }
+        uint64_t pos_us = t_us % period_us;
+        *next_us = t_us + pattern_period_eval(period_us, on_us, pos_us, level);
+        return true;
+    }
+
+    uint64_t burst_us = period_us * pattern->burst_count;
+    uint64_t cycle_us = burst_us + (uint64_t) pattern->burst_gap_ms * 1000;
+    uint64_t index = t_us / cycle_us;
+    if (pattern->repeat && index >= pattern->repeat) {
+        *level = 0;
+        return false;
+    }
+
+    uint64_t cycle_pos_us = t_us % cycle_us;
+    if (cycle_pos_us >= burst_us) {
+        /* In the gap, the next edge starts the following burst */
+        *level = 0;
+        if (pattern->repeat && index + 1 >= pattern->repeat) {
+            return false;
+        }
+        *next_us = t_us + (cycle_us - cycle_pos_us);
+        return true;
+    }
+
+    uint64_t pos_us = cycle_pos_us % period_us;
+    uint64_t delta_us = pattern_period_eval(period_us, on_us, pos_us, level);
+    if (on_us == period_us) {
+        /* Full duty: the burst is one solid pulse */
+        delta_us = burst_us - cycle_pos_us;
+    }
+    if (*level == 0 && cycle_pos_us + delta_us == burst_us) {
+        /* The last low phase runs straight into the gap, or ends the pattern */
+        if (pattern->repeat && index + 1 >= pattern->repeat) {
+            return false;
+        }
+        delta_us = cycle_us - cycle_pos_us;
+    }
+    *next_us = t_us + delta_us;
+    return true;
+}
+
+bool output_pattern_ledc_clock(uint32_t period_ms, uint32_t *resolution, uint32_t *divider) {
+    uint64_t ticks = (uint64_t) period_ms * 1000;
+    uint32_t bits = 20;
+    while (bits > 1 && (1ULL << bits) > ticks) {
+        bits--;
+    }
+    uint64_t div = (ticks << 8) >> bits;
+    if (div < (1 << 8) || div >= (1024 << 8)) {
+        return false;
+    }
+    *resolution = bits;
+    *divider = div;
+    return true;
+}
@@ -0,0 +1,126 @@
+#include <stdlib.h>
+#include <string.h>
+#include <esp_log.h>
+#include <driver/rmt.h>
+#include "freertos/FreeRTOS.h"
+#include "output_strip.h"
+
+static const char *TAG = "output_strip";
+
+/* 80 MHz APB / 2 gives 25 ns RMT ticks */
+#define OUTPUT_STRIP_RMT_CLK_DIV    2
+#define OUTPUT_STRIP_TX_TIMEOUT_MS  100
+
+struct output_strip {
+    rmt_channel_t channel;
+    uint32_t led_count;
+    output_strip_symbols_t symbols;
+    uint8_t *pixels;            /* GRB, three bytes per LED */
+    rmt_item32_t *items[2];     /* One buffer shifts out while the other is encoded */
+    int back;
+    bool busy;
+};
+
+esp_err_t output_strip_create(const output_strip_config_t *config, output_strip_t **ret_strip) {
+    if (config == NULL || ret_strip == NULL || config->led_count == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    output_strip_t *strip = calloc(1, sizeof(output_strip_t));
+    if (strip == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    size_t bytes = config->led_count * 3;
+    /* One extra item at the end of each buffer holds the reset */
+    size_t item_count = bytes * OUTPUT_STRIP_ITEMS_PER_BYTE + 1;
+    strip->pixels = calloc(bytes, 1);
+    strip->items[0] = malloc(item_count * sizeof(rmt_item32_t));
+    strip->items[1] = malloc(item_count * sizeof(rmt_item32_t));
+    if (strip->pixels == NULL || strip->items[0] == NULL || strip->items[1] == NULL) {
+        output_strip_delete(strip);
+        return ESP_ERR_NO_MEM;
+    }
+    strip->channel = config->rmt_channel;
+    strip->led_count = config->led_count;
+
+    rmt_config_t rmt_cfg = RMT_DEFAULT_CONFIG_TX(config->gpio_num, config->rmt_channel);
+    rmt_cfg.clk_div = OUTPUT_STRIP_RMT_CLK_DIV;
+    esp_err_t err = rmt_config(&rmt_cfg);
+    if (err == ESP_OK) {
+        err = rmt_driver_install(strip->channel, 0, 0);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "RMT channel %d setup failed: %s", config->rmt_channel, esp_err_to_name(err));
+        free(strip->pixels);
+        free(strip->items[0]);
+        free(strip->items[1]);
+        free(strip);
+        return err;
+    }
+
+    uint32_t counter_clk_hz;
+    rmt_get_counter_clock(strip->channel, &counter_clk_hz);
+    output_strip_symbols_init(&strip->symbols, &config->timing, counter_clk_hz);
+    /* Encoding never reaches the last item, so the reset is written once */
+    strip->items[0][item_count - 1].val = strip->symbols.reset;
+    strip->items[1][item_count - 1].val = strip->symbols.reset;
+    *ret_strip = strip;
+    return ESP_OK;
+}
+
+esp_err_t output_strip_set_pixel(output_strip_t *strip, uint32_t index, uint8_t red, uint8_t green, uint8_t blue) {
+    if (index >= strip->led_count) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint8_t *pixel = &strip->pixels[index * 3];
+    pixel[0] = green;
+    pixel[1] = red;
+    pixel[2] = blue;
+    return ESP_OK;
+}
+
+esp_err_t output_strip_clear(output_strip_t *strip) {
+    memset(strip->pixels, 0, strip->led_count * 3);
+    return output_strip_refresh(strip);
+}
+
+esp_err_t output_strip_refresh(output_strip_t *strip) {
+    size_t bytes = strip->led_count * 3;
+    rmt_item32_t *items = strip->items[strip->back];
+
+    /* The front buffer may still be shifting out while this one is encoded */
+    output_strip_encode(&strip->symbols, strip->pixels, bytes, (uint32_t *) items);
+
+    if (strip->busy) {
+        esp_err_t err = rmt_wait_tx_done(strip->channel, pdMS_TO_TICKS(OUTPUT_STRIP_TX_TIMEOUT_MS));
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    /* The reset item keeps the line low until the frame latches, so the
+     * wait above also covers the gap before the next frame may start */
+    esp_err_t err = rmt_write_items(strip->channel, items, bytes * OUTPUT_STRIP_ITEMS_PER_BYTE + 1, false);
+    if (err != ESP_OK) {
+        strip->busy = false;
+        return err;
+    }
+    strip->busy = true;
+    strip->back ^= 1;
+    return ESP_OK;
+}
+
+esp_err_t output_strip_delete(output_strip_t *strip) {
+    if (strip == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (strip->items[0] && strip->items[1] && strip->pixels) {
+        if (strip->busy) {
+            rmt_wait_tx_done(strip->channel, pdMS_TO_TICKS(OUTPUT_STRIP_TX_TIMEOUT_MS));
+        }
+        rmt_driver_uninstall(strip->channel);
+    }
+    free(strip->pixels);
+    free(strip->items[0]);
+    free(strip->items[1]);
+    free(strip);
+    return ESP_OK;
+}
@@ -14,18 +14,51 @@
 #include "sdkconfig.h"
 #include "input_iot.h"
 #include "output_iot.h"
+#ifdef CONFIG_BLINK_LED_RMT
+#include "output_strip.h"
+#endif
 
 #define BLINK_GPIO CONFIG_BLINK_GPIO
 
-void input_event_callback(int pin) {
-    if(pin == GPIO_NUM_0) {
-        output_io_toggle(BLINK_GPIO);
-    }
+#ifdef CONFIG_BLINK_LED_RMT
+static output_strip_t *led_strip;
+static bool led_on = false;
+
+static void blink_led_init(void)
+{
+    output_strip_config_t strip_config = OUTPUT_STRIP_CONFIG_DEFAULT(BLINK_GPIO, CONFIG_BLINK_LED_RMT_CHANNEL, 1);
+    ESP_ERROR_CHECK(output_strip_create(&strip_config, &led_strip));
+    output_strip_clear(led_strip);
 }
 
-void app_main(void)
+static void blink_led_toggle(void)
+{
+    led_on = !led_on;
+    /* Set the LED pixel using RGB from 0 (0%) to 255 (100%) for each color */
+    output_strip_set_pixel(led_strip, 0, led_on ? 16 : 0, led_on ? 16 : 0, led_on ? 16 : 0);
+    output_strip_refresh(led_strip);
+}
+#else
+static void blink_led_init(void)
 {
     output_io_create(BLINK_GPIO);
+}
+
+static void blink_led_toggle(void)
+{
+    output_io_toggle(BLINK_GPIO);
+}
+#endif
+
+void input_event_callback(const input_event_t *event, void *ctx) {
+    blink_led_toggle();
+}
+
+void app_main(void)
+{
+    blink_led_init();
+    input_deferred_config_t deferred_config = INPUT_DEFERRED_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(input_io_deferred_start(&deferred_config));
+    input_io_set_deferred_handler(GPIO_NUM_0, input_event_callback, NULL);
     input_io_create(GPIO_NUM_0, HI_TO_LO);
-    input_set_callback(input_event_callback);
 }
@@ -1,28 +1,379 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <driver/gpio.h>
+#include <hal/gpio_ll.h>
+#include <soc/soc_caps.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "input_iot.h"
+#include "input_scan.h"
 
-input_callback_t input_callback = NULL;
+static const char *TAG = "input_iot";
+
+typedef struct {
+    input_callback_t cb;
+    input_event_callback_t event_cb;
+    void *ctx;
+} input_handler_t;
+
+/* Indexed by gpio_num_t, the ISR arg points straight at the pin's slot */
+static input_handler_t s_handlers[GPIO_NUM_MAX];
+static bool s_isr_service_installed = false;
+static portMUX_TYPE s_handlers_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Single producer (the GPIO ISR) / single consumer (the worker task) ring.
+ * head is only written by the ISR, tail only by the worker. */
+static input_event_t *s_ring = NULL;
+static uint32_t s_ring_mask;
+static uint32_t s_batch_size;
+static volatile uint32_t s_head;
+static volatile uint32_t s_tail;
+static uint32_t s_pending_drops;
+static input_deferred_stats_t s_stats;
+static TaskHandle_t s_worker = NULL;
+
+/* Edge rate is summed over INPUT_METER_BUCKETS slices of INPUT_METER_TICK_MS, one second in total */
+#define INPUT_METER_TICK_MS     100
+#define INPUT_METER_BUCKETS     (1000 / INPUT_METER_TICK_MS)
+
+typedef struct {
+    uint32_t edges;
+    uint32_t storms;
+    uint32_t limit;
+    uint32_t bucket[INPUT_METER_BUCKETS];
+    uint32_t completed;         /* Sum of every bucket except the current one */
+    uint8_t cur;
+    uint16_t backoff_left;      /* Meter ticks until a masked pin is re-armed */
+    bool masked;
+    bool storm_pending;         /* Set by the ISR, reported from the meter tick */
+} input_meter_t;
+
+static input_meter_t s_meters[GPIO_NUM_MAX];
+static portMUX_TYPE s_meter_lock = portMUX_INITIALIZER_UNLOCKED;
+static esp_timer_handle_t s_meter_timer = NULL;
+static uint16_t s_backoff_ticks;
+static input_storm_callback_t s_storm_cb = NULL;
+static void *s_storm_ctx = NULL;
+
+typedef struct {
+    input_scan_t scan;
+    uint32_t period_ms;
+    input_scan_callback_t cb;
+    void *ctx;
+} input_scanner_t;
+
+static void IRAM_ATTR input_event_push(gpio_num_t gpio_num) {
+    uint32_t head = s_head;
+    uint32_t used = head - __atomic_load_n(&s_tail, __ATOMIC_ACQUIRE);
+    if (used > s_ring_mask) {
+        s_pending_drops++;
+        portENTER_CRITICAL_ISR(&s_handlers_lock);
+        s_stats.dropped++;
+        portEXIT_CRITICAL_ISR(&s_handlers_lock);
+        return;
+    }
+    input_event_t *event = &s_ring[head & s_ring_mask];
+    event->gpio_num = gpio_num;
+    event->level = gpio_ll_get_level(&GPIO, gpio_num);
+    event->timestamp_us = esp_timer_get_time();
+    event->dropped = s_pending_drops;
+    s_pending_drops = 0;
+    __atomic_store_n(&s_head, head + 1, __ATOMIC_RELEASE);
+
+    /* Same lock as input_io_get_deferred_stats, so a reader on the other core never sees half an update */
+    portENTER_CRITICAL_ISR(&s_handlers_lock);
+    s_stats.pushed++;
+    if (used + 1 > s_stats.high_water) {
+        s_stats.high_water = used + 1;
+    }
+    portEXIT_CRITICAL_ISR(&s_handlers_lock);
+
+    /* Only wake the worker on the empty -> non-empty transition */
+    if (used == 0) {
+        BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+        vTaskNotifyGiveFromISR(s_worker, &xHigherPriorityTaskWoken);
+        if (xHigherPriorityTaskWoken) {
+            portYIELD_FROM_ISR();
+        }
+    }
+}
+
+/* Returns false when the edge tripped the storm ceiling and must not be dispatched */
+static bool IRAM_ATTR input_meter_edge(gpio_num_t gpio_num) {
+    input_meter_t *meter = &s_meters[gpio_num];
+    bool storm = false;
+    if (s_meter_timer == NULL) {
+        meter->edges++;
+        return true;
+    }
+    portENTER_CRITICAL_ISR(&s_meter_lock);
+    meter->edges++;
+    uint32_t rate = meter->completed + ++meter->bucket[meter->cur];
+    if (meter->limit && rate > meter->limit && !meter->masked) {
+        gpio_ll_intr_disable(&GPIO, gpio_num);
+        meter->masked = true;
+        meter->backoff_left = s_backoff_ticks;
+        meter->storms++;
+        meter->storm_pending = true;
+        storm = true;
+    }
+    portEXIT_CRITICAL_ISR(&s_meter_lock);
+    return !storm && !meter->masked;
+}
 
 static void IRAM_ATTR gpio_input_handler(void * arg) {
-    int gpio_num = (uint32_t) arg;
-    input_callback(gpio_num);
+    input_handler_t *handler = (input_handler_t *) arg;
+    gpio_num_t gpio_num = (gpio_num_t) (handler - s_handlers);
+    if (!input_meter_edge(gpio_num)) {
+        return;
+    }
+    /* Load the slot under the lock input_io_set_handler writes it with, so
+     * the callback always runs with its own ctx. It runs outside the lock. */
+    portENTER_CRITICAL_ISR(&s_handlers_lock);
+    input_handler_t snapshot = *handler;
+    portEXIT_CRITICAL_ISR(&s_handlers_lock);
+    if (snapshot.event_cb && s_ring) {
+        input_event_push(gpio_num);
+    } else if (snapshot.cb) {
+        snapshot.cb(gpio_num, snapshot.ctx);
+    }
+}
+
+static void input_deferred_task(void *pvParameters) {
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        uint32_t tail = s_tail;
+        uint32_t head;
+        while ((head = __atomic_load_n(&s_head, __ATOMIC_ACQUIRE)) != tail) {
+            uint32_t count = head - tail;
+            if (count > s_batch_size) {
+                count = s_batch_size;
+            }
+            for (uint32_t i = 0; i < count; i++) {
+                const input_event_t *event = &s_ring[(tail + i) & s_ring_mask];
+                portENTER_CRITICAL(&s_handlers_lock);
+                input_handler_t handler = s_handlers[event->gpio_num];
+                portEXIT_CRITICAL(&s_handlers_lock);
+                if (handler.event_cb) {
+                    handler.event_cb(event, handler.ctx);
+                }
+            }
+            tail += count;
+            /* Hand the slots back before the next batch so the ISR can reuse them */
+            __atomic_store_n(&s_tail, tail, __ATOMIC_RELEASE);
+        }
+    }
 }
 
-void input_io_create(gpio_num_t gpio_num, interrupt_type_edge_t type) {
+void input_io_create(gpio_num_t gpio_num, gpio_int_type_t type) {
     gpio_pad_select_gpio(gpio_num);
     gpio_set_direction(gpio_num, GPIO_MODE_INPUT);
     gpio_set_pull_mode(gpio_num, GPIO_PULLUP_ONLY);
     gpio_set_intr_type(gpio_num, type);
-    gpio_install_isr_service(0);
-    gpio_isr_handler_add(gpio_num, gpio_input_handler, (void*)gpio_num);
+    if (!s_isr_service_installed) {
+        esp_err_t err = gpio_install_isr_service(0);
+        /* ESP_ERR_INVALID_STATE means another component already installed it */
+        if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+            ESP_LOGE(TAG, "install isr service failed: %s", esp_err_to_name(err));
+            return;
+        }
+        s_isr_service_installed = true;
+    }
+    gpio_isr_handler_add(gpio_num, gpio_input_handler, &s_handlers[gpio_num]);
 }
 
 int input_io_get_level(gpio_num_t gpio_num) {
     return gpio_get_level(gpio_num);
 }
 
-void input_set_callback(void *cb) {
-    input_callback = cb;
-}
\ No newline at end of file
+esp_err_t input_io_set_handler(gpio_num_t gpio_num, input_callback_t cb, void *ctx) {
+    if (!GPIO_IS_VALID_GPIO(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    /* The ISR and the worker copy the slot under the same lock, so neither
+     * can see the new ctx paired with the old callback */
+    portENTER_CRITICAL(&s_handlers_lock);
+    s_handlers[gpio_num].cb = cb;
+    s_handlers[gpio_num].event_cb = NULL;
+    s_handlers[gpio_num].ctx = ctx;
+    portEXIT_CRITICAL(&s_handlers_lock);
+    return ESP_OK;
+}
+
+esp_err_t input_io_deferred_start(const input_deferred_config_t *config) {
+    if (config == NULL || config->ring_size < 2 || config->batch_size == 0 ||
+        (config->ring_size & (config->ring_size - 1)) != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_ring) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    input_event_t *ring = calloc(config->ring_size, sizeof(input_event_t));
+    if (ring == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_ring_mask = config->ring_size - 1;
+    s_batch_size = config->batch_size;
+    s_head = 0;
+    s_tail = 0;
+    if (xTaskCreate(input_deferred_task, "input_deferred_task", config->task_stack,
+                    NULL, config->task_priority, &s_worker) != pdPASS) {
+        free(ring);
+        return ESP_ERR_NO_MEM;
+    }
+    /* Publishing the ring last is what turns the deferred path on in the ISR */
+    __atomic_store_n(&s_ring, ring, __ATOMIC_RELEASE);
+    return ESP_OK;
+}
+
+esp_err_t input_io_set_deferred_handler(gpio_num_t gpio_num, input_event_callback_t cb, void *ctx) {
+    if (!GPIO_IS_VALID_GPIO(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&s_handlers_lock);
+    s_handlers[gpio_num].cb = NULL;
+    s_handlers[gpio_num].event_cb = cb;
+    s_handlers[gpio_num].ctx = ctx;
+    portEXIT_CRITICAL(&s_handlers_lock);
+    return ESP_OK;
+}
+
+void input_io_get_deferred_stats(input_deferred_stats_t *stats) {
+    portENTER_CRITICAL(&s_handlers_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_handlers_lock);
+}
+
+uint64_t IRAM_ATTR input_io_get_levels(void) {
+    /* One read per input register bank, all pins in a bank are latched together */
+    uint64_t levels = GPIO.in;
+#if SOC_GPIO_PIN_COUNT > 32
+    levels |= (uint64_t) GPIO.in1.data << 32;
+#endif
+    return levels;
+}
+
+static void input_scan_task(void *pvParameters) {
+    input_scanner_t *scanner = (input_scanner_t *) pvParameters;
+    TickType_t last_wake = xTaskGetTickCount();
+    for (;;) {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(scanner->period_ms));
+        uint64_t changed = input_scan_update(&scanner->scan, input_io_get_levels());
+        if (changed) {
+            scanner->cb(changed, scanner->scan.stable, scanner->ctx);
+        }
+    }
+}
+
+esp_err_t input_io_scan_start(const input_scan_config_t *config, input_scan_callback_t cb, void *ctx) {
+    if (config == NULL || cb == NULL || config->mask == 0 || pdMS_TO_TICKS(config->period_ms) == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    input_scanner_t *scanner = calloc(1, sizeof(input_scanner_t));
+    if (scanner == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    input_scan_init(&scanner->scan, config->mask, input_io_get_levels(), config->debounce_samples);
+    scanner->period_ms = config->period_ms;
+    scanner->cb = cb;
+    scanner->ctx = ctx;
+    if (xTaskCreate(input_scan_task, "input_scan_task", config->task_stack,
+                    scanner, config->task_priority, NULL) != pdPASS) {
+        free(scanner);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+static void input_meter_tick(void *arg) {
+    for (int gpio_num = 0; gpio_num < GPIO_NUM_MAX; gpio_num++) {
+        input_meter_t *meter = &s_meters[gpio_num];
+        bool report = false;
+        bool rearm = false;
+        uint32_t rate;
+
+        portENTER_CRITICAL(&s_meter_lock);
+        rate = meter->completed + meter->bucket[meter->cur];
+        meter->completed += meter->bucket[meter->cur];
+        meter->cur = (meter->cur + 1) % INPUT_METER_BUCKETS;
+        meter->completed -= meter->bucket[meter->cur];
+        meter->bucket[meter->cur] = 0;
+        if (meter->storm_pending) {
+            meter->storm_pending = false;
+            report = true;
+        } else if (meter->masked && --meter->backoff_left == 0) {
+            /* Start the new period with a clean window so the pin isn't tripped straight away */
+            memset(meter->bucket, 0, sizeof(meter->bucket));
+            meter->completed = 0;
+            meter->masked = false;
+            rearm = true;
+        }
+        portEXIT_CRITICAL(&s_meter_lock);
+
+        if (report) {
+            ESP_LOGW(TAG, "interrupt storm on GPIO %d (%u edges/s), masked", gpio_num, rate);
+            if (s_storm_cb) {
+                s_storm_cb(gpio_num, rate, s_storm_ctx);
+            }
+        }
+        if (rearm) {
+            gpio_intr_enable(gpio_num);
+        }
+    }
+}
+
+esp_err_t input_io_storm_start(const input_storm_config_t *config, input_storm_callback_t cb, void *ctx) {
+    if (config == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_meter_timer) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    uint32_t backoff_ticks = (config->backoff_ms + INPUT_METER_TICK_MS - 1) / INPUT_METER_TICK_MS;
+    s_backoff_ticks = backoff_ticks ? (backoff_ticks > UINT16_MAX ? UINT16_MAX : backoff_ticks) : 1;
+    s_storm_cb = cb;
+    s_storm_ctx = ctx;
+    portENTER_CRITICAL(&s_meter_lock);
+    for (int gpio_num = 0; gpio_num < GPIO_NUM_MAX; gpio_num++) {
+        s_meters[gpio_num].limit = config->max_edges_per_sec;
+    }
+    portEXIT_CRITICAL(&s_meter_lock);
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = input_meter_tick,
+        .name = "input_meter",
+    };
+    esp_err_t err = esp_timer_create(&timer_args, &s_meter_timer);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return esp_timer_start_periodic(s_meter_timer, INPUT_METER_TICK_MS * 1000);
+}
+
+esp_err_t input_io_set_storm_limit(gpio_num_t gpio_num, uint32_t max_edges_per_sec) {
+    if (!GPIO_IS_VALID_GPIO(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&s_meter_lock);
+    s_meters[gpio_num].limit = max_edges_per_sec;
+    portEXIT_CRITICAL(&s_meter_lock);
+    return ESP_OK;
+}
+
+esp_err_t input_io_get_health(gpio_num_t gpio_num, input_health_t *health) {
+    if (!GPIO_IS_VALID_GPIO(gpio_num) || health == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    input_meter_t *meter = &s_meters[gpio_num];
+    portENTER_CRITICAL(&s_meter_lock);
+    health->edges = meter->edges;
+    health->rate = meter->completed + meter->bucket[meter->cur];
+    health->storms = meter->storms;
+    health->masked = meter->masked;
+    portEXIT_CRITICAL(&s_meter_lock);
+    return ESP_OK;
+}
@@ -28,6 +28,13 @@ EventGroupHandle_t xCreatedEventGroup;
 /* An array to hold handles to the created timers. */
 TimerHandle_t xTimers[NUM_TIMERS];
 
+/* Toggle every 500 ms, driven by LEDC instead of the timer daemon task */
+static const output_pattern_t blink_pattern = {
+    .period_ms = 1000,
+    .duty_percent = 50,
+};
+static bool blinking = true;
+
 /* Task to be created. */
 void vTask1(void *pvParameters)
 {
@@ -81,29 +88,21 @@ void vTimerCallback(TimerHandle_t xTimer)
     /* The number of times this timer has expired is saved as the
     timer's ID.  Obtain the count. */
     uint32_t ulCount = (uint32_t)pvTimerGetTimerID(xTimer);
-    if (ulCount == 0)
-    {
-        printf("Blink LED\n");
-        output_io_toggle(2);
-    }
-    else
+    if (ulCount == 1)
     {
         printf("Print Uart\n");
     }
 }
 
-void button_callback(int pin)
+void button_callback(gpio_num_t pin, void *ctx)
 {
-    if (pin == GPIO_NUM_0)
-    {
-        EventBits_t uxBits;
-        BaseType_t xHigherPriorityTaskWoken;
+    EventBits_t uxBits;
+    BaseType_t xHigherPriorityTaskWoken;
 
-        /* Set bit 0 and bit 4 in xEventGroup. */
-        uxBits = xEventGroupSetBitsFromISR(
-            xCreatedEventGroup,                            /* The event group being updated. */
-            BIT_EVENT_BUTTON_PRESS | BIT_EVENT_UART_RECV, &xHigherPriorityTaskWoken); /* The bits being set. */
-    }
+    /* Set bit 0 and bit 4 in xEventGroup. */
+    uxBits = xEventGroupSetBitsFromISR(
+        (EventGroupHandle_t) ctx,                      /* The event group being updated. */
+        BIT_EVENT_BUTTON_PRESS | BIT_EVENT_UART_RECV, &xHigherPriorityTaskWoken); /* The bits being set. */
 }
 
 /* Task to be created. */
@@ -123,7 +122,13 @@ void vTaskButtonHandle(void *pvParameters)
             portMAX_DELAY); /* Wait a maximum of 100ms for either bit to be set. */
         if(uxBits & BIT_EVENT_BUTTON_PRESS) {
             printf("BUTTON PRESS\n");
-            output_io_toggle(2);
+            /* The LED pin belongs to the pattern engine, pause or resume it */
+            blinking = !blinking;
+            if (blinking) {
+                output_io_pattern_start(2, &blink_pattern);
+            } else {
+                output_io_pattern_stop(2);
+            }
         }
         if(uxBits & BIT_EVENT_UART_RECV) {
             printf("UART DATA\n");
@@ -158,39 +163,6 @@ void app_main(void)
     the RTOS scheduler has been started means the timers will start
     running immediately that the RTOS scheduler starts. */
 
-    xTimers[0] = xTimerCreate(/* Just a text name, not used by the RTOS
-                              kernel. */
-                              "TimerBlink",
-                              /* The timer period in ticks, must be
-                              greater than 0. */
-                              pdMS_TO_TICKS(500),
-                              /* The timers will auto-reload themselves
-                              when they expire. */
-                              pdTRUE,
-                              /* The ID is used to store a count of the
-                              number of times the timer has expired, which
-                              is initialised to 0. */
-                              (void *)0,
-                              /* Each timer calls the same callback when
-                              it expires. */
-                              vTimerCallback);
-
-    if (xTimers[0] == NULL)
-    {
-        /* The timer was not created. */
-    }
-    else
-    {
-        /* Start the timer.  No block time is specified, and
-        even if one was it would be ignored because the RTOS
-        scheduler has not yet been started. */
-        if (xTimerStart(xTimers[0], 0) != pdPASS)
-        {
-            /* The timer could not be set into the Active
-            state. */
-        }
-    }
-
     xTimers[1] = xTimerCreate(/* Just a text name, not used by the RTOS
                           kernel. */
                               "TimerPrint",
@@ -225,8 +197,9 @@ void app_main(void)
     }
 
     output_io_create(2);
-    input_io_create(0, HI_TO_LO);
-    input_set_callback(button_callback);
+    output_io_pattern_start(2, &blink_pattern);
+    input_io_set_handler(GPIO_NUM_0, button_callback, xCreatedEventGroup);
+    input_io_create(GPIO_NUM_0, HI_TO_LO);
 
     /* Create the task, storing the handle. */
     xReturned = xTaskCreate(
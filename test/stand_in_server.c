@@ -0,0 +1,168 @@
+#define _GNU_SOURCE
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "lwip/sockets.h"
+#include "test_util.h"
+#include "stand_in_server.h"
+
+#define REQUEST_MAX     4096
+
+static pthread_mutex_t s_server_lock = PTHREAD_MUTEX_INITIALIZER;
+static server_mode_t s_mode;
+static server_traffic_t s_traffic;
+static char s_last[REQUEST_MAX];
+static size_t s_last_len;
+static char s_port[8];
+
+void server_set_mode(server_mode_t mode) {
+    pthread_mutex_lock(&s_server_lock);
+    s_mode = mode;
+    pthread_mutex_unlock(&s_server_lock);
+}
+
+int server_requests(void) {
+    pthread_mutex_lock(&s_server_lock);
+    int n = s_traffic.requests;
+    pthread_mutex_unlock(&s_server_lock);
+    return n;
+}
+
+void server_get_traffic(server_traffic_t *traffic) {
+    pthread_mutex_lock(&s_server_lock);
+    *traffic = s_traffic;
+    pthread_mutex_unlock(&s_server_lock);
+}
+
+size_t server_last(char *buf, size_t size) {
+    pthread_mutex_lock(&s_server_lock);
+    size_t len = s_last_len < size ? s_last_len : size;
+    memcpy(buf, s_last, len);
+    pthread_mutex_unlock(&s_server_lock);
+    return len;
+}
+
+static void server_send(int s, const char *data) {
+    size_t len = strlen(data);
+    while (len) {
+        int n = send(s, data, len, 0);
+        if (n <= 0) {
+            return;
+        }
+        pthread_mutex_lock(&s_server_lock);
+        s_traffic.bytes_out += n;
+        pthread_mutex_unlock(&s_server_lock);
+        data += n;
+        len -= n;
+    }
+}
+
+/* Length of the first whole request in buf, 0 while it is incomplete */
+static size_t server_request_len(const char *buf, size_t len) {
+    const char *end = memmem(buf, len, "\r\n\r\n", 4);
+    if (end == NULL) {
+        return 0;
+    }
+    size_t head = end + 4 - buf;
+    size_t body = 0;
+    const char *cl = memmem(buf, head, "Content-Length:", 15);
+    if (cl) {
+        body = strtoul(cl + 15, NULL, 10);
+    }
+    return head + body <= len ? head + body : 0;
+}
+
+static void *server_connection(void *arg) {
+    int s = (int) (intptr_t) arg;
+    char buf[REQUEST_MAX];
+    size_t len = 0;
+    for (;;) {
+        int n = recv(s, buf + len, sizeof(buf) - len, 0);
+        if (n <= 0) {
+            break;
+        }
+        len += n;
+        pthread_mutex_lock(&s_server_lock);
+        s_traffic.bytes_in += n;
+        pthread_mutex_unlock(&s_server_lock);
+        size_t request_len;
+        while ((request_len = server_request_len(buf, len)) > 0) {
+            pthread_mutex_lock(&s_server_lock);
+            server_mode_t mode = s_mode;
+            if (mode == SERVER_CLOSE_UNANSWERED) {
+                s_mode = SERVER_OK;
+            }
+            s_traffic.requests++;
+            memcpy(s_last, buf, request_len);
+            s_last_len = request_len;
+            pthread_mutex_unlock(&s_server_lock);
+            memmove(buf, buf + request_len, len - request_len);
+            len -= request_len;
+
+            switch (mode) {
+            case SERVER_OK:
+                server_send(s, "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok");
+                break;
+            case SERVER_OK_CLOSE:
+                server_send(s, "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok");
+                goto done;
+            case SERVER_OK_RESET: {
+                server_send(s, "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok");
+                struct linger linger = { .l_onoff = 1, .l_linger = 0 };
+                setsockopt(s, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+                goto done;
+            }
+            case SERVER_CLOSE_UNANSWERED:
+                goto done;
+            case SERVER_CHUNKED:
+                server_send(s, "HTTP/1.1 201 Created\r\nTransfer-Encoding: chunked\r\n\r\n"
+                            "5\r\nhello\r\n6\r\n world\r\n0\r\n\r\n");
+                break;
+            case SERVER_UNTIL_CLOSE:
+                server_send(s, "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n\r\nuntil the end");
+                goto done;
+            case SERVER_SILENT:
+                break;
+            }
+        }
+    }
+done:
+    close(s);
+    return NULL;
+}
+
+static void *server_task(void *arg) {
+    int listener = (int) (intptr_t) arg;
+    for (;;) {
+        int s = accept(listener, NULL, NULL);
+        if (s < 0) {
+            continue;
+        }
+        pthread_mutex_lock(&s_server_lock);
+        s_traffic.connections++;
+        pthread_mutex_unlock(&s_server_lock);
+        pthread_t thread;
+        pthread_create(&thread, NULL, server_connection, (void *) (intptr_t) s);
+        pthread_detach(thread);
+    }
+    return NULL;
+}
+
+const char *server_start(void) {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    TEST_CHECK(listener >= 0);
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    socklen_t addr_len = sizeof(addr);
+    TEST_CHECK(bind(listener, (struct sockaddr *) &addr, sizeof(addr)) == 0);
+    TEST_CHECK(listen(listener, 16) == 0);
+    TEST_CHECK(getsockname(listener, (struct sockaddr *) &addr, &addr_len) == 0);
+    snprintf(s_port, sizeof(s_port), "%u", ntohs(addr.sin_port));
+    pthread_t thread;
+    pthread_create(&thread, NULL, server_task, (void *) (intptr_t) listener);
+    pthread_detach(thread);
+    return s_port;
+}
@@ -0,0 +1,37 @@
+#ifndef STAND_IN_SERVER_H
+#define STAND_IN_SERVER_H
+#include <stddef.h>
+#include <stdint.h>
+
+/* HTTP server on loopback for the http_iot based tests. Each connection
+ * gets a thread that reads whole requests and answers the way the current
+ * mode says, so a test can make the server drop a kept connection, reset
+ * it, or sit on a request without answering. */
+
+typedef enum {
+    SERVER_OK,                  /* 200 with Content-Length, connection kept */
+    SERVER_OK_CLOSE,            /* Same, then the server closes without saying so */
+    SERVER_OK_RESET,            /* Same, then the connection is reset */
+    SERVER_CLOSE_UNANSWERED,    /* Takes one request and closes without answering, then SERVER_OK */
+    SERVER_CHUNKED,
+    SERVER_UNTIL_CLOSE,         /* No length, the body ends with the connection */
+    SERVER_SILENT,              /* Takes the request and never answers */
+} server_mode_t;
+
+/* Everything the server has seen, bytes count HTTP only */
+typedef struct {
+    uint32_t connections;
+    uint32_t requests;          /* Whole requests read */
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+} server_traffic_t;
+
+/* Starts listening on a free port and returns it as a service string */
+const char *server_start(void);
+void server_set_mode(server_mode_t mode);
+int server_requests(void);
+void server_get_traffic(server_traffic_t *traffic);
+/* Copies the most recent request, returns its length */
+size_t server_last(char *buf, size_t size);
+
+#endif
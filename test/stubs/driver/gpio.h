@@ -0,0 +1,21 @@
+#ifndef GPIO_H
+#define GPIO_H
+#include "esp_attr.h"
+#include "esp_err.h"
+#include "hal/gpio_types.h"
+#include "soc/soc_caps.h"
+
+/* The tests that link input_iot provide these, to record the setup and
+ * hand the ISR handlers back to the test */
+#define GPIO_IS_VALID_GPIO(gpio_num)    ((gpio_num) >= 0 && (gpio_num) < GPIO_NUM_MAX)
+
+void gpio_pad_select_gpio(uint8_t gpio_num);
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode);
+esp_err_t gpio_set_pull_mode(gpio_num_t gpio_num, gpio_pull_mode_t pull);
+esp_err_t gpio_set_intr_type(gpio_num_t gpio_num, gpio_int_type_t intr_type);
+esp_err_t gpio_install_isr_service(int intr_alloc_flags);
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args);
+esp_err_t gpio_intr_enable(gpio_num_t gpio_num);
+int gpio_get_level(gpio_num_t gpio_num);
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef UART_H
+#define UART_H
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+/* Only what the uart_iot headers and their users need. The tests provide
+ * the driver calls themselves, to feed input and capture the output. */
+typedef int uart_port_t;
+
+#define UART_NUM_0              0
+#define UART_NUM_1              1
+#define UART_PIN_NO_CHANGE      (-1)
+
+typedef enum {
+    UART_DATA,
+    UART_BREAK,
+    UART_BUFFER_FULL,
+    UART_FIFO_OVF,
+    UART_FRAME_ERR,
+    UART_PARITY_ERR,
+    UART_DATA_BREAK,
+    UART_PATTERN_DET,
+    UART_EVENT_MAX,
+} uart_event_type_t;
+
+typedef struct {
+    uart_event_type_t type;
+    size_t size;
+    bool timeout_flag;
+} uart_event_t;
+
+int uart_write_bytes(uart_port_t port, const void *src, size_t size);
+int uart_read_bytes(uart_port_t port, void *buf, uint32_t length, TickType_t ticks_to_wait);
+esp_err_t uart_get_buffered_data_len(uart_port_t port, size_t *size);
+
+#endif
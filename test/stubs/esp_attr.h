@@ -0,0 +1,8 @@
+#ifndef ESP_ATTR_H
+#define ESP_ATTR_H
+
+/* Everything runs from ordinary memory on the host */
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+#endif
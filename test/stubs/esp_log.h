@@ -0,0 +1,14 @@
+#ifndef ESP_LOG_H
+#define ESP_LOG_H
+#include "esp_err.h"
+
+/* Printed only when IOT_TEST_LOG is set in the environment. No printf format
+ * checking: the components print size_t with %u, which is right on the chip. */
+void host_log_write(char level, const char *tag, const char *format, ...);
+
+#define ESP_LOGE(tag, format, ...)  host_log_write('E', tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...)  host_log_write('W', tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...)  host_log_write('I', tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...)  host_log_write('D', tag, format, ##__VA_ARGS__)
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef ESP_TIMER_H
+#define ESP_TIMER_H
+#include <stdint.h>
+#include "esp_err.h"
+
+/* Monotonic microseconds, plus whatever host_timer_advance() has added */
+int64_t esp_timer_get_time(void);
+
+/* Timers are left to the tests that need them, so they can run the
+ * callbacks themselves instead of racing a real clock */
+typedef struct esp_timer *esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void *arg);
+
+typedef struct {
+    esp_timer_cb_t callback;
+    void *arg;
+    const char *name;
+} esp_timer_create_args_t;
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle);
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period);
+
+#endif
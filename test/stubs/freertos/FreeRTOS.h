@@ -0,0 +1,46 @@
+#ifndef FREERTOS_H
+#define FREERTOS_H
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Tasks are pthreads, see host_rtos.c. Ticks run at the CONFIG_FREERTOS_HZ the projects use. */
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define configTICK_RATE_HZ      100
+#define pdTRUE                  1
+#define pdFALSE                 0
+#define pdPASS                  pdTRUE
+#define pdFAIL                  pdFALSE
+#define portMAX_DELAY           ((TickType_t) 0xffffffffu)
+#define portTICK_PERIOD_MS      (1000 / configTICK_RATE_HZ)
+#define portTICK_RATE_MS        portTICK_PERIOD_MS
+#define pdMS_TO_TICKS(ms)       ((TickType_t) ((uint64_t) (ms) * configTICK_RATE_HZ / 1000))
+#define tskNO_AFFINITY          0x7fffffff
+
+/* Critical sections are spinlocks, the test thread playing the ISR takes them like a core would */
+typedef struct {
+    int locked;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED    { 0 }
+#define portMUX_INITIALIZE(mux)         ((mux)->locked = 0)
+
+static inline void host_critical_enter(portMUX_TYPE *mux) {
+    while (__atomic_exchange_n(&mux->locked, 1, __ATOMIC_ACQUIRE)) {
+    }
+}
+
+static inline void host_critical_exit(portMUX_TYPE *mux) {
+    __atomic_store_n(&mux->locked, 0, __ATOMIC_RELEASE);
+}
+
+#define portENTER_CRITICAL(mux)         host_critical_enter(mux)
+#define portEXIT_CRITICAL(mux)          host_critical_exit(mux)
+#define portENTER_CRITICAL_ISR(mux)     host_critical_enter(mux)
+#define portEXIT_CRITICAL_ISR(mux)      host_critical_exit(mux)
+#define portYIELD_FROM_ISR()            do { } while (0)
+
+#endif
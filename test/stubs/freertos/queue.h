@@ -0,0 +1,7 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+#include "freertos/FreeRTOS.h"
+
+typedef struct host_queue *QueueHandle_t;
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef GPIO_LL_H
+#define GPIO_LL_H
+#include <stdint.h>
+#include "hal/gpio_types.h"
+
+/* Just the input registers. The tests define GPIO and set the levels they want read. */
+typedef struct {
+    uint32_t in;
+    struct {
+        uint32_t data;
+    } in1;
+} gpio_dev_t;
+
+extern gpio_dev_t GPIO;
+
+static inline int gpio_ll_get_level(gpio_dev_t *hw, gpio_num_t gpio_num) {
+    return gpio_num < 32 ? (hw->in >> gpio_num) & 1 : (hw->in1.data >> (gpio_num - 32)) & 1;
+}
+
+void gpio_ll_intr_disable(gpio_dev_t *hw, gpio_num_t gpio_num);
+
+#endif
@@ -0,0 +1,385 @@
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <time.h>
+#include <errno.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "host_rtos.h"
+
+/* FreeRTOS on pthreads, just enough for the components under test: every
+ * object is a mutex and a condition variable, timeouts are tick based. */
+
+struct host_task {
+    pthread_t thread;
+    TaskFunction_t func;
+    void *arg;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify;
+    bool notified;
+};
+
+struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int count;
+};
+
+struct host_event_group {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    EventBits_t bits;
+};
+
+static __thread struct host_task *s_current;
+static int64_t s_time_offset_us;
+
+static int64_t host_monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int64_t esp_timer_get_time(void) {
+    return host_monotonic_us() + __atomic_load_n(&s_time_offset_us, __ATOMIC_RELAXED);
+}
+
+void host_timer_advance(int64_t us) {
+    __atomic_fetch_add(&s_time_offset_us, us, __ATOMIC_RELAXED);
+}
+
+void host_log_write(char level, const char *tag, const char *format, ...) {
+    if (getenv("IOT_TEST_LOG") == NULL) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "%c (%s) ", level, tag);
+    vfprintf(stderr, format, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+}
+
+const char *esp_err_to_name(esp_err_t code) {
+    switch (code) {
+        case ESP_OK:
+            return "ESP_OK";
+        case ESP_ERR_NO_MEM:
+            return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:
+            return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE:
+            return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE:
+            return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND:
+            return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_TIMEOUT:
+            return "ESP_ERR_TIMEOUT";
+        default:
+            return "ESP_FAIL";
+    }
+}
+
+static void host_deadline(struct timespec *ts, TickType_t ticks) {
+    clock_gettime(CLOCK_REALTIME, ts);
+    if (ticks == portMAX_DELAY) {
+        return;
+    }
+    int64_t ns = ts->tv_nsec + (int64_t) ticks * portTICK_PERIOD_MS * 1000000;
+    ts->tv_sec += ns / 1000000000;
+    ts->tv_nsec = ns % 1000000000;
+}
+
+/* One wait on cond with the lock held, false once the deadline has passed */
+static bool host_wait(pthread_cond_t *cond, pthread_mutex_t *lock, TickType_t ticks, const struct timespec *until) {
+    if (ticks == portMAX_DELAY) {
+        pthread_cond_wait(cond, lock);
+        return true;
+    }
+    return pthread_cond_timedwait(cond, lock, until) != ETIMEDOUT;
+}
+
+static struct host_task *host_task_new(TaskFunction_t func, void *arg) {
+    struct host_task *task = calloc(1, sizeof(struct host_task));
+    if (task) {
+        task->func = func;
+        task->arg = arg;
+        pthread_mutex_init(&task->lock, NULL);
+        pthread_cond_init(&task->cond, NULL);
+    }
+    return task;
+}
+
+/* Threads the test started itself get a task the first time they wait on a notification */
+static struct host_task *host_self(void) {
+    if (s_current == NULL) {
+        s_current = host_task_new(NULL, NULL);
+        s_current->thread = pthread_self();
+    }
+    return s_current;
+}
+
+static void *host_task_entry(void *arg) {
+    s_current = arg;
+    s_current->func(s_current->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t func, const char *name, uint32_t stack, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *ret_task, BaseType_t core) {
+    struct host_task *task = host_task_new(func, arg);
+    if (task == NULL) {
+        return pdFAIL;
+    }
+    if (ret_task) {
+        *ret_task = task;
+    }
+    if (pthread_create(&task->thread, NULL, host_task_entry, task) != 0) {
+        free(task);
+        return pdFAIL;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t func, const char *name, uint32_t stack, void *arg,
+                       UBaseType_t priority, TaskHandle_t *ret_task) {
+    return xTaskCreatePinnedToCore(func, name, stack, arg, priority, ret_task, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task == NULL || task == s_current) {
+        pthread_exit(NULL);
+    }
+    /* Tasks are only deleted while blocked, and every wait is a cancellation point */
+    pthread_cancel(task->thread);
+    pthread_join(task->thread, NULL);
+    pthread_mutex_destroy(&task->lock);
+    pthread_cond_destroy(&task->cond);
+    free(task);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    struct timespec ts = {
+        .tv_sec = ticks * portTICK_PERIOD_MS / 1000,
+        .tv_nsec = (long) (ticks * portTICK_PERIOD_MS % 1000) * 1000000,
+    };
+    nanosleep(&ts, NULL);
+}
+
+void vTaskDelayUntil(TickType_t *previous_wake, TickType_t ticks) {
+    *previous_wake += ticks;
+    TickType_t left = *previous_wake - xTaskGetTickCount();
+    if ((int32_t) left > 0) {
+        vTaskDelay(left);
+    }
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t) (esp_timer_get_time() / 1000 / portTICK_PERIOD_MS);
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action) {
+    pthread_mutex_lock(&task->lock);
+    switch (action) {
+        case eSetBits:
+            task->notify |= value;
+            break;
+        case eIncrement:
+            task->notify++;
+            break;
+        case eSetValueWithOverwrite:
+        case eSetValueWithoutOverwrite:
+            task->notify = value;
+            break;
+        default:
+            break;
+    }
+    task->notified = true;
+    pthread_cond_broadcast(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+void xTaskNotifyGive(TaskHandle_t task) {
+    xTaskNotify(task, 0, eIncrement);
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higher_priority_woken) {
+    xTaskNotifyGive(task);
+    if (higher_priority_woken) {
+        *higher_priority_woken = pdFALSE;
+    }
+}
+
+static void host_unlock(void *lock) {
+    pthread_mutex_unlock(lock);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks) {
+    struct host_task *task = host_self();
+    struct timespec until;
+    bool waiting = true;
+    host_deadline(&until, ticks);
+    pthread_mutex_lock(&task->lock);
+    pthread_cleanup_push(host_unlock, &task->lock);
+    while (task->notify == 0 && waiting) {
+        waiting = host_wait(&task->cond, &task->lock, ticks, &until);
+    }
+    pthread_cleanup_pop(0);
+    uint32_t value = task->notify;
+    if (value) {
+        task->notify = clear ? 0 : value - 1;
+    }
+    task->notified = false;
+    pthread_mutex_unlock(&task->lock);
+    return value;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *value, TickType_t ticks) {
+    struct host_task *task = host_self();
+    struct timespec until;
+    bool waiting = true;
+    host_deadline(&until, ticks);
+    pthread_mutex_lock(&task->lock);
+    pthread_cleanup_push(host_unlock, &task->lock);
+    if (!task->notified) {
+        task->notify &= ~clear_on_entry;
+    }
+    while (!task->notified && waiting) {
+        waiting = host_wait(&task->cond, &task->lock, ticks, &until);
+    }
+    pthread_cleanup_pop(0);
+    bool ok = task->notified;
+    if (value) {
+        *value = task->notify;
+    }
+    if (ok) {
+        task->notify &= ~clear_on_exit;
+        task->notified = false;
+    }
+    pthread_mutex_unlock(&task->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+static SemaphoreHandle_t host_semaphore(int count) {
+    struct host_queue *semaphore = calloc(1, sizeof(struct host_queue));
+    if (semaphore) {
+        pthread_mutex_init(&semaphore->lock, NULL);
+        pthread_cond_init(&semaphore->cond, NULL);
+        semaphore->count = count;
+    }
+    return semaphore;
+}
+
+/* No priority inheritance or owner tracking, a mutex is a binary semaphore that starts given */
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    return host_semaphore(1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+    return host_semaphore(0);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+    struct timespec until;
+    bool waiting = true;
+    host_deadline(&until, ticks);
+    pthread_mutex_lock(&semaphore->lock);
+    pthread_cleanup_push(host_unlock, &semaphore->lock);
+    while (semaphore->count == 0 && waiting) {
+        waiting = host_wait(&semaphore->cond, &semaphore->lock, ticks, &until);
+    }
+    pthread_cleanup_pop(0);
+    bool ok = semaphore->count > 0;
+    if (ok) {
+        semaphore->count--;
+    }
+    pthread_mutex_unlock(&semaphore->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    pthread_mutex_lock(&semaphore->lock);
+    bool ok = semaphore->count == 0;
+    if (ok) {
+        semaphore->count = 1;
+        pthread_cond_signal(&semaphore->cond);
+    }
+    pthread_mutex_unlock(&semaphore->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+    pthread_mutex_destroy(&semaphore->lock);
+    pthread_cond_destroy(&semaphore->cond);
+    free(semaphore);
+}
+
+EventGroupHandle_t xEventGroupCreate(void) {
+    struct host_event_group *group = calloc(1, sizeof(struct host_event_group));
+    if (group) {
+        pthread_mutex_init(&group->lock, NULL);
+        pthread_cond_init(&group->cond, NULL);
+    }
+    return group;
+}
+
+void vEventGroupDelete(EventGroupHandle_t group) {
+    pthread_mutex_destroy(&group->lock);
+    pthread_cond_destroy(&group->cond);
+    free(group);
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+    pthread_mutex_lock(&group->lock);
+    group->bits |= bits;
+    EventBits_t now = group->bits;
+    pthread_cond_broadcast(&group->cond);
+    pthread_mutex_unlock(&group->lock);
+    return now;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+    pthread_mutex_lock(&group->lock);
+    EventBits_t before = group->bits;
+    group->bits &= ~bits;
+    pthread_mutex_unlock(&group->lock);
+    return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group) {
+    pthread_mutex_lock(&group->lock);
+    EventBits_t now = group->bits;
+    pthread_mutex_unlock(&group->lock);
+    return now;
+}
+
+static bool host_bits_set(EventBits_t now, EventBits_t bits, BaseType_t all) {
+    return all ? (now & bits) == bits : (now & bits) != 0;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear,
+                                BaseType_t all, TickType_t ticks) {
+    struct timespec until;
+    bool waiting = true;
+    host_deadline(&until, ticks);
+    pthread_mutex_lock(&group->lock);
+    pthread_cleanup_push(host_unlock, &group->lock);
+    while (!host_bits_set(group->bits, bits, all) && waiting) {
+        waiting = host_wait(&group->cond, &group->lock, ticks, &until);
+    }
+    pthread_cleanup_pop(0);
+    bool ok = host_bits_set(group->bits, bits, all);
+    EventBits_t now = group->bits;
+    if (ok && clear) {
+        group->bits &= ~bits;
+    }
+    pthread_mutex_unlock(&group->lock);
+    return now;
+}
@@ -0,0 +1,10 @@
+#ifndef HOST_RTOS_H
+#define HOST_RTOS_H
+#include <stdint.h>
+
+/* Test hooks into the host stand-ins */
+
+/* Moves esp_timer_get_time() forward, so TTLs and deadlines expire without waiting */
+void host_timer_advance(int64_t us);
+
+#endif
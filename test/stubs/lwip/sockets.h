@@ -0,0 +1,13 @@
+#ifndef LWIP_SOCKETS_H
+#define LWIP_SOCKETS_H
+/* lwIP keeps the BSD names, so the host's own sockets stand in for it */
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <errno.h>
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef SOC_CAPS_H
+#define SOC_CAPS_H
+
+/* esp32 */
+#define SOC_GPIO_PIN_COUNT      40
+
+#endif
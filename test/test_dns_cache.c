@@ -0,0 +1,243 @@
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "test_util.h"
+#include "host_rtos.h"
+#include "dns_cache.h"
+
+/* The cache is process wide, so the cases run in sequence on one instance
+ * and each uses its own host names. The resolver is a stub whose answers
+ * count up, so a refreshed address differs from the one it replaced, and
+ * time moves with host_timer_advance instead of waiting out TTLs. */
+
+#define DEFAULT_TTL_S   300
+#define MIN_TTL_S       30
+#define MAX_STALE_S     3600
+#define SECONDS(s)      ((int64_t) (s) * 1000000)
+
+static pthread_mutex_t s_resolver_lock = PTHREAD_MUTEX_INITIALIZER;
+static int s_calls;
+static bool s_fail;
+static uint32_t s_ttl_s;
+static int s_delay_ms;
+
+static esp_err_t resolve(const char *host, struct in_addr *addr, uint32_t *ttl_s, void *ctx) {
+    pthread_mutex_lock(&s_resolver_lock);
+    int call = ++s_calls;
+    bool fail = s_fail;
+    uint32_t ttl = s_ttl_s;
+    int delay_ms = s_delay_ms;
+    pthread_mutex_unlock(&s_resolver_lock);
+    usleep(delay_ms * 1000);
+    if (fail) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    addr->s_addr = htonl(0x0a000000 + call);
+    *ttl_s = ttl;
+    return ESP_OK;
+}
+
+static void resolver_set(bool fail, uint32_t ttl_s, int delay_ms) {
+    pthread_mutex_lock(&s_resolver_lock);
+    s_fail = fail;
+    s_ttl_s = ttl_s;
+    s_delay_ms = delay_ms;
+    pthread_mutex_unlock(&s_resolver_lock);
+}
+
+static int resolver_calls(void) {
+    pthread_mutex_lock(&s_resolver_lock);
+    int n = s_calls;
+    pthread_mutex_unlock(&s_resolver_lock);
+    return n;
+}
+
+static dns_cache_stats_t stats(void) {
+    dns_cache_stats_t stats;
+    dns_cache_get_stats(&stats);
+    return stats;
+}
+
+/* Background refreshes finish on their own time */
+#define WAIT_FOR(cond) do {                                 \
+    for (int _i = 0; _i < 2000 && !(cond); _i++) {          \
+        usleep(1000);                                       \
+    }                                                       \
+    TEST_CHECK(cond);                                       \
+} while (0)
+
+static uint32_t lookup(const char *host) {
+    struct in_addr addr;
+    TEST_CHECK(dns_cache_lookup(host, &addr, portMAX_DELAY) == ESP_OK);
+    return addr.s_addr;
+}
+
+static void test_hit(void) {
+    int calls = resolver_calls();
+    uint32_t addr = lookup("hit.test");
+    TEST_CHECK(resolver_calls() == calls + 1);
+    for (int i = 0; i < 10; i++) {
+        TEST_CHECK(lookup("hit.test") == addr);
+    }
+    TEST_CHECK(resolver_calls() == calls + 1);
+    TEST_CHECK(stats().hits == 10 && stats().misses == 1);
+}
+
+/* Past the TTL the old address is answered at once and refreshed behind it */
+static void test_stale_refresh(void) {
+    uint32_t addr = lookup("stale.test");
+    dns_cache_stats_t before = stats();
+    host_timer_advance(SECONDS(DEFAULT_TTL_S + 1));
+    TEST_CHECK(lookup("stale.test") == addr);
+    WAIT_FOR(stats().refreshes == before.refreshes + 1);
+    TEST_CHECK(stats().stale_hits == before.stale_hits + 1);
+    uint32_t refreshed = lookup("stale.test");
+    TEST_CHECK(refreshed != addr);
+    TEST_CHECK(stats().hits == before.hits + 1);
+
+    /* Marked expired, e.g. after a refused connect, it goes the same way */
+    dns_cache_expire("stale.test");
+    TEST_CHECK(lookup("stale.test") == refreshed);
+    WAIT_FOR(stats().refreshes == before.refreshes + 2);
+    TEST_CHECK(lookup("stale.test") != refreshed);
+}
+
+/* A DNS outage keeps serving the last address until max_stale_s runs out */
+static void test_outage(void) {
+    uint32_t addr = lookup("outage.test");
+    dns_cache_stats_t before = stats();
+    resolver_set(true, 0, 0);
+    host_timer_advance(SECONDS(DEFAULT_TTL_S + 1));
+    TEST_CHECK(lookup("outage.test") == addr);
+    WAIT_FOR(stats().failures == before.failures + 1);
+    host_timer_advance(SECONDS(MAX_STALE_S / 2));
+    TEST_CHECK(lookup("outage.test") == addr);
+    WAIT_FOR(stats().failures == before.failures + 2);
+
+    host_timer_advance(SECONDS(MAX_STALE_S));
+    struct in_addr gone;
+    TEST_CHECK(dns_cache_lookup("outage.test", &gone, portMAX_DELAY) == ESP_ERR_NOT_FOUND);
+    resolver_set(false, 0, 0);
+    TEST_CHECK(lookup("outage.test") != addr);
+}
+
+static void test_ttl(void) {
+    /* The record's own TTL wins over the default */
+    resolver_set(false, 600, 0);
+    uint32_t addr = lookup("long.test");
+    host_timer_advance(SECONDS(DEFAULT_TTL_S + 100));
+    dns_cache_stats_t before = stats();
+    TEST_CHECK(lookup("long.test") == addr);
+    TEST_CHECK(stats().hits == before.hits + 1 && stats().stale_hits == before.stale_hits);
+
+    /* A very short one is raised to min_ttl_s */
+    resolver_set(false, 5, 0);
+    addr = lookup("short.test");
+    host_timer_advance(SECONDS(MIN_TTL_S - 1));
+    before = stats();
+    TEST_CHECK(lookup("short.test") == addr);
+    TEST_CHECK(stats().hits == before.hits + 1);
+    host_timer_advance(SECONDS(2));
+    TEST_CHECK(lookup("short.test") == addr);
+    TEST_CHECK(stats().stale_hits == before.stale_hits + 1);
+    WAIT_FOR(stats().refreshes == before.refreshes + 1);
+    resolver_set(false, 0, 0);
+}
+
+static void *shared_lookup(void *arg) {
+    struct in_addr *addr = arg;
+    TEST_CHECK(dns_cache_lookup("shared.test", addr, portMAX_DELAY) == ESP_OK);
+    return NULL;
+}
+
+/* Callers arriving while a name is being resolved wait for that query */
+static void test_shared(void) {
+    enum { CALLERS = 4 };
+    pthread_t threads[CALLERS];
+    struct in_addr addrs[CALLERS];
+    dns_cache_stats_t before = stats();
+    int calls = resolver_calls();
+    resolver_set(false, 0, 200);
+    for (int i = 0; i < CALLERS; i++) {
+        pthread_create(&threads[i], NULL, shared_lookup, &addrs[i]);
+        /* The first caller is inside the resolver before the rest arrive */
+        if (i == 0) {
+            usleep(50000);
+        }
+    }
+    for (int i = 0; i < CALLERS; i++) {
+        pthread_join(threads[i], NULL);
+        TEST_CHECK(addrs[i].s_addr == addrs[0].s_addr);
+    }
+    TEST_CHECK(resolver_calls() == calls + 1);
+    TEST_CHECK(stats().misses == before.misses + 1);
+    TEST_CHECK(stats().shared == before.shared + CALLERS - 1);
+
+    /* A waiter gives up after its own timeout, the query carries on */
+    resolver_set(false, 0, 300);
+    pthread_t slow;
+    struct in_addr addr;
+    host_timer_advance(SECONDS(MAX_STALE_S + DEFAULT_TTL_S));
+    pthread_create(&slow, NULL, shared_lookup, &addr);
+    usleep(50000);
+    struct in_addr waited;
+    TEST_CHECK(dns_cache_lookup("shared.test", &waited, pdMS_TO_TICKS(50)) == ESP_ERR_TIMEOUT);
+    pthread_join(slow, NULL);
+    TEST_CHECK(addr.s_addr != addrs[0].s_addr);
+    resolver_set(false, 0, 0);
+}
+
+/* A full cache evicts the entry used longest ago */
+static void test_evict(void) {
+    char host[16];
+    uint32_t addrs[DNS_CACHE_MAX_ENTRIES];
+    for (int i = 0; i < DNS_CACHE_MAX_ENTRIES; i++) {
+        snprintf(host, sizeof(host), "h%d.test", i);
+        addrs[i] = lookup(host);
+        host_timer_advance(1);
+    }
+    /* h0 is used again, so h1 is the oldest when h8 comes in */
+    TEST_CHECK(lookup("h0.test") == addrs[0]);
+    host_timer_advance(1);
+    lookup("h8.test");
+    int calls = resolver_calls();
+    TEST_CHECK(lookup("h0.test") == addrs[0]);
+    for (int i = 2; i < DNS_CACHE_MAX_ENTRIES; i++) {
+        snprintf(host, sizeof(host), "h%d.test", i);
+        TEST_CHECK(lookup(host) == addrs[i]);
+    }
+    TEST_CHECK(resolver_calls() == calls);
+    TEST_CHECK(lookup("h1.test") != addrs[1]);
+    TEST_CHECK(resolver_calls() == calls + 1);
+}
+
+static void test_args(void) {
+    char host[DNS_CACHE_HOST_MAX + 1];
+    memset(host, 'a', sizeof(host) - 1);
+    host[sizeof(host) - 1] = 0;
+    struct in_addr addr;
+    TEST_CHECK(dns_cache_lookup(host, &addr, 0) == ESP_ERR_INVALID_ARG);
+    TEST_CHECK(dns_cache_lookup(NULL, &addr, 0) == ESP_ERR_INVALID_ARG);
+    TEST_CHECK(dns_cache_lookup("args.test", NULL, 0) == ESP_ERR_INVALID_ARG);
+}
+
+int main(void) {
+    struct in_addr addr;
+    TEST_CHECK(dns_cache_lookup("early.test", &addr, 0) == ESP_ERR_INVALID_STATE);
+    dns_cache_config_t config = DNS_CACHE_CONFIG_DEFAULT();
+    config.resolver = resolve;
+    TEST_CHECK(config.default_ttl_s == DEFAULT_TTL_S && config.min_ttl_s == MIN_TTL_S &&
+               config.max_stale_s == MAX_STALE_S);
+    TEST_CHECK(dns_cache_init(&config) == ESP_OK);
+    TEST_CHECK(dns_cache_init(&config) == ESP_ERR_INVALID_STATE);
+
+    test_hit();
+    test_stale_refresh();
+    test_outage();
+    test_ttl();
+    test_shared();
+    test_evict();
+    test_args();
+    printf("dns_cache: ok\n");
+    return 0;
+}
@@ -0,0 +1,291 @@
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "lwip/sockets.h"
+#include "test_util.h"
+#include "stand_in_server.h"
+#include "host_rtos.h"
+#include "dns_cache.h"
+#include "http_iot.h"
+
+/* Drives http_iot against the stand-in server on loopback, whose modes
+ * drop a kept connection, reset it or sit on a request. */
+
+#define HOST            "stand-in.test"
+#define TIMEOUT_MS      300
+
+static const char *s_port;
+
+static esp_err_t resolve(const char *host, struct in_addr *addr, uint32_t *ttl_s, void *ctx) {
+    TEST_CHECK(strcmp(host, HOST) == 0);
+    addr->s_addr = htonl(INADDR_LOOPBACK);
+    return ESP_OK;
+}
+
+typedef struct {
+    char data[256];
+    size_t len;
+} body_t;
+
+static void body_append(const uint8_t *data, size_t len, void *ctx) {
+    body_t *body = ctx;
+    TEST_CHECK(body->len + len < sizeof(body->data));
+    memcpy(body->data + body->len, data, len);
+    body->len += len;
+    body->data[body->len] = 0;
+}
+
+static const char s_request[] = "POST /update HTTP/1.1\r\nHost: " HOST "\r\nContent-Length: 0\r\n\r\n";
+
+static esp_err_t request(http_iot_handle_t http, int *status, body_t *body) {
+    body->len = 0;
+    body->data[0] = 0;
+    return http_iot_request(http, s_request, sizeof(s_request) - 1, status, body_append, body);
+}
+
+static http_iot_stats_t stats_of(http_iot_handle_t http) {
+    http_iot_stats_t stats;
+    http_iot_get_stats(http, &stats);
+    return stats;
+}
+
+static void test_keep_alive(http_iot_handle_t http) {
+    int status = 0;
+    body_t body;
+    server_set_mode(SERVER_OK);
+    for (int i = 0; i < 5; i++) {
+        TEST_CHECK(request(http, &status, &body) == ESP_OK);
+        TEST_CHECK(status == 200 && strcmp(body.data, "ok") == 0);
+    }
+    http_iot_stats_t stats = stats_of(http);
+    TEST_CHECK(stats.connects == 1 && stats.reused == 4 && stats.retries == 0);
+    TEST_CHECK(server_requests() == 5);
+}
+
+/* A kept connection the server has dropped is found dead before the
+ * request goes out, which then goes out once, on a new one */
+static void test_stale(http_iot_handle_t http, server_mode_t drop) {
+    int status = 0;
+    body_t body;
+    http_iot_stats_t before = stats_of(http);
+    int requests = server_requests();
+    server_set_mode(drop);
+    TEST_CHECK(request(http, &status, &body) == ESP_OK && status == 200);
+    /* Let the FIN or RST land before the next request */
+    usleep(50000);
+    server_set_mode(SERVER_OK);
+    TEST_CHECK(request(http, &status, &body) == ESP_OK);
+    TEST_CHECK(status == 200 && strcmp(body.data, "ok") == 0);
+    http_iot_stats_t after = stats_of(http);
+    TEST_CHECK(after.dropped == before.dropped + 1);
+    TEST_CHECK(after.retries == before.retries);
+    TEST_CHECK(after.connects == before.connects + 1);
+    TEST_CHECK(after.errors == before.errors);
+    TEST_CHECK(server_requests() == requests + 2);
+}
+
+/* The connection dies with the request already out: the server may have
+ * acted on it, so a POST fails rather than risk a duplicate and only an
+ * idempotent request is sent again */
+static void test_unanswered(http_iot_handle_t http) {
+    static const char get[] = "GET /channels/1/feeds.json HTTP/1.1\r\nHost: " HOST "\r\n\r\n";
+    int status = 0;
+    body_t body;
+    server_set_mode(SERVER_OK);
+    TEST_CHECK(request(http, &status, &body) == ESP_OK);
+    http_iot_stats_t before = stats_of(http);
+    int requests = server_requests();
+
+    server_set_mode(SERVER_CLOSE_UNANSWERED);
+    TEST_CHECK(request(http, &status, &body) == ESP_FAIL);
+    usleep(50000);
+    TEST_CHECK(server_requests() == requests + 1);
+    http_iot_stats_t after = stats_of(http);
+    TEST_CHECK(after.retries == before.retries && after.errors == before.errors + 1);
+
+    TEST_CHECK(request(http, &status, &body) == ESP_OK);
+    server_set_mode(SERVER_CLOSE_UNANSWERED);
+    TEST_CHECK(http_iot_request(http, get, sizeof(get) - 1, &status, NULL, NULL) == ESP_OK && status == 200);
+    TEST_CHECK(server_requests() == requests + 4);
+    TEST_CHECK(stats_of(http).retries == after.retries + 1);
+}
+
+/* The server has the request and is slow to answer: a timeout must not be
+ * taken for a stale connection, the request is not sent a second time */
+static void test_timeout(http_iot_handle_t http) {
+    int status = 0;
+    body_t body;
+    server_set_mode(SERVER_OK);
+    TEST_CHECK(request(http, &status, &body) == ESP_OK);
+    http_iot_stats_t before = stats_of(http);
+    int requests = server_requests();
+
+    server_set_mode(SERVER_SILENT);
+    int64_t start = test_now_ns();
+    TEST_CHECK(request(http, &status, &body) == ESP_FAIL);
+    int64_t elapsed_ms = (test_now_ns() - start) / 1000000;
+    TEST_CHECK(elapsed_ms >= TIMEOUT_MS - 10 && elapsed_ms < 2 * TIMEOUT_MS);
+    /* Anything resent would show up here */
+    usleep(100000);
+    TEST_CHECK(server_requests() == requests + 1);
+    http_iot_stats_t after = stats_of(http);
+    TEST_CHECK(after.reused == before.reused + 1);
+    TEST_CHECK(after.retries == before.retries);
+    TEST_CHECK(after.errors == before.errors + 1);
+
+    /* The timed out connection is not reused */
+    server_set_mode(SERVER_OK);
+    TEST_CHECK(request(http, &status, &body) == ESP_OK && status == 200);
+    TEST_CHECK(stats_of(http).connects == after.connects + 1);
+}
+
+static void test_bodies(http_iot_handle_t http) {
+    int status = 0;
+    body_t body;
+    server_set_mode(SERVER_CHUNKED);
+    TEST_CHECK(request(http, &status, &body) == ESP_OK);
+    TEST_CHECK(status == 201 && strcmp(body.data, "hello world") == 0);
+
+    /* A body that runs to the close ends the connection too */
+    http_iot_stats_t before = stats_of(http);
+    server_set_mode(SERVER_UNTIL_CLOSE);
+    TEST_CHECK(request(http, &status, &body) == ESP_OK);
+    TEST_CHECK(status == 200 && strcmp(body.data, "until the end") == 0);
+    server_set_mode(SERVER_OK);
+    TEST_CHECK(request(http, &status, &body) == ESP_OK);
+    http_iot_stats_t after = stats_of(http);
+    TEST_CHECK(after.connects == before.connects + 1 && after.retries == before.retries);
+}
+
+/* Header and body gathered from separate pieces arrive as one request */
+static void test_gather(http_iot_handle_t http) {
+    static const char header[] = "POST /bulk HTTP/1.1\r\nHost: " HOST "\r\nContent-Length: 11\r\n\r\n";
+    static const char body1[] = "field1";
+    static const char body2[] = "=42&x";
+    const struct iovec iov[] = {
+        { .iov_base = (void *) header, .iov_len = sizeof(header) - 1 },
+        { .iov_base = (void *) body1, .iov_len = sizeof(body1) - 1 },
+        { .iov_base = (void *) body2, .iov_len = sizeof(body2) - 1 },
+    };
+    int status = 0;
+    server_set_mode(SERVER_OK);
+    TEST_CHECK(http_iot_requestv(http, iov, 3, &status, NULL, NULL) == ESP_OK && status == 200);
+    char last[256];
+    TEST_CHECK(server_last(last, sizeof(last)) == sizeof(header) - 1 + 11);
+    TEST_CHECK(memcmp(last, header, sizeof(header) - 1) == 0);
+    TEST_CHECK(memcmp(last + sizeof(header) - 1, "field1=42&x", 11) == 0);
+    TEST_CHECK(http_iot_requestv(http, iov, 0, &status, NULL, NULL) == ESP_ERR_INVALID_ARG);
+    TEST_CHECK(http_iot_requestv(http, iov, HTTP_IOT_IOV_MAX + 1, &status, NULL, NULL) == ESP_ERR_INVALID_ARG);
+}
+
+/* A connection idle past idle_timeout_ms is replaced before use, not tried */
+static void test_idle(void) {
+    http_iot_config_t config = HTTP_IOT_CONFIG_DEFAULT(HOST, s_port);
+    config.timeout_ms = TIMEOUT_MS;
+    config.idle_timeout_ms = 1000;
+    http_iot_handle_t http;
+    TEST_CHECK(http_iot_create(&config, &http) == ESP_OK);
+    int status = 0;
+    body_t body;
+    server_set_mode(SERVER_OK);
+    TEST_CHECK(request(http, &status, &body) == ESP_OK);
+    TEST_CHECK(request(http, &status, &body) == ESP_OK);
+    host_timer_advance(2000000);
+    TEST_CHECK(request(http, &status, &body) == ESP_OK);
+    http_iot_stats_t stats = stats_of(http);
+    TEST_CHECK(stats.connects == 2 && stats.reused == 1 && stats.retries == 0);
+    http_iot_delete(http);
+}
+
+/* The sanitizers abort on an allocation this size unless told to fail it like malloc would */
+const char *__asan_default_options(void) {
+    return "allocator_may_return_null=1";
+}
+
+const char *__tsan_default_options(void) {
+    return "allocator_may_return_null=1";
+}
+
+/* A create that fails part way must not close descriptor 0 on its way out */
+static void test_create_fail(void) {
+    int fds[2];
+    TEST_CHECK(pipe(fds) == 0);
+    int saved = dup(0);
+    TEST_CHECK(dup2(fds[0], 0) == 0);
+    http_iot_config_t config = HTTP_IOT_CONFIG_DEFAULT(HOST, s_port);
+    config.rx_buffer_size = SIZE_MAX;
+    http_iot_handle_t http;
+    TEST_CHECK(http_iot_create(&config, &http) == ESP_ERR_NO_MEM);
+    TEST_CHECK(fcntl(0, F_GETFD) != -1);
+    dup2(saved, 0);
+    close(saved);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static int compare_ns(const void *a, const void *b) {
+    int64_t x = *(const int64_t *) a, y = *(const int64_t *) b;
+    return x < y ? -1 : x > y;
+}
+
+/* Requests/s and latency with the connection kept, against closing it
+ * after every request the way the app used to. Loopback has no round trip
+ * to speak of, so on a real link the handshake saved is worth far more. */
+static void bench(http_iot_handle_t http, bool keep_alive) {
+    enum { N = 2000 };
+    static int64_t latency[N];
+    int status = 0;
+    body_t body;
+    server_set_mode(SERVER_OK);
+    /* Starts from an open connection */
+    TEST_CHECK(request(http, &status, &body) == ESP_OK);
+    http_iot_stats_t before = stats_of(http);
+    int64_t start = test_now_ns();
+    for (int i = 0; i < N; i++) {
+        int64_t t = test_now_ns();
+        if (!keep_alive) {
+            http_iot_close(http);
+        }
+        TEST_CHECK(request(http, &status, &body) == ESP_OK && status == 200);
+        latency[i] = test_now_ns() - t;
+    }
+    double seconds = (test_now_ns() - start) / 1e9;
+    http_iot_stats_t after = stats_of(http);
+    TEST_CHECK(after.connects - before.connects == (keep_alive ? 0 : N));
+    qsort(latency, N, sizeof(latency[0]), compare_ns);
+    printf("%s: %.0f requests/s, latency mean %.1f us, p50 %.1f us, p99 %.1f us\n",
+           keep_alive ? "kept connection" : "connect per request", N / seconds, seconds / N * 1e6,
+           latency[N / 2] / 1e3, latency[N * 99 / 100] / 1e3);
+}
+
+int main(void) {
+    /* lwIP has no SIGPIPE, a write to a reset connection just fails */
+    signal(SIGPIPE, SIG_IGN);
+    s_port = server_start();
+    dns_cache_config_t dns_config = DNS_CACHE_CONFIG_DEFAULT();
+    dns_config.resolver = resolve;
+    TEST_CHECK(dns_cache_init(&dns_config) == ESP_OK);
+
+    http_iot_config_t config = HTTP_IOT_CONFIG_DEFAULT(HOST, s_port);
+    config.timeout_ms = TIMEOUT_MS;
+    config.idle_timeout_ms = 0;
+    http_iot_handle_t http;
+    TEST_CHECK(http_iot_create(&config, &http) == ESP_OK);
+
+    test_keep_alive(http);
+    test_stale(http, SERVER_OK_CLOSE);
+    test_stale(http, SERVER_OK_RESET);
+    test_unanswered(http);
+    test_timeout(http);
+    test_bodies(http);
+    test_gather(http);
+    bench(http, false);
+    bench(http, true);
+    http_iot_delete(http);
+    test_idle();
+    test_create_fail();
+
+    printf("http_iot: ok\n");
+    return 0;
+}
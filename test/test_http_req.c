@@ -0,0 +1,205 @@
+#include <string.h>
+#include "test_util.h"
+#include "http_req.h"
+
+/* Checks the rendered numbers against snprintf over edge values and a
+ * random sweep, the scatter list bookkeeping and both overflow limits,
+ * then times the builder against the snprintf it replaced. */
+
+static uint32_t rand32(uint32_t *state) {
+    /* xorshift32, reproducible across runs */
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+/* The request as it would go out on the wire */
+static size_t flatten(const http_req_t *req, char *out, size_t size) {
+    size_t len = 0;
+    for (int i = 0; i < req->count; i++) {
+        TEST_CHECK(len + req->iov[i].iov_len < size);
+        memcpy(out + len, req->iov[i].iov_base, req->iov[i].iov_len);
+        len += req->iov[i].iov_len;
+    }
+    out[len] = 0;
+    TEST_CHECK(len == req->len);
+    return len;
+}
+
+/* Same format as http_req_fixed, in the obvious way */
+static void reference_fixed(char *out, size_t size, int32_t value, uint8_t decimals) {
+    uint32_t magnitude = value < 0 ? 0u - (uint32_t) value : (uint32_t) value;
+    uint32_t scale = 1;
+    for (int i = 0; i < decimals; i++) {
+        scale *= 10;
+    }
+    if (decimals) {
+        snprintf(out, size, "%s%u.%0*u", value < 0 ? "-" : "", magnitude / scale, decimals, magnitude % scale);
+    } else {
+        snprintf(out, size, "%d", value);
+    }
+}
+
+static void check_uint(uint32_t value) {
+    char buf[16], out[32], expect[32];
+    http_req_t req;
+    http_req_init(&req, buf, sizeof(buf));
+    TEST_CHECK(http_req_uint(&req, value));
+    flatten(&req, out, sizeof(out));
+    snprintf(expect, sizeof(expect), "%u", value);
+    TEST_CHECK(strcmp(out, expect) == 0);
+}
+
+static void check_int(int32_t value) {
+    char buf[16], out[32], expect[32];
+    http_req_t req;
+    http_req_init(&req, buf, sizeof(buf));
+    TEST_CHECK(http_req_int(&req, value));
+    flatten(&req, out, sizeof(out));
+    snprintf(expect, sizeof(expect), "%d", value);
+    TEST_CHECK(strcmp(out, expect) == 0);
+}
+
+static void check_fixed(int32_t value, uint8_t decimals) {
+    char buf[32], out[48], expect[48];
+    http_req_t req;
+    http_req_init(&req, buf, sizeof(buf));
+    TEST_CHECK(http_req_fixed(&req, value, decimals));
+    flatten(&req, out, sizeof(out));
+    reference_fixed(expect, sizeof(expect), value, decimals);
+    TEST_CHECK(strcmp(out, expect) == 0);
+}
+
+static void test_numbers(void) {
+    static const uint32_t uints[] = { 0, 9, 10, 99, 100, 999, 1000, 12345, 99999999, 100000000, 4294967295u };
+    for (size_t i = 0; i < sizeof(uints) / sizeof(uints[0]); i++) {
+        check_uint(uints[i]);
+    }
+    static const int32_t ints[] = { 0, 1, -1, 9, -10, 100, -999, INT32_MIN, INT32_MAX, INT32_MIN + 1 };
+    for (size_t i = 0; i < sizeof(ints) / sizeof(ints[0]); i++) {
+        check_int(ints[i]);
+        for (uint8_t d = 0; d <= 9; d++) {
+            check_fixed(ints[i], d);
+        }
+    }
+
+    char buf[16], out[32];
+    http_req_t req;
+    http_req_init(&req, buf, sizeof(buf));
+    http_req_fixed(&req, 2050, 2);
+    flatten(&req, out, sizeof(out));
+    TEST_CHECK(strcmp(out, "20.50") == 0);
+    http_req_init(&req, buf, sizeof(buf));
+    http_req_fixed(&req, -5, 2);
+    flatten(&req, out, sizeof(out));
+    TEST_CHECK(strcmp(out, "-0.05") == 0);
+
+    uint32_t seed = 0x2468ace1;
+    for (int i = 0; i < 200000; i++) {
+        /* Spread over every length, not just the long ones */
+        uint32_t value = rand32(&seed) >> (rand32(&seed) % 32);
+        check_uint(value);
+        check_int((int32_t) value);
+        check_fixed((int32_t) rand32(&seed) >> (rand32(&seed) % 32), rand32(&seed) % 10);
+    }
+}
+
+static void test_list(void) {
+    char buf[64], out[256];
+    http_req_t req;
+
+    /* Template text is referenced in place, numbers rendered back to back share an entry */
+    static const char head[] = "GET /update?field1=";
+    http_req_init(&req, buf, sizeof(buf));
+    TEST_CHECK(http_req_static(&req, head));
+    TEST_CHECK(req.iov[0].iov_base == head);
+    http_req_uint(&req, 1);
+    http_req_int(&req, -2);
+    http_req_static(&req, "&field2=");
+    http_req_fixed(&req, 305, 1);
+    http_req_static(&req, "");
+    TEST_CHECK(req.count == 4 && !req.overflow);
+    flatten(&req, out, sizeof(out));
+    TEST_CHECK(strcmp(out, "GET /update?field1=1-2&field2=30.5") == 0);
+
+    /* Out of buffer: the number is refused and so is everything after it */
+    http_req_init(&req, buf, 4);
+    TEST_CHECK(http_req_uint(&req, 123));
+    TEST_CHECK(!http_req_uint(&req, 45));
+    TEST_CHECK(req.overflow);
+    TEST_CHECK(!http_req_static(&req, "x"));
+    flatten(&req, out, sizeof(out));
+    TEST_CHECK(strcmp(out, "123") == 0);
+
+    /* Out of list entries */
+    http_req_init(&req, buf, sizeof(buf));
+    for (int i = 0; i < HTTP_IOT_IOV_MAX; i++) {
+        TEST_CHECK(http_req_static(&req, "x"));
+    }
+    TEST_CHECK(!http_req_static(&req, "y") && req.overflow);
+    TEST_CHECK(!http_req_uint(&req, 1));
+    TEST_CHECK(req.count == HTTP_IOT_IOV_MAX && req.len == HTTP_IOT_IOV_MAX);
+
+    http_req_init(&req, buf, sizeof(buf));
+    TEST_CHECK(!http_req_fixed(&req, 1, 10) && req.overflow);
+}
+
+static void test_bench(void) {
+    enum { N = 1000000 };
+    static const char head[] = "POST /channels/1/bulk_update.json HTTP/1.1\r\nHost: api.thingspeak.com\r\n"
+                               "Content-Type: application/json\r\nContent-Length: ";
+    static const char body[] = "{\"write_api_key\":\"KEY\",\"updates\":[]}";
+    volatile size_t sink = 0;
+    http_req_t req;
+
+    int64_t start = test_now_ns();
+    for (int i = 0; i < N; i++) {
+        char numbers[16];
+        http_req_init(&req, numbers, sizeof(numbers));
+        http_req_static(&req, head);
+        http_req_uint(&req, 1500 + (i & 511));
+        http_req_static(&req, "\r\n\r\n");
+        http_req_ref(&req, body, sizeof(body) - 1);
+        sink += req.len;
+    }
+    double builder = (test_now_ns() - start) / 1e9;
+    start = test_now_ns();
+    for (int i = 0; i < N; i++) {
+        char request[256];
+        sink += snprintf(request, sizeof(request), "POST /channels/%d/bulk_update.json HTTP/1.1\r\n"
+                         "Host: api.thingspeak.com\r\nContent-Type: application/json\r\n"
+                         "Content-Length: %u\r\n\r\n%s", 1, 1500 + (i & 511), body);
+    }
+    double formatted = (test_now_ns() - start) / 1e9;
+    printf("bulk request: builder %.1f M/s, snprintf %.1f M/s\n", N / builder / 1e6, N / formatted / 1e6);
+
+    start = test_now_ns();
+    for (int i = 0; i < N; i++) {
+        char numbers[32];
+        http_req_init(&req, numbers, sizeof(numbers));
+        http_req_static(&req, "GET /update?api_key=KEY&field1=");
+        http_req_fixed(&req, 2000 + (i & 63), 2);
+        http_req_static(&req, "&field2=");
+        http_req_fixed(&req, 8000 - (i & 63), 2);
+        http_req_static(&req, " HTTP/1.1\r\nHost: api.thingspeak.com\r\n\r\n");
+        sink += req.len;
+    }
+    builder = (test_now_ns() - start) / 1e9;
+    start = test_now_ns();
+    for (int i = 0; i < N; i++) {
+        char request[256];
+        sink += snprintf(request, sizeof(request), "GET /update?api_key=KEY&field1=%.2f&field2=%.2f HTTP/1.1\r\n"
+                         "Host: api.thingspeak.com\r\n\r\n", (2000 + (i & 63)) / 100.0, (8000 - (i & 63)) / 100.0);
+    }
+    formatted = (test_now_ns() - start) / 1e9;
+    printf("two field update: builder %.1f M/s, snprintf %.1f M/s\n", N / builder / 1e6, N / formatted / 1e6);
+}
+
+int main(void) {
+    test_numbers();
+    test_list();
+    test_bench();
+    printf("http_req: ok\n");
+    return 0;
+}
@@ -0,0 +1,263 @@
+#include <string.h>
+#include "test_util.h"
+#include "http_resp.h"
+
+/* Feeds known responses through the parser split at every position, one
+ * byte at a time and in random pieces, and every result has to match the
+ * whole-buffer parse. Malformed input must end in HTTP_RESP_ERROR, and
+ * mutated input must never run the parser out of its buffers. */
+
+typedef struct {
+    const char *raw;
+    int status;
+    const char *body;
+    bool keep_alive;
+    bool until_close;           /* Body ends with the connection */
+} response_case_t;
+
+static const response_case_t s_cases[] = {
+    { "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nhello", 200, "hello", true, false },
+    { "HTTP/1.1 202 Accepted\r\nTransfer-Encoding: chunked\r\n\r\n"
+      "5;ext=1\r\nhello\r\nA\r\n0123456789\r\n0\r\nX-Trailer: y\r\n\r\n", 202, "hello0123456789", true, false },
+    { "HTTP/1.1 100 Continue\r\n\r\n"
+      "HTTP/1.1 201 Created\r\ncontent-length: 2\r\nConnection: close\r\n\r\nok", 201, "ok", false, false },
+    { "HTTP/1.0 200 OK\r\n\r\nuntil close", 200, "until close", false, true },
+    { "HTTP/1.0 200 OK\r\nConnection: keep-alive\r\nContent-Length: 0\r\n\r\n", 200, "", true, false },
+    { "HTTP/1.1 204 No Content\r\n\r\n", 204, "", true, false },
+    /* Bare LF line ends, and a header longer than the line buffer that isn't needed */
+    { "HTTP/1.1 200 OK\nContent-Length: 3\nX-Long: "
+      "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"
+      "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa\n\nabc",
+      200, "abc", true, false },
+    { "HTTP/1.1 200 OK\r\nTransfer-Encoding: gzip, chunked\r\n\r\n3\r\nabc\r\n0\r\n\r\n", 200, "abc", true, false },
+};
+
+static const char *s_malformed[] = {
+    "HTTP/2 200\r\n\r\n",
+    "HTTP/1.1 2x0 OK\r\n\r\n",
+    "HTTP/1.1 200 OK\r\nContent-Length: 1x\r\n\r\n",
+    "HTTP/1.1 200 OK\r\nContent-Length: 3\r\nContent-Length: 4\r\n\r\n",
+    "HTTP/1.1 200 OK\r\nContent-Length: 99999999999\r\n\r\n",
+    "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n",
+    "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n2\r\nabX\r\n",
+    "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\nfffffffff\r\n",
+};
+
+typedef struct {
+    char data[1024];
+    size_t len;
+} body_t;
+
+static void body_append(const uint8_t *data, size_t len, void *ctx) {
+    body_t *body = ctx;
+    TEST_CHECK(body->len + len <= sizeof(body->data));
+    memcpy(body->data + body->len, data, len);
+    body->len += len;
+}
+
+static uint32_t rand32(uint32_t *state) {
+    /* xorshift32, reproducible across runs */
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+/* Feeds raw in the pieces sizes[] describes, the last piece repeats. Every
+ * byte has to be taken until the response is complete. */
+static void parse(http_resp_t *resp, body_t *body, const char *raw, size_t len, const size_t *sizes, size_t count) {
+    http_resp_init(resp, NULL, body_append, body);
+    body->len = 0;
+    size_t off = 0;
+    for (size_t i = 0; off < len && resp->state != HTTP_RESP_DONE && resp->state != HTTP_RESP_ERROR; i++) {
+        size_t n = sizes[i < count ? i : count - 1];
+        if (n > len - off) {
+            n = len - off;
+        }
+        size_t used = http_resp_feed(resp, (const uint8_t *) raw + off, n);
+        TEST_CHECK(used == n || resp->state == HTTP_RESP_DONE);
+        off += used;
+    }
+}
+
+static void check_case(const response_case_t *c, http_resp_t *resp, const body_t *body) {
+    if (c->until_close) {
+        TEST_CHECK(resp->state == HTTP_RESP_BODY_EOF);
+        TEST_CHECK(http_resp_finish(resp));
+    }
+    TEST_CHECK(resp->state == HTTP_RESP_DONE);
+    TEST_CHECK(resp->status == c->status);
+    TEST_CHECK(resp->keep_alive == c->keep_alive);
+    TEST_CHECK(body->len == strlen(c->body) && memcmp(body->data, c->body, body->len) == 0);
+}
+
+static void test_splits(void) {
+    uint32_t seed = 0x12345678;
+    http_resp_t resp;
+    body_t body;
+    for (size_t i = 0; i < sizeof(s_cases) / sizeof(s_cases[0]); i++) {
+        const response_case_t *c = &s_cases[i];
+        size_t len = strlen(c->raw);
+
+        size_t whole = len;
+        parse(&resp, &body, c->raw, len, &whole, 1);
+        check_case(c, &resp, &body);
+
+        size_t one = 1;
+        parse(&resp, &body, c->raw, len, &one, 1);
+        check_case(c, &resp, &body);
+
+        /* Every two-piece split */
+        for (size_t k = 1; k < len; k++) {
+            size_t sizes[] = { k, len - k };
+            parse(&resp, &body, c->raw, len, sizes, 2);
+            check_case(c, &resp, &body);
+        }
+
+        for (int run = 0; run < 500; run++) {
+            size_t sizes[64];
+            for (size_t s = 0; s < 64; s++) {
+                sizes[s] = 1 + rand32(&seed) % 17;
+            }
+            parse(&resp, &body, c->raw, len, sizes, 64);
+            check_case(c, &resp, &body);
+        }
+    }
+}
+
+static void test_malformed(void) {
+    http_resp_t resp;
+    body_t body;
+    size_t one = 1;
+    for (size_t i = 0; i < sizeof(s_malformed) / sizeof(s_malformed[0]); i++) {
+        parse(&resp, &body, s_malformed[i], strlen(s_malformed[i]), &one, 1);
+        TEST_CHECK(resp.state == HTTP_RESP_ERROR);
+    }
+
+    /* A connection that ends mid chunk or mid body is not a complete response */
+    const char *raw = s_cases[1].raw;
+    size_t len = strlen(raw) - 3;
+    parse(&resp, &body, raw, len, &len, 1);
+    TEST_CHECK(!http_resp_finish(&resp) && resp.state == HTTP_RESP_ERROR);
+    raw = s_cases[0].raw;
+    len = strlen(raw) - 1;
+    parse(&resp, &body, raw, len, &len, 1);
+    TEST_CHECK(!http_resp_finish(&resp));
+}
+
+/* The parser stops at the end of a response, what follows is left alone */
+static void test_pipelined(void) {
+    static const char raw[] = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nokHTTP/1.1";
+    http_resp_t resp;
+    body_t body = { .len = 0 };
+    http_resp_init(&resp, NULL, body_append, &body);
+    size_t used = http_resp_feed(&resp, (const uint8_t *) raw, sizeof(raw) - 1);
+    TEST_CHECK(used == sizeof(raw) - 1 - 8);
+    TEST_CHECK(resp.state == HTTP_RESP_DONE && body.len == 2);
+}
+
+static int s_headers;
+
+static void header_seen(const char *name, const char *value, void *ctx) {
+    if (strcmp(name, "Content-Type") == 0) {
+        TEST_CHECK(strcmp(value, "text/plain; charset=utf-8") == 0);
+    }
+    s_headers++;
+}
+
+static void test_headers(void) {
+    static const char raw[] = "HTTP/1.1 200 OK\r\nContent-Type:  text/plain; charset=utf-8 \t\r\n"
+                              "Content-Length: 0\r\n\r\n";
+    http_resp_t resp;
+    http_resp_init(&resp, header_seen, NULL, NULL);
+    http_resp_feed(&resp, (const uint8_t *) raw, sizeof(raw) - 1);
+    TEST_CHECK(resp.state == HTTP_RESP_DONE && s_headers == 2);
+}
+
+/* Mutated responses in random pieces: any outcome is fine as long as
+ * nothing overruns, which the sanitizers or the body bound would catch */
+static void test_fuzz(void) {
+    uint32_t seed = 0x9abcdef1;
+    uint8_t buf[512];
+    http_resp_t resp;
+    body_t body;
+    size_t count = sizeof(s_cases) / sizeof(s_cases[0]);
+    for (int run = 0; run < 200000; run++) {
+        const char *raw = s_cases[run % count].raw;
+        size_t len = strlen(raw);
+        memcpy(buf, raw, len);
+        for (int m = rand32(&seed) % 6; m >= 0; m--) {
+            buf[rand32(&seed) % len] = rand32(&seed);
+        }
+        http_resp_init(&resp, NULL, body_append, &body);
+        body.len = 0;
+        for (size_t off = 0; off < len && resp.state != HTTP_RESP_DONE && resp.state != HTTP_RESP_ERROR;) {
+            size_t n = 1 + rand32(&seed) % 40;
+            if (n > len - off) {
+                n = len - off;
+            }
+            size_t used = http_resp_feed(&resp, buf + off, n);
+            TEST_CHECK(used <= n);
+            off += used;
+        }
+        TEST_CHECK(body.len <= len);
+        TEST_CHECK(resp.line_len < HTTP_RESP_LINE_MAX);
+    }
+}
+
+/* Throughput over 1 KB reads, the socket read size http_iot uses by default.
+ * Body bytes go out as slices of the input, so a Content-Length body costs
+ * per read rather than per byte and the chunked figure is the one to watch. */
+static void bench(const char *name, const uint8_t *data, size_t len) {
+    http_resp_t resp;
+    int reps = 50;
+    int64_t start = test_now_ns();
+    for (int r = 0; r < reps; r++) {
+        http_resp_init(&resp, NULL, NULL, NULL);
+        for (size_t off = 0; off < len; off += 1024) {
+            http_resp_feed(&resp, data + off, len - off < 1024 ? len - off : 1024);
+        }
+        TEST_CHECK(resp.state == HTTP_RESP_DONE);
+    }
+    double s = (test_now_ns() - start) / 1e9;
+    printf("%s: %.0f MB/s\n", name, reps * len / s / 1e6);
+}
+
+static void test_bench(void) {
+    enum { SIZE = 1 << 20 };
+    static uint8_t data[SIZE];
+    size_t len = sprintf((char *) data, "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+                         "Content-Length: %d\r\n\r\n", SIZE - 100);
+    bench("content-length", data, len + SIZE - 100);
+
+    len = sprintf((char *) data, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n");
+    while (len < SIZE - 600) {
+        len += sprintf((char *) data + len, "200\r\n");
+        memset(data + len, 'x', 512);
+        len += 512;
+        len += sprintf((char *) data + len, "\r\n");
+    }
+    len += sprintf((char *) data + len, "0\r\n\r\n");
+    bench("chunked 512 B", data, len);
+
+    const char *raw = s_cases[0].raw;
+    size_t raw_len = strlen(raw);
+    http_resp_t resp;
+    int64_t start = test_now_ns();
+    for (int r = 0; r < 1000000; r++) {
+        http_resp_init(&resp, NULL, NULL, NULL);
+        http_resp_feed(&resp, (const uint8_t *) raw, raw_len);
+    }
+    printf("small responses: %.1f M/s\n", 1e6 / ((test_now_ns() - start) / 1e9) / 1e6);
+}
+
+int main(void) {
+    test_splits();
+    test_malformed();
+    test_pipelined();
+    test_headers();
+    test_fuzz();
+    test_bench();
+    printf("http_resp: ok\n");
+    return 0;
+}
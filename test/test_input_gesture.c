@@ -0,0 +1,151 @@
+#include <string.h>
+#include "test_util.h"
+#include "input_gesture.h"
+
+/* Replays edge traces through the gesture engine the way input_iot drives it:
+ * poll up to each edge, feed it, then keep polling until the trace is over. */
+
+static const input_gesture_class_t classes[] = {
+    { 1000000, INPUT_GESTURE_SHORT },
+    { 3000000, INPUT_GESTURE_NORMAL },
+    { 5000000, INPUT_GESTURE_LONG },
+};
+
+static const input_gesture_config_t config = {
+    .active_level = 0,
+    .debounce_us = 20000,
+    .classes = classes,
+    .class_count = sizeof(classes) / sizeof(classes[0]),
+    .double_click_us = 300000,
+    .hold_start_us = 7000000,
+    .hold_repeat_us = 0,
+};
+
+/* Same, with the hold repeating every second while the button stays down */
+static const input_gesture_config_t repeat_config = {
+    .active_level = 0,
+    .debounce_us = 20000,
+    .classes = classes,
+    .class_count = sizeof(classes) / sizeof(classes[0]),
+    .double_click_us = 300000,
+    .hold_start_us = 7000000,
+    .hold_repeat_us = 1000000,
+};
+
+#define EVENTS_MAX  8
+
+typedef struct {
+    const char *name;
+    int64_t edges[8];           /* Alternating press / release, starting released */
+    size_t edge_count;
+    int64_t end_us;
+    input_gesture_event_t expect[EVENTS_MAX];
+    const input_gesture_config_t *config;      /* NULL for config */
+} trace_t;
+
+static const trace_t traces[] = {
+    { "short", { 0, 100000 }, 2, 1000000, { INPUT_GESTURE_SHORT } },
+    { "double", { 0, 100000, 200000, 300000 }, 4, 1000000, { INPUT_GESTURE_DOUBLE } },
+    { "normal", { 0, 2000000 }, 2, 3000000, { INPUT_GESTURE_NORMAL } },
+    { "long", { 0, 4000000 }, 2, 5000000, { INPUT_GESTURE_LONG } },
+    /* Second press too long for a double click, the first click must survive */
+    { "short then normal", { 0, 100000, 200000, 2200000 }, 4, 3000000,
+      { INPUT_GESTURE_SHORT, INPUT_GESTURE_NORMAL } },
+    { "short then hold", { 0, 100000, 200000 }, 3, 7300000,
+      { INPUT_GESTURE_SHORT, INPUT_GESTURE_HOLD } },
+    /* Two shorts further apart than the window are two clicks */
+    { "two shorts", { 0, 100000, 600000, 700000 }, 4, 1500000,
+      { INPUT_GESTURE_SHORT, INPUT_GESTURE_SHORT } },
+    /* Contact bounce inside the debounce window is one press */
+    { "bounce", { 0, 5000, 10000, 100000 }, 4, 1000000, { INPUT_GESTURE_SHORT } },
+    { "hold", { 0 }, 1, 8000000, { INPUT_GESTURE_HOLD } },
+    /* Repeats at 7, 8, 9 and 10 s, the 11 s one is past the end */
+    { "hold repeat", { 0 }, 1, 10500000,
+      { INPUT_GESTURE_HOLD, INPUT_GESTURE_HOLD, INPUT_GESTURE_HOLD, INPUT_GESTURE_HOLD }, &repeat_config },
+    /* Release stops the repeats and is not classified */
+    { "hold repeat release", { 0, 9500000 }, 2, 15000000,
+      { INPUT_GESTURE_HOLD, INPUT_GESTURE_HOLD, INPUT_GESTURE_HOLD }, &repeat_config },
+    /* A click then a hold: the click goes out first, then the repeats */
+    { "short then repeat", { 0, 100000, 200000 }, 3, 9300000,
+      { INPUT_GESTURE_SHORT, INPUT_GESTURE_HOLD, INPUT_GESTURE_HOLD, INPUT_GESTURE_HOLD }, &repeat_config },
+    /* Without repeats the same hold reports once */
+    { "hold no repeat", { 0 }, 1, 10500000, { INPUT_GESTURE_HOLD } },
+};
+
+static size_t replay(const trace_t *trace, input_gesture_event_t *events) {
+    input_gesture_t gesture;
+    const input_gesture_config_t *cfg = trace->config ? trace->config : &config;
+    input_gesture_event_t event;
+    size_t count = 0;
+    int level = !cfg->active_level;
+
+    input_gesture_init(&gesture, cfg);
+    for (size_t i = 0; i < trace->edge_count; i++) {
+        while ((event = input_gesture_poll(&gesture, trace->edges[i])) != INPUT_GESTURE_NONE) {
+            TEST_CHECK(count < EVENTS_MAX);
+            events[count++] = event;
+        }
+        level = !level;
+        if ((event = input_gesture_feed(&gesture, level, trace->edges[i])) != INPUT_GESTURE_NONE) {
+            TEST_CHECK(count < EVENTS_MAX);
+            events[count++] = event;
+        }
+    }
+    /* Step through the deadlines the engine asks for, like the input_iot timer */
+    int64_t deadline;
+    while ((deadline = input_gesture_next_deadline(&gesture)) >= 0 && deadline <= trace->end_us) {
+        while ((event = input_gesture_poll(&gesture, deadline)) != INPUT_GESTURE_NONE) {
+            TEST_CHECK(count < EVENTS_MAX);
+            events[count++] = event;
+        }
+    }
+    return count;
+}
+
+static void test_traces(void) {
+    for (size_t i = 0; i < sizeof(traces) / sizeof(traces[0]); i++) {
+        const trace_t *trace = &traces[i];
+        input_gesture_event_t events[EVENTS_MAX] = { 0 };
+        size_t expect_count = 0;
+        while (expect_count < EVENTS_MAX && trace->expect[expect_count] != INPUT_GESTURE_NONE) {
+            expect_count++;
+        }
+        size_t count = replay(trace, events);
+        printf("%-20s", trace->name);
+        for (size_t j = 0; j < count; j++) {
+            printf(" %d", events[j]);
+        }
+        printf("\n");
+        TEST_CHECK(count == expect_count);
+        TEST_CHECK(memcmp(events, trace->expect, count * sizeof(events[0])) == 0);
+    }
+}
+
+/* The whole trace set replayed over and over, as a cost per edge and per
+ * event for the input_iot task that runs the engine */
+static void test_bench(void) {
+    enum { ROUNDS = 200000 };
+    size_t edges = 0;
+    size_t events = 0;
+
+    int64_t start = test_now_ns();
+    for (int round = 0; round < ROUNDS; round++) {
+        for (size_t i = 0; i < sizeof(traces) / sizeof(traces[0]); i++) {
+            input_gesture_event_t out[EVENTS_MAX];
+            events += replay(&traces[i], out);
+            edges += traces[i].edge_count;
+        }
+    }
+    double seconds = (test_now_ns() - start) / 1e9;
+    TEST_CHECK(events > 0);
+    printf("replay: %zu traces in %.3f s, %.1f M edges/s, %.1f M events/s, %.0f ns per trace\n",
+           ROUNDS * (sizeof(traces) / sizeof(traces[0])), seconds, edges / seconds / 1e6,
+           events / seconds / 1e6, seconds * 1e9 / ROUNDS / (sizeof(traces) / sizeof(traces[0])));
+}
+
+int main(void) {
+    test_traces();
+    test_bench();
+    printf("input_gesture: ok\n");
+    return 0;
+}
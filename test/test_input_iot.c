@@ -0,0 +1,326 @@
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "test_util.h"
+#include "driver/gpio.h"
+#include "hal/gpio_ll.h"
+#include "esp_timer.h"
+#include "input_iot.h"
+
+/* The GPIO driver is replaced by a table of the ISR handlers input_iot
+ * registers, so the test raises an interrupt by calling one, and the input
+ * registers are a plain struct. The storm meter's periodic timer only
+ * ticks when the test runs its callback. */
+
+gpio_dev_t GPIO;
+
+typedef struct {
+    gpio_isr_t handler;
+    void *arg;
+    bool intr_enabled;
+} fake_pin_t;
+
+static fake_pin_t s_pins[GPIO_NUM_MAX];
+static int s_isr_service_installs;
+static esp_timer_cb_t s_timer_cb;
+static void *s_timer_arg;
+static uint64_t s_timer_period;
+
+void gpio_pad_select_gpio(uint8_t gpio_num) {
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode) {
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_pull_mode(gpio_num_t gpio_num, gpio_pull_mode_t pull) {
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio_num, gpio_int_type_t intr_type) {
+    s_pins[gpio_num].intr_enabled = intr_type != GPIO_INTR_DISABLE;
+    return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags) {
+    s_isr_service_installs++;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args) {
+    s_pins[gpio_num].handler = isr_handler;
+    s_pins[gpio_num].arg = args;
+    return ESP_OK;
+}
+
+esp_err_t gpio_intr_enable(gpio_num_t gpio_num) {
+    s_pins[gpio_num].intr_enabled = true;
+    return ESP_OK;
+}
+
+void gpio_ll_intr_disable(gpio_dev_t *hw, gpio_num_t gpio_num) {
+    s_pins[gpio_num].intr_enabled = false;
+}
+
+int gpio_get_level(gpio_num_t gpio_num) {
+    return gpio_ll_get_level(&GPIO, gpio_num);
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle) {
+    s_timer_cb = create_args->callback;
+    s_timer_arg = create_args->arg;
+    *out_handle = (esp_timer_handle_t) &s_timer_cb;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period) {
+    s_timer_period = period;
+    return ESP_OK;
+}
+
+static void set_level(gpio_num_t gpio_num, int level) {
+    uint32_t *reg = gpio_num < 32 ? &GPIO.in : &GPIO.in1.data;
+    uint32_t bit = 1u << (gpio_num % 32);
+    *reg = level ? *reg | bit : *reg & ~bit;
+}
+
+static void fire(gpio_num_t gpio_num) {
+    TEST_CHECK(s_pins[gpio_num].handler != NULL);
+    s_pins[gpio_num].handler(s_pins[gpio_num].arg);
+}
+
+static void meter_tick(void) {
+    TEST_CHECK(s_timer_cb != NULL);
+    s_timer_cb(s_timer_arg);
+}
+
+/* Direct handlers, called from the ISR with the pin and its own context */
+typedef struct {
+    int calls;
+    gpio_num_t last_pin;
+    void *last_ctx;
+} direct_log_t;
+
+static direct_log_t s_direct;
+
+static void direct_handler(gpio_num_t gpio_num, void *ctx) {
+    s_direct.calls++;
+    s_direct.last_pin = gpio_num;
+    s_direct.last_ctx = ctx;
+}
+
+static void expect_direct(gpio_num_t gpio_num, void *ctx) {
+    int calls = s_direct.calls;
+    fire(gpio_num);
+    TEST_CHECK(s_direct.calls == calls + 1);
+    TEST_CHECK(s_direct.last_pin == gpio_num && s_direct.last_ctx == ctx);
+}
+
+static void test_dispatch(void) {
+    static int ctx_a, ctx_b, ctx_c;
+    input_io_create(GPIO_NUM_0, ANY_EDGE);
+    input_io_create(GPIO_NUM_4, HI_TO_LO);
+    input_io_create(GPIO_NUM_39, LO_TO_HI);
+    TEST_CHECK(s_isr_service_installs == 1);
+    /* Each pin gets its own slot as the ISR arg */
+    TEST_CHECK(s_pins[0].arg != s_pins[4].arg && s_pins[4].arg != s_pins[39].arg);
+
+    /* No handler yet: the edge is dropped quietly */
+    fire(GPIO_NUM_0);
+    TEST_CHECK(s_direct.calls == 0);
+
+    TEST_CHECK(input_io_set_handler(GPIO_NUM_0, direct_handler, &ctx_a) == ESP_OK);
+    TEST_CHECK(input_io_set_handler(GPIO_NUM_4, direct_handler, &ctx_b) == ESP_OK);
+    TEST_CHECK(input_io_set_handler(GPIO_NUM_39, direct_handler, &ctx_c) == ESP_OK);
+    expect_direct(GPIO_NUM_0, &ctx_a);
+    expect_direct(GPIO_NUM_39, &ctx_c);
+    expect_direct(GPIO_NUM_4, &ctx_b);
+
+    /* Replacing a handler swaps the context with it */
+    TEST_CHECK(input_io_set_handler(GPIO_NUM_4, direct_handler, &ctx_c) == ESP_OK);
+    expect_direct(GPIO_NUM_4, &ctx_c);
+    TEST_CHECK(input_io_set_handler(GPIO_NUM_39, NULL, NULL) == ESP_OK);
+    int calls = s_direct.calls;
+    fire(GPIO_NUM_39);
+    TEST_CHECK(s_direct.calls == calls);
+
+    TEST_CHECK(input_io_set_handler(GPIO_NUM_MAX, direct_handler, NULL) == ESP_ERR_INVALID_ARG);
+    TEST_CHECK(input_io_set_handler(GPIO_NUM_NC, direct_handler, NULL) == ESP_ERR_INVALID_ARG);
+}
+
+static void test_levels(void) {
+    set_level(GPIO_NUM_0, 1);
+    set_level(GPIO_NUM_4, 0);
+    set_level(GPIO_NUM_39, 1);
+    TEST_CHECK(input_io_get_levels() == (1ULL << 39 | 1));
+    TEST_CHECK(input_io_get_level(GPIO_NUM_39) == 1 && input_io_get_level(GPIO_NUM_4) == 0);
+    set_level(GPIO_NUM_39, 0);
+    TEST_CHECK(input_io_get_levels() == 1);
+}
+
+/* Deferred handlers run in the worker task, in edge order */
+#define LOG_MAX     64
+
+static pthread_mutex_t s_log_lock = PTHREAD_MUTEX_INITIALIZER;
+static input_event_t s_log[LOG_MAX];
+static int s_log_len;
+static bool s_gate_closed;     /* Holds the worker inside its callback */
+
+static void deferred_handler(const input_event_t *event, void *ctx) {
+    TEST_CHECK(ctx == &s_log_len);
+    pthread_mutex_lock(&s_log_lock);
+    TEST_CHECK(s_log_len < LOG_MAX);
+    s_log[s_log_len++] = *event;
+    pthread_mutex_unlock(&s_log_lock);
+    while (__atomic_load_n(&s_gate_closed, __ATOMIC_ACQUIRE)) {
+        usleep(1000);
+    }
+}
+
+static int log_wait(int count) {
+    int len = 0;
+    for (int i = 0; i < 2000; i++) {
+        pthread_mutex_lock(&s_log_lock);
+        len = s_log_len;
+        pthread_mutex_unlock(&s_log_lock);
+        if (len >= count) {
+            break;
+        }
+        usleep(1000);
+    }
+    return len;
+}
+
+static void test_deferred(void) {
+    enum { RING = 16 };
+    input_deferred_config_t config = INPUT_DEFERRED_CONFIG_DEFAULT();
+    config.ring_size = 12;
+    TEST_CHECK(input_io_deferred_start(&config) == ESP_ERR_INVALID_ARG);
+    config.ring_size = RING;
+    config.batch_size = 4;
+    TEST_CHECK(input_io_deferred_start(&config) == ESP_OK);
+    TEST_CHECK(input_io_deferred_start(&config) == ESP_ERR_INVALID_STATE);
+    TEST_CHECK(input_io_set_deferred_handler(GPIO_NUM_4, deferred_handler, &s_log_len) == ESP_OK);
+
+    /* Pins left on direct handlers stay direct */
+    static int ctx;
+    TEST_CHECK(input_io_set_handler(GPIO_NUM_0, direct_handler, &ctx) == ESP_OK);
+    expect_direct(GPIO_NUM_0, &ctx);
+
+    for (int i = 0; i < 10; i++) {
+        set_level(GPIO_NUM_4, i & 1);
+        fire(GPIO_NUM_4);
+    }
+    TEST_CHECK(log_wait(10) == 10);
+    for (int i = 0; i < 10; i++) {
+        TEST_CHECK(s_log[i].gpio_num == GPIO_NUM_4);
+        TEST_CHECK(s_log[i].level == (i & 1));
+        TEST_CHECK(s_log[i].dropped == 0);
+        TEST_CHECK(i == 0 || s_log[i].timestamp_us >= s_log[i - 1].timestamp_us);
+    }
+
+    /* With the worker held in a callback the ring fills, the overflow is
+     * counted and reported on the first event that fits again */
+    input_deferred_stats_t before;
+    input_io_get_deferred_stats(&before);
+    pthread_mutex_lock(&s_log_lock);
+    s_log_len = 0;
+    pthread_mutex_unlock(&s_log_lock);
+    __atomic_store_n(&s_gate_closed, true, __ATOMIC_RELEASE);
+    fire(GPIO_NUM_4);
+    TEST_CHECK(log_wait(1) == 1);
+    for (int i = 0; i < RING - 1 + 3; i++) {
+        fire(GPIO_NUM_4);
+    }
+    __atomic_store_n(&s_gate_closed, false, __ATOMIC_RELEASE);
+    TEST_CHECK(log_wait(RING) == RING);
+    fire(GPIO_NUM_4);
+    TEST_CHECK(log_wait(RING + 1) == RING + 1);
+    for (int i = 0; i < RING; i++) {
+        TEST_CHECK(s_log[i].dropped == 0);
+    }
+    TEST_CHECK(s_log[RING].dropped == 3);
+
+    input_deferred_stats_t after;
+    input_io_get_deferred_stats(&after);
+    TEST_CHECK(after.pushed == before.pushed + RING + 1);
+    TEST_CHECK(after.dropped == before.dropped + 3);
+    TEST_CHECK(after.high_water == RING);
+}
+
+static int s_storms;
+static gpio_num_t s_storm_pin;
+static uint32_t s_storm_rate;
+
+static void storm_handler(gpio_num_t gpio_num, uint32_t rate, void *ctx) {
+    s_storms++;
+    s_storm_pin = gpio_num;
+    s_storm_rate = rate;
+}
+
+static void test_storm(void) {
+    input_storm_config_t config = INPUT_STORM_CONFIG_DEFAULT();
+    config.max_edges_per_sec = 50;
+    config.backoff_ms = 250;    /* Rounds up to three meter ticks */
+    TEST_CHECK(input_io_storm_start(&config, storm_handler, NULL) == ESP_OK);
+    TEST_CHECK(input_io_storm_start(&config, storm_handler, NULL) == ESP_ERR_INVALID_STATE);
+    TEST_CHECK(s_timer_period == 100000);
+
+    /* Up to the ceiling every edge is dispatched, the one past it masks the pin */
+    static int ctx;
+    TEST_CHECK(input_io_set_handler(GPIO_NUM_0, direct_handler, &ctx) == ESP_OK);
+    input_health_t health;
+    TEST_CHECK(input_io_get_health(GPIO_NUM_0, &health) == ESP_OK);
+    uint32_t edges = health.edges;
+    int calls = s_direct.calls;
+    for (int i = 0; i < 50; i++) {
+        fire(GPIO_NUM_0);
+    }
+    TEST_CHECK(s_direct.calls == calls + 50 && s_pins[0].intr_enabled);
+    fire(GPIO_NUM_0);
+    fire(GPIO_NUM_0);
+    TEST_CHECK(s_direct.calls == calls + 50 && !s_pins[0].intr_enabled);
+    TEST_CHECK(input_io_get_health(GPIO_NUM_0, &health) == ESP_OK);
+    TEST_CHECK(health.edges == edges + 52 && health.rate == 52 && health.storms == 1 && health.masked);
+
+    /* Reported from the next tick, not the ISR, then re-armed after the backoff */
+    TEST_CHECK(s_storms == 0);
+    meter_tick();
+    TEST_CHECK(s_storms == 1 && s_storm_pin == GPIO_NUM_0 && s_storm_rate == 52);
+    meter_tick();
+    meter_tick();
+    TEST_CHECK(!s_pins[0].intr_enabled);
+    meter_tick();
+    TEST_CHECK(s_pins[0].intr_enabled);
+    TEST_CHECK(input_io_get_health(GPIO_NUM_0, &health) == ESP_OK);
+    TEST_CHECK(!health.masked && health.rate == 0);
+    expect_direct(GPIO_NUM_0, &ctx);
+
+    /* A pin with no limit is only metered, its rate ages out over a second */
+    TEST_CHECK(input_io_set_storm_limit(GPIO_NUM_39, 0) == ESP_OK);
+    TEST_CHECK(input_io_set_handler(GPIO_NUM_39, direct_handler, &ctx) == ESP_OK);
+    for (int i = 0; i < 200; i++) {
+        fire(GPIO_NUM_39);
+    }
+    TEST_CHECK(input_io_get_health(GPIO_NUM_39, &health) == ESP_OK);
+    TEST_CHECK(health.rate == 200 && !health.masked && s_pins[39].intr_enabled);
+    for (int i = 0; i < 9; i++) {
+        meter_tick();
+    }
+    TEST_CHECK(input_io_get_health(GPIO_NUM_39, &health) == ESP_OK && health.rate == 200);
+    meter_tick();
+    TEST_CHECK(input_io_get_health(GPIO_NUM_39, &health) == ESP_OK && health.rate == 0);
+    TEST_CHECK(health.edges >= 200 && health.storms == 0);
+
+    TEST_CHECK(input_io_set_storm_limit(GPIO_NUM_MAX, 1) == ESP_ERR_INVALID_ARG);
+    TEST_CHECK(input_io_get_health(GPIO_NUM_0, NULL) == ESP_ERR_INVALID_ARG);
+}
+
+int main(void) {
+    test_dispatch();
+    test_levels();
+    test_deferred();
+    test_storm();
+    printf("input_iot: ok\n");
+    return 0;
+}
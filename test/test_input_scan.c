@@ -0,0 +1,102 @@
+#include <string.h>
+#include "test_util.h"
+#include "input_scan.h"
+
+/* Pushes synthetic register traces through input_scan and compares every
+ * step with a straightforward per-pin model. */
+
+typedef struct {
+    uint64_t mask;
+    uint64_t stable;
+    uint8_t debounce;
+    uint8_t count[INPUT_SCAN_MAX_PINS];
+} model_t;
+
+static uint64_t model_update(model_t *model, uint64_t sample) {
+    uint64_t changed = 0;
+    for (int pin = 0; pin < INPUT_SCAN_MAX_PINS; pin++) {
+        uint64_t bit = 1ULL << pin;
+        if (!(model->mask & bit) || !((sample ^ model->stable) & bit)) {
+            model->count[pin] = 0;
+            continue;
+        }
+        if (++model->count[pin] >= model->debounce) {
+            model->count[pin] = 0;
+            changed |= bit;
+        }
+    }
+    model->stable ^= changed;
+    return changed;
+}
+
+static uint64_t rand64(uint64_t *state) {
+    /* xorshift64, reproducible across runs */
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static void test_debounce(void) {
+    input_scan_t scan;
+    input_scan_init(&scan, 0x5, 0x0, 3);
+    /* A glitch shorter than the debounce count never shows up */
+    TEST_CHECK(input_scan_update(&scan, 0x1) == 0);
+    TEST_CHECK(input_scan_update(&scan, 0x1) == 0);
+    TEST_CHECK(input_scan_update(&scan, 0x0) == 0);
+    TEST_CHECK(input_scan_update(&scan, 0x1) == 0);
+    TEST_CHECK(input_scan_update(&scan, 0x1) == 0);
+    TEST_CHECK(input_scan_update(&scan, 0x1) == 0x1);
+    TEST_CHECK(scan.stable == 0x1);
+    /* Pins outside the mask are ignored */
+    for (int i = 0; i < 10; i++) {
+        TEST_CHECK(input_scan_update(&scan, 0x1 | 0x2) == 0);
+    }
+    /* Pin 63 works like the others */
+    input_scan_init(&scan, 1ULL << 63, 0, 1);
+    TEST_CHECK(input_scan_update(&scan, 1ULL << 63) == 1ULL << 63);
+}
+
+static void test_random_traces(void) {
+    uint64_t seed = 0x9e3779b97f4a7c15ULL;
+    for (int run = 0; run < 200; run++) {
+        uint64_t mask = rand64(&seed);
+        uint64_t initial = rand64(&seed);
+        uint8_t debounce = 1 + rand64(&seed) % 5;
+        input_scan_t scan;
+        model_t model = { .mask = mask, .stable = initial & mask, .debounce = debounce };
+        input_scan_init(&scan, mask, initial, debounce);
+
+        uint64_t level = initial;
+        for (int step = 0; step < 1000; step++) {
+            /* A few pins flip per sample, some of them bounce straight back */
+            uint64_t flips = rand64(&seed) & rand64(&seed) & rand64(&seed);
+            level ^= flips;
+            uint64_t sample = level ^ (rand64(&seed) & rand64(&seed) & rand64(&seed) & rand64(&seed));
+            uint64_t expect = model_update(&model, sample);
+            TEST_CHECK(input_scan_update(&scan, sample) == expect);
+            TEST_CHECK(scan.stable == model.stable);
+        }
+    }
+}
+
+static void bench_quiet_bank(void) {
+    input_scan_t scan;
+    input_scan_init(&scan, UINT64_MAX, 0x00ff00ff00ff00ffULL, 4);
+    const int samples = 10000000;
+    volatile uint64_t sink = 0;
+    int64_t start = test_now_ns();
+    for (int i = 0; i < samples; i++) {
+        sink |= input_scan_update(&scan, 0x00ff00ff00ff00ffULL);
+    }
+    int64_t elapsed = test_now_ns() - start;
+    TEST_CHECK(sink == 0);
+    printf("quiet 64-pin scan: %.2f ns per sample\n", (double) elapsed / samples);
+}
+
+int main(void) {
+    test_debounce();
+    test_random_traces();
+    bench_quiet_bank();
+    return 0;
+}
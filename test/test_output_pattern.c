@@ -0,0 +1,179 @@
+#include <string.h>
+#include "test_util.h"
+#include "output_pattern.h"
+
+/* output_pattern_eval is what the software fallback runs on every edge.
+ * Each pattern is checked against a plain per-instant model on a grid fine
+ * enough to hold every edge, then played edge to edge the way the esp_timer
+ * callback does. */
+
+#define STEP_US     10
+#define HORIZON_US  4000000
+
+/* Level at t_us, straight from the definition of the fields */
+static int model_level(const output_pattern_t *p, uint64_t t_us) {
+    uint64_t period_us = (uint64_t) p->period_ms * 1000;
+    uint64_t on_us = period_us * p->duty_percent / 100;
+    if (p->burst_count == 0) {
+        return t_us % period_us < on_us;
+    }
+    uint64_t burst_us = period_us * p->burst_count;
+    uint64_t cycle_us = burst_us + (uint64_t) p->burst_gap_ms * 1000;
+    if (p->repeat && t_us / cycle_us >= p->repeat) {
+        return 0;
+    }
+    uint64_t pos_us = t_us % cycle_us;
+    return pos_us < burst_us && pos_us % period_us < on_us;
+}
+
+static uint8_t s_levels[HORIZON_US / STEP_US + 1];
+static uint32_t s_next_change[HORIZON_US / STEP_US + 1];    /* Grid index, 0 when the level never changes again */
+
+static void check_pattern(const output_pattern_t *p) {
+    size_t count = HORIZON_US / STEP_US + 1;
+    for (size_t i = 0; i < count; i++) {
+        s_levels[i] = model_level(p, (uint64_t) i * STEP_US);
+    }
+    s_next_change[count - 1] = 0;
+    for (size_t i = count - 1; i-- > 0;) {
+        s_next_change[i] = s_levels[i + 1] != s_levels[i] ? i + 1 : s_next_change[i + 1];
+    }
+
+    /* Every instant, on and off the grid */
+    for (size_t i = 0; i + 1 < count; i++) {
+        for (uint64_t off = 0; off < STEP_US; off += 7) {
+            uint64_t t_us = (uint64_t) i * STEP_US + off;
+            int level;
+            uint64_t next_us = 0;
+            bool running = output_pattern_eval(p, t_us, &level, &next_us);
+            TEST_CHECK(level == s_levels[i]);
+            if (!running) {
+                /* Finished or constant: nothing changes from here on */
+                TEST_CHECK(s_next_change[i] == 0);
+                continue;
+            }
+            TEST_CHECK(next_us > t_us);
+            if (next_us < HORIZON_US) {
+                TEST_CHECK(s_next_change[i] != 0 && next_us == (uint64_t) s_next_change[i] * STEP_US);
+            }
+        }
+    }
+}
+
+/* Runs the pattern edge to edge like the timer callback: high time and
+ * rising edges per burst, and the wake-ups it took */
+static void play(const output_pattern_t *p, uint64_t horizon_us, uint64_t *high_us, uint32_t *rises, uint32_t *wakeups) {
+    uint64_t t_us = 0;
+    int last = 0;
+    *high_us = 0;
+    *rises = 0;
+    *wakeups = 0;
+    for (;;) {
+        int level;
+        uint64_t next_us = 0;
+        bool running = output_pattern_eval(p, t_us, &level, &next_us);
+        (*wakeups)++;
+        *rises += level && !last;
+        last = level;
+        uint64_t until = running && next_us < horizon_us ? next_us : horizon_us;
+        if (level) {
+            *high_us += until - t_us;
+        }
+        if (!running || next_us >= horizon_us) {
+            break;
+        }
+        t_us = next_us;
+    }
+}
+
+static void test_model(void) {
+    static const output_pattern_t patterns[] = {
+        { .period_ms = 100, .duty_percent = 50 },
+        { .period_ms = 7, .duty_percent = 13 },
+        { .period_ms = 100, .duty_percent = 30, .burst_count = 3, .burst_gap_ms = 500, .repeat = 2 },
+        { .period_ms = 50, .duty_percent = 100, .burst_count = 4, .burst_gap_ms = 250 },
+        { .period_ms = 20, .duty_percent = 10, .burst_count = 1, .burst_gap_ms = 0, .repeat = 3 },
+        { .period_ms = 40, .duty_percent = 75, .burst_count = 5, .burst_gap_ms = 1, .repeat = 0 },
+        { .period_ms = 10, .duty_percent = 100 },
+        { .period_ms = 10, .duty_percent = 0, .burst_count = 2 },
+    };
+    for (size_t i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++) {
+        TEST_CHECK(output_pattern_is_valid(&patterns[i]));
+        check_pattern(&patterns[i]);
+    }
+}
+
+static void test_play(void) {
+    uint64_t high_us;
+    uint32_t rises, wakeups;
+
+    /* 3 pulses of 30 ms, twice, then done without a wake-up past the end */
+    output_pattern_t bursts = { .period_ms = 100, .duty_percent = 30, .burst_count = 3, .burst_gap_ms = 500, .repeat = 2 };
+    play(&bursts, HORIZON_US, &high_us, &rises, &wakeups);
+    TEST_CHECK(rises == 6 && high_us == 6 * 30000);
+    TEST_CHECK(wakeups == 12);
+
+    /* Continuous blink: duty holds over many periods */
+    output_pattern_t blink = { .period_ms = 7, .duty_percent = 13 };
+    play(&blink, 7000 * 1000, &high_us, &rises, &wakeups);
+    TEST_CHECK(rises == 1000 && high_us == 1000 * 910);
+    TEST_CHECK(wakeups == 2000);
+
+    /* Constant levels never wake up again */
+    output_pattern_t on = { .period_ms = 10, .duty_percent = 100 };
+    play(&on, HORIZON_US, &high_us, &rises, &wakeups);
+    TEST_CHECK(wakeups == 1 && rises == 1);
+    output_pattern_t off = { .period_ms = 10, .duty_percent = 0 };
+    play(&off, HORIZON_US, &high_us, &rises, &wakeups);
+    TEST_CHECK(wakeups == 1 && high_us == 0);
+
+    output_pattern_t bad = { .period_ms = 0, .duty_percent = 50 };
+    TEST_CHECK(!output_pattern_is_valid(&bad) && !output_pattern_is_valid(NULL));
+    bad.period_ms = 10;
+    bad.duty_percent = 101;
+    TEST_CHECK(!output_pattern_is_valid(&bad));
+}
+
+/* The finest duty step the LEDC setup gets for a period, in percent */
+static double duty_step(uint32_t resolution) {
+    return 100.0 / (1u << resolution);
+}
+
+static void test_ledc_clock(void) {
+    uint32_t resolution, divider;
+    for (uint32_t period_ms = 1; period_ms <= 1000000; period_ms = period_ms * 3 / 2 + 1) {
+        if (!output_pattern_ledc_clock(period_ms, &resolution, &divider)) {
+            continue;
+        }
+        /* period = divider / 256 * 2^resolution ticks of 1 us, to within the divider's rounding */
+        uint64_t ticks = (uint64_t) period_ms * 1000;
+        TEST_CHECK(resolution >= 1 && resolution <= 20);
+        TEST_CHECK(divider >= 256 && divider < 1024 * 256);
+        TEST_CHECK(((uint64_t) divider << resolution) >> 8 <= ticks);
+        TEST_CHECK(((uint64_t) (divider + 1) << resolution) >> 8 >= ticks);
+        /* No finer resolution would still keep the divider at 1.0 */
+        TEST_CHECK(resolution == 20 || (ticks << 8) >> (resolution + 1) < 256);
+    }
+
+    /* The cases that used to quantise badly */
+    TEST_CHECK(output_pattern_ledc_clock(10, &resolution, &divider));
+    TEST_CHECK(resolution == 13 && duty_step(resolution) < 0.02);
+    TEST_CHECK(output_pattern_ledc_clock(1, &resolution, &divider));
+    TEST_CHECK(resolution == 9 && divider == 500);
+    /* 10% of 1 ms lands within one step */
+    uint32_t duty = (1u << resolution) * 10 / 100;
+    TEST_CHECK(duty * 100.0 / (1u << resolution) > 9.8);
+
+    TEST_CHECK(output_pattern_ledc_clock(1000, &resolution, &divider) && resolution == 19);
+    TEST_CHECK(output_pattern_ledc_clock(1073741, &resolution, &divider) && resolution == 20);
+    TEST_CHECK(!output_pattern_ledc_clock(1073742, &resolution, &divider));
+    TEST_CHECK(!output_pattern_ledc_clock(0, &resolution, &divider));
+}
+
+int main(void) {
+    test_model();
+    test_play();
+    test_ledc_clock();
+    printf("output_pattern: ok\n");
+    return 0;
+}
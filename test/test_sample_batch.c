@@ -0,0 +1,284 @@
+#include <string.h>
+#include <signal.h>
+#include "test_util.h"
+#include "stand_in_server.h"
+#include "dns_cache.h"
+#include "http_iot.h"
+#include "http_req.h"
+#include "sample_batch.h"
+
+/* The flush rules run against a callback that keeps what it was handed.
+ * The benchmark then uploads through http_iot to the stand-in server, one
+ * GET per sample on a new connection the way the app used to, against
+ * bulk_update batches on a kept connection. */
+
+#define HOST            "stand-in.test"
+#define KEY             "K"
+#define PREFIX          "{\"write_api_key\":\"" KEY "\",\"updates\":["
+
+typedef struct {
+    int calls;
+    esp_err_t result;
+    char body[4096];
+    size_t len;
+    uint32_t count;
+} capture_t;
+
+static esp_err_t capture_flush(const char *body, size_t len, uint32_t count, void *ctx) {
+    capture_t *capture = ctx;
+    capture->calls++;
+    TEST_CHECK(len < sizeof(capture->body));
+    memcpy(capture->body, body, len);
+    capture->body[len] = 0;
+    capture->len = len;
+    capture->count = count;
+    return capture->result;
+}
+
+static sample_batch_handle_t create(capture_t *capture, uint32_t max_samples, size_t max_bytes) {
+    sample_batch_config_t config = SAMPLE_BATCH_CONFIG_DEFAULT(KEY, capture_flush);
+    config.max_samples = max_samples;
+    config.max_age_ms = 5000;
+    config.max_bytes = max_bytes;
+    config.retry_ms = 1000;
+    config.ctx = capture;
+    memset(capture, 0, sizeof(*capture));
+    sample_batch_handle_t batch;
+    TEST_CHECK(sample_batch_create(&config, &batch) == ESP_OK);
+    return batch;
+}
+
+static esp_err_t add(sample_batch_handle_t batch, uint32_t time_ms, float field1) {
+    sample_batch_sample_t sample = {
+        .time_ms = time_ms,
+        .field_mask = 1,
+        .fields = { field1 },
+    };
+    return sample_batch_add(batch, &sample);
+}
+
+static sample_batch_stats_t stats_of(sample_batch_handle_t batch) {
+    sample_batch_stats_t stats;
+    sample_batch_get_stats(batch, &stats);
+    return stats;
+}
+
+/* Body layout, delta_t in whole seconds carried across flushes */
+static void test_count(void) {
+    capture_t capture;
+    sample_batch_handle_t batch = create(&capture, 3, 2048);
+    sample_batch_sample_t sample = {
+        .time_ms = 1000,
+        .field_mask = 1 << 0 | 1 << 1,
+        .fields = { 20, 80.5f },
+    };
+    TEST_CHECK(sample_batch_add(batch, &sample) == ESP_OK);
+    TEST_CHECK(add(batch, 3500, 21) == ESP_OK);
+    sample.time_ms = 4000;
+    sample.field_mask = 1 << 2 | 1 << 7;
+    sample.fields[2] = -1.25f;
+    sample.fields[7] = 0;
+    TEST_CHECK(capture.calls == 0 && sample_batch_count(batch) == 2);
+    TEST_CHECK(sample_batch_add(batch, &sample) == ESP_OK);
+    TEST_CHECK(capture.calls == 1 && capture.count == 3 && sample_batch_count(batch) == 0);
+    TEST_CHECK(strcmp(capture.body, PREFIX "{\"delta_t\":0,\"field1\":20,\"field2\":80.5},"
+                      "{\"delta_t\":2,\"field1\":21},{\"delta_t\":1,\"field3\":-1.25,\"field8\":0}]}") == 0);
+    size_t first_len = capture.len;
+
+    TEST_CHECK(add(batch, 9000, 1) == ESP_OK);
+    TEST_CHECK(sample_batch_flush(batch) == ESP_OK);
+    TEST_CHECK(strcmp(capture.body, PREFIX "{\"delta_t\":5,\"field1\":1}]}") == 0);
+    /* Nothing queued, nothing sent */
+    TEST_CHECK(sample_batch_flush(batch) == ESP_OK && capture.calls == 2);
+
+    sample_batch_stats_t stats = stats_of(batch);
+    TEST_CHECK(stats.samples == 4 && stats.flushes == 2 && stats.by_count == 1);
+    TEST_CHECK(stats.bytes == first_len + capture.len);
+    sample_batch_delete(batch);
+}
+
+static void test_age(void) {
+    capture_t capture;
+    sample_batch_handle_t batch = create(&capture, 60, 2048);
+    TEST_CHECK(add(batch, 10000, 1) == ESP_OK);
+    TEST_CHECK(add(batch, 12000, 2) == ESP_OK);
+    TEST_CHECK(sample_batch_poll(batch, 14999) == ESP_OK && capture.calls == 0);
+    TEST_CHECK(sample_batch_poll(batch, 15000) == ESP_OK && capture.calls == 1 && capture.count == 2);
+    /* The age runs from the oldest sample of the new batch */
+    TEST_CHECK(add(batch, 16000, 3) == ESP_OK);
+    TEST_CHECK(sample_batch_poll(batch, 20999) == ESP_OK && capture.calls == 1);
+    TEST_CHECK(add(batch, 21000, 4) == ESP_OK && capture.calls == 2 && capture.count == 2);
+    TEST_CHECK(stats_of(batch).by_age == 2);
+    sample_batch_delete(batch);
+}
+
+/* A sample that doesn't fit sends what is there and starts the next batch */
+static void test_bytes(void) {
+    static const char one[] = "{\"delta_t\":0,\"field1\":1}";
+    size_t max_bytes = strlen(PREFIX) + 2 * strlen(one) + 1 + 2;
+    capture_t capture;
+    sample_batch_handle_t batch = create(&capture, 60, max_bytes);
+    TEST_CHECK(add(batch, 0, 1) == ESP_OK);
+    TEST_CHECK(add(batch, 100, 1) == ESP_OK);
+    TEST_CHECK(capture.calls == 0);
+    TEST_CHECK(add(batch, 200, 1) == ESP_OK);
+    TEST_CHECK(capture.calls == 1 && capture.count == 2 && capture.len == max_bytes);
+    TEST_CHECK(sample_batch_count(batch) == 1 && stats_of(batch).by_bytes == 1);
+    TEST_CHECK(sample_batch_flush(batch) == ESP_OK);
+    TEST_CHECK(strcmp(capture.body, PREFIX "{\"delta_t\":0,\"field1\":1}]}") == 0);
+
+    /* One that can't fit even in an empty batch is refused */
+    sample_batch_sample_t big = { .time_ms = 300, .field_mask = 0xff };
+    for (int i = 0; i < SAMPLE_BATCH_FIELDS; i++) {
+        big.fields[i] = 12345.678f;
+    }
+    TEST_CHECK(sample_batch_add(batch, &big) == ESP_ERR_INVALID_SIZE);
+    TEST_CHECK(stats_of(batch).dropped == 1 && sample_batch_count(batch) == 0);
+    sample_batch_delete(batch);
+}
+
+/* A refused flush keeps the samples and waits out retry_ms before trying again */
+static void test_retry(void) {
+    static const char one[] = "{\"delta_t\":0,\"field1\":1}";
+    size_t max_bytes = strlen(PREFIX) + 3 * strlen(one) + 2 + 2;
+    capture_t capture;
+    sample_batch_handle_t batch = create(&capture, 2, max_bytes);
+    capture.result = ESP_FAIL;
+    TEST_CHECK(add(batch, 0, 1) == ESP_OK);
+    TEST_CHECK(add(batch, 100, 1) == ESP_FAIL);
+    TEST_CHECK(capture.calls == 1 && sample_batch_count(batch) == 2);
+    TEST_CHECK(add(batch, 200, 1) == ESP_OK && capture.calls == 1);
+    TEST_CHECK(sample_batch_poll(batch, 1099) == ESP_OK && capture.calls == 1);
+
+    /* Full while held: the new sample is lost, the queued ones are kept */
+    TEST_CHECK(add(batch, 300, 1) == ESP_ERR_NO_MEM);
+    TEST_CHECK(stats_of(batch).dropped == 1 && sample_batch_count(batch) == 3);
+
+    TEST_CHECK(sample_batch_poll(batch, 1100) == ESP_FAIL && capture.calls == 2);
+    capture.result = ESP_OK;
+    TEST_CHECK(sample_batch_poll(batch, 2099) == ESP_OK && capture.calls == 2);
+    TEST_CHECK(sample_batch_poll(batch, 2100) == ESP_OK && capture.calls == 3 && capture.count == 3);
+    sample_batch_stats_t stats = stats_of(batch);
+    TEST_CHECK(stats.failed == 2 && stats.flushes == 1 && stats.samples == 3);
+    sample_batch_delete(batch);
+}
+
+static void test_args(void) {
+    sample_batch_handle_t batch;
+    sample_batch_config_t config = SAMPLE_BATCH_CONFIG_DEFAULT(KEY, capture_flush);
+    TEST_CHECK(sample_batch_create(NULL, &batch) == ESP_ERR_INVALID_ARG);
+    config.max_samples = 0;
+    TEST_CHECK(sample_batch_create(&config, &batch) == ESP_ERR_INVALID_ARG);
+    config.max_samples = 1;
+    config.flush_cb = NULL;
+    TEST_CHECK(sample_batch_create(&config, &batch) == ESP_ERR_INVALID_ARG);
+    config.flush_cb = capture_flush;
+    config.max_bytes = strlen(PREFIX) + 2;
+    TEST_CHECK(sample_batch_create(&config, &batch) == ESP_ERR_INVALID_SIZE);
+}
+
+static esp_err_t resolve(const char *host, struct in_addr *addr, uint32_t *ttl_s, void *ctx) {
+    addr->s_addr = htonl(INADDR_LOOPBACK);
+    return ESP_OK;
+}
+
+static const char BULK_HEAD[] = "POST /channels/1/bulk_update.json HTTP/1.1\r\nHost: " HOST "\r\n"
+                                "Content-Type: application/json\r\nContent-Length: ";
+
+/* The app's upload: header built around the batch body, which goes out in place */
+static esp_err_t upload_batch(const char *body, size_t len, uint32_t count, void *ctx) {
+    http_iot_handle_t http = ctx;
+    char numbers[16];
+    http_req_t req;
+    http_req_init(&req, numbers, sizeof(numbers));
+    http_req_static(&req, BULK_HEAD);
+    http_req_uint(&req, len);
+    http_req_static(&req, "\r\n\r\n");
+    http_req_ref(&req, body, len);
+    TEST_CHECK(!req.overflow);
+    int status = 0;
+    esp_err_t err = http_iot_requestv(http, req.iov, req.count, &status, NULL, NULL);
+    TEST_CHECK(err == ESP_OK && status == 200);
+    return err;
+}
+
+/* Estimate of what a sample costs over the air: 40 bytes of IPv4 and TCP
+ * header per segment, with a request, its response and an ACK for each,
+ * one more segment per further 1460 bytes, and 7 segments to open and
+ * close a connection. Link layer framing comes on top. */
+static void report(const char *name, int samples, double seconds, const server_traffic_t *before,
+                   const server_traffic_t *after) {
+    uint64_t bytes = (after->bytes_in - before->bytes_in) + (after->bytes_out - before->bytes_out);
+    uint32_t requests = after->requests - before->requests;
+    uint32_t connections = after->connections - before->connections;
+    uint64_t segments = 4 * (uint64_t) requests + bytes / 1460 + 7 * (uint64_t) connections;
+    printf("%s: %.0f samples/s, %.1f HTTP bytes/sample, ~%.1f bytes/sample on air\n", name,
+           samples / seconds, (double) bytes / samples, (bytes + 40.0 * segments) / samples);
+}
+
+static void test_bench(const char *port) {
+    enum { PER_SAMPLE = 2000, BATCHED = 60000 };
+    http_iot_config_t http_config = HTTP_IOT_CONFIG_DEFAULT(HOST, port);
+    http_config.idle_timeout_ms = 0;
+    http_iot_handle_t http;
+    TEST_CHECK(http_iot_create(&http_config, &http) == ESP_OK);
+    server_set_mode(SERVER_OK);
+    server_traffic_t before, after;
+
+    server_get_traffic(&before);
+    int64_t start = test_now_ns();
+    for (int i = 0; i < PER_SAMPLE; i++) {
+        char request[128];
+        int len = snprintf(request, sizeof(request), "GET /update?api_key=" KEY "&field1=%d&field2=%d HTTP/1.1\r\n"
+                           "Host: " HOST "\r\n\r\n", 20 + (i & 7), 80 - (i & 7));
+        int status = 0;
+        TEST_CHECK(http_iot_request(http, request, len, &status, NULL, NULL) == ESP_OK && status == 200);
+        http_iot_close(http);
+    }
+    double seconds = (test_now_ns() - start) / 1e9;
+    server_get_traffic(&after);
+    report("GET per sample, new connection", PER_SAMPLE, seconds, &before, &after);
+
+    sample_batch_config_t config = SAMPLE_BATCH_CONFIG_DEFAULT(KEY, upload_batch);
+    config.ctx = http;
+    sample_batch_handle_t batch;
+    TEST_CHECK(sample_batch_create(&config, &batch) == ESP_OK);
+    server_get_traffic(&before);
+    start = test_now_ns();
+    for (int i = 0; i < BATCHED; i++) {
+        sample_batch_sample_t sample = {
+            .time_ms = i * 1000,
+            .field_mask = 1 << 0 | 1 << 1,
+            .fields = { 20 + (i & 7), 80 - (i & 7) },
+        };
+        TEST_CHECK(sample_batch_add(batch, &sample) == ESP_OK);
+    }
+    TEST_CHECK(sample_batch_flush(batch) == ESP_OK);
+    seconds = (test_now_ns() - start) / 1e9;
+    server_get_traffic(&after);
+    sample_batch_stats_t stats = stats_of(batch);
+    TEST_CHECK(stats.samples == BATCHED && stats.dropped == 0 && stats.failed == 0);
+    printf("batches: %u, %.1f samples each, %u by count, %u by bytes\n", stats.flushes,
+           (double) stats.samples / stats.flushes, stats.by_count, stats.by_bytes);
+    report("bulk_update batches, kept connection", BATCHED, seconds, &before, &after);
+    sample_batch_delete(batch);
+    http_iot_delete(http);
+}
+
+int main(void) {
+    /* lwIP has no SIGPIPE, a write to a reset connection just fails */
+    signal(SIGPIPE, SIG_IGN);
+    test_count();
+    test_age();
+    test_bytes();
+    test_retry();
+    test_args();
+
+    const char *port = server_start();
+    dns_cache_config_t dns_config = DNS_CACHE_CONFIG_DEFAULT();
+    dns_config.resolver = resolve;
+    TEST_CHECK(dns_cache_init(&dns_config) == ESP_OK);
+    test_bench(port);
+    printf("sample_batch: ok\n");
+    return 0;
+}
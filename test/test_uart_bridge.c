@@ -0,0 +1,309 @@
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "lwip/sockets.h"
+#include "test_util.h"
+#include "uart_bridge.h"
+
+/* The UART is a pair of byte buffers: bytes put into the receive side post
+ * UART_DATA to the bridge like the port task would, whatever the bridge
+ * writes lands in a capture. A real TCP client on loopback sits on the
+ * other end. */
+
+#define UART_RX_MAX     (1024 * 1024)
+#define UART_TX_MAX     (1024 * 1024)
+#define BATCH_SIZE      64
+#define LATENCY_MS      20
+
+static pthread_mutex_t s_uart_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t s_rx[UART_RX_MAX];
+static size_t s_rx_head;
+static size_t s_rx_tail;
+static uint8_t s_tx[UART_TX_MAX];
+static size_t s_tx_len;
+static uart_iot_config_t s_uart_config;
+
+esp_err_t uart_iot_create(const uart_iot_config_t *config, uart_iot_handle_t *ret_uart) {
+    s_uart_config = *config;
+    *ret_uart = (uart_iot_handle_t) &s_uart_config;
+    return ESP_OK;
+}
+
+esp_err_t uart_iot_delete(uart_iot_handle_t uart) {
+    return ESP_OK;
+}
+
+esp_err_t uart_get_buffered_data_len(uart_port_t port, size_t *size) {
+    pthread_mutex_lock(&s_uart_lock);
+    *size = s_rx_tail - s_rx_head;
+    pthread_mutex_unlock(&s_uart_lock);
+    return ESP_OK;
+}
+
+int uart_read_bytes(uart_port_t port, void *buf, uint32_t length, TickType_t ticks_to_wait) {
+    pthread_mutex_lock(&s_uart_lock);
+    size_t n = s_rx_tail - s_rx_head;
+    if (n > length) {
+        n = length;
+    }
+    memcpy(buf, s_rx + s_rx_head, n);
+    s_rx_head += n;
+    pthread_mutex_unlock(&s_uart_lock);
+    return n;
+}
+
+int uart_write_bytes(uart_port_t port, const void *src, size_t size) {
+    pthread_mutex_lock(&s_uart_lock);
+    TEST_CHECK(s_tx_len + size <= UART_TX_MAX);
+    memcpy(s_tx + s_tx_len, src, size);
+    s_tx_len += size;
+    pthread_mutex_unlock(&s_uart_lock);
+    return size;
+}
+
+static void uart_receive(const uint8_t *data, size_t len) {
+    pthread_mutex_lock(&s_uart_lock);
+    TEST_CHECK(s_rx_tail + len <= UART_RX_MAX);
+    memcpy(s_rx + s_rx_tail, data, len);
+    s_rx_tail += len;
+    pthread_mutex_unlock(&s_uart_lock);
+    uart_event_t event = {
+        .type = UART_DATA,
+        .size = len,
+    };
+    s_uart_config.event_cb((uart_iot_handle_t) &s_uart_config, &event, s_uart_config.ctx);
+}
+
+static size_t uart_sent(uint8_t *out) {
+    pthread_mutex_lock(&s_uart_lock);
+    size_t len = s_tx_len;
+    if (out) {
+        memcpy(out, s_tx, len);
+    }
+    pthread_mutex_unlock(&s_uart_lock);
+    return len;
+}
+
+static uart_bridge_stats_t bridge_stats(uart_bridge_handle_t bridge) {
+    uart_bridge_stats_t stats;
+    uart_bridge_get_stats(bridge, &stats);
+    return stats;
+}
+
+/* The bridge moves its counters after the bytes, poll until they show */
+#define WAIT_FOR(cond) do {                                 \
+    for (int _i = 0; _i < 2000 && !(cond); _i++) {          \
+        usleep(1000);                                       \
+    }                                                       \
+    TEST_CHECK(cond);                                       \
+} while (0)
+
+static int client_connect(uint16_t port) {
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    /* The downlink task may not be listening yet */
+    for (int i = 0; i < 200; i++) {
+        int s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        TEST_CHECK(s >= 0);
+        if (connect(s, (struct sockaddr *) &addr, sizeof(addr)) == 0) {
+            return s;
+        }
+        close(s);
+        usleep(10000);
+    }
+    TEST_CHECK(!"bridge never listened");
+    return -1;
+}
+
+/* Reads len bytes into buf, or throws them away when buf is NULL */
+static void client_read(int s, uint8_t *buf, size_t len) {
+    static uint8_t discard[4096];
+    struct timeval timeout = { .tv_sec = 2 };
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    size_t got = 0;
+    while (got < len) {
+        size_t want = len - got;
+        if (buf == NULL && want > sizeof(discard)) {
+            want = sizeof(discard);
+        }
+        int n = recv(s, buf ? buf + got : discard, want, 0);
+        TEST_CHECK(n > 0);
+        got += n;
+    }
+}
+
+static void test_no_client(uart_bridge_handle_t bridge) {
+    static const uint8_t data[] = "nobody listening";
+    uart_receive(data, sizeof(data));
+    WAIT_FOR(bridge_stats(bridge).dropped == sizeof(data));
+    TEST_CHECK(bridge_stats(bridge).uart_to_tcp == 0);
+}
+
+/* Everything arrives in order, in batch sized sends rather than one per event */
+static void test_uplink(uart_bridge_handle_t bridge, int client) {
+    uint8_t data[4000];
+    uint8_t got[sizeof(data)];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t) (i * 7 + (i >> 8));
+    }
+    uart_bridge_stats_t before = bridge_stats(bridge);
+    for (size_t i = 0; i < sizeof(data);) {
+        size_t n = 1 + (i * 13) % 29;
+        if (n > sizeof(data) - i) {
+            n = sizeof(data) - i;
+        }
+        uart_receive(data + i, n);
+        i += n;
+    }
+    client_read(client, got, sizeof(got));
+    TEST_CHECK(memcmp(data, got, sizeof(data)) == 0);
+
+    /* The counters move just after send() returns, possibly after the client read */
+    WAIT_FOR(bridge_stats(bridge).uart_to_tcp - before.uart_to_tcp == sizeof(data));
+    uint32_t sends = bridge_stats(bridge).sends - before.sends;
+    TEST_CHECK(sends >= sizeof(data) / BATCH_SIZE);
+    TEST_CHECK(sends < sizeof(data) / 8);
+}
+
+/* A short burst never fills the batch, the latency timer has to push it out */
+static void test_latency(uart_bridge_handle_t bridge, int client) {
+    static const uint8_t data[] = "ok\r\n";
+    uint8_t got[sizeof(data)];
+    int64_t start = test_now_ns();
+    uart_receive(data, sizeof(data));
+    client_read(client, got, sizeof(got));
+    int64_t elapsed_ms = (test_now_ns() - start) / 1000000;
+    TEST_CHECK(memcmp(data, got, sizeof(data)) == 0);
+    TEST_CHECK(elapsed_ms < LATENCY_MS + 200);
+    printf("latency: %lld ms for a %zu byte burst\n", (long long) elapsed_ms, sizeof(data));
+}
+
+static void test_downlink(uart_bridge_handle_t bridge, int client) {
+    uint8_t data[10000];
+    static uint8_t got[UART_TX_MAX];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t) (i ^ (i >> 5));
+    }
+    size_t base = uart_sent(NULL);
+    for (size_t i = 0; i < sizeof(data);) {
+        int n = send(client, data + i, sizeof(data) - i, 0);
+        TEST_CHECK(n > 0);
+        i += n;
+    }
+    WAIT_FOR(uart_sent(NULL) == base + sizeof(data));
+    uart_sent(got);
+    TEST_CHECK(memcmp(got + base, data, sizeof(data)) == 0);
+}
+
+/* A client that stops reading but keeps sending must still reach the UART
+ * while the uplink sits in send() waiting for it */
+static void test_slow_reader(uart_bridge_handle_t bridge, uint16_t port) {
+    int client = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    int rcvbuf = 4096;
+    setsockopt(client, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    uint32_t connections = bridge_stats(bridge).connections;
+    TEST_CHECK(connect(client, (struct sockaddr *) &addr, sizeof(addr)) == 0);
+    WAIT_FOR(bridge_stats(bridge).connections == connections + 1);
+
+    /* Far more than the two socket buffers hold, so the uplink blocks */
+    static uint8_t up[256 * 1024];
+    memset(up, 'u', sizeof(up));
+    for (size_t i = 0; i < sizeof(up); i += 1024) {
+        uart_receive(up + i, 1024);
+    }
+    uart_bridge_stats_t before = bridge_stats(bridge);
+    usleep(100000);
+    TEST_CHECK(bridge_stats(bridge).uart_to_tcp < before.uart_to_tcp + sizeof(up));
+
+    uint8_t down[10000];
+    memset(down, 'd', sizeof(down));
+    size_t base = uart_sent(NULL);
+    for (size_t i = 0; i < sizeof(down);) {
+        int n = send(client, down + i, sizeof(down) - i, 0);
+        TEST_CHECK(n > 0);
+        i += n;
+    }
+    WAIT_FOR(uart_sent(NULL) == base + sizeof(down));
+
+    client_read(client, NULL, sizeof(up));
+    close(client);
+}
+
+/* Host loopback throughput: what the bridge code costs per byte, the UART
+ * baud rate is what limits it on the chip */
+static void test_bench(uart_bridge_handle_t bridge, uint16_t port) {
+    enum { SIZE = 512 * 1024, CHUNK = 256 };
+    static uint8_t data[SIZE];
+    memset(data, 0x5a, sizeof(data));
+    uint32_t connections = bridge_stats(bridge).connections;
+    int client = client_connect(port);
+    WAIT_FOR(bridge_stats(bridge).connections == connections + 1);
+
+    uart_bridge_stats_t before = bridge_stats(bridge);
+    int64_t start = test_now_ns();
+    for (size_t i = 0; i < SIZE; i += CHUNK) {
+        uart_receive(data + i, CHUNK);
+    }
+    client_read(client, NULL, SIZE);
+    double s = (test_now_ns() - start) / 1e9;
+    WAIT_FOR(bridge_stats(bridge).uart_to_tcp - before.uart_to_tcp == SIZE);
+    uint32_t sends = bridge_stats(bridge).sends - before.sends;
+    printf("uplink: %.1f MB/s, %u bytes per send\n", SIZE / s / 1e6, SIZE / sends);
+
+    size_t base = uart_sent(NULL);
+    start = test_now_ns();
+    for (size_t i = 0; i < SIZE;) {
+        int n = send(client, data + i, SIZE - i, 0);
+        TEST_CHECK(n > 0);
+        i += n;
+    }
+    WAIT_FOR(uart_sent(NULL) == base + SIZE);
+    s = (test_now_ns() - start) / 1e9;
+    printf("downlink: %.1f MB/s\n", SIZE / s / 1e6);
+    close(client);
+}
+
+int main(void) {
+    /* lwIP has no SIGPIPE, a send to a closed client just fails */
+    signal(SIGPIPE, SIG_IGN);
+    uint16_t port = 20000 + getpid() % 20000;
+    uart_bridge_config_t config = UART_BRIDGE_CONFIG_DEFAULT(UART_NUM_1, port);
+    config.batch_size = BATCH_SIZE;
+    config.latency_ms = LATENCY_MS;
+    uart_bridge_handle_t bridge;
+    TEST_CHECK(uart_bridge_start(&config, &bridge) == ESP_OK);
+    TEST_CHECK(s_uart_config.event_cb != NULL && s_uart_config.rx_cb == NULL);
+
+    test_no_client(bridge);
+
+    int client = client_connect(port);
+    WAIT_FOR(bridge_stats(bridge).connections == 1);
+    test_uplink(bridge, client);
+    test_latency(bridge, client);
+    test_downlink(bridge, client);
+    close(client);
+
+    /* The next client takes over once the first is gone */
+    client = client_connect(port);
+    WAIT_FOR(bridge_stats(bridge).connections == 2);
+    test_latency(bridge, client);
+    test_downlink(bridge, client);
+    WAIT_FOR(bridge_stats(bridge).tcp_to_uart == 20000);
+    close(client);
+
+    test_slow_reader(bridge, port);
+    test_bench(bridge, port);
+
+    /* The bridge tasks never return, the process exit ends them */
+    printf("uart_bridge: ok\n");
+    return 0;
+}
@@ -0,0 +1,223 @@
+#define _GNU_SOURCE
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <termios.h>
+#include "test_util.h"
+#include "uart_frame.h"
+
+/* Encoder/decoder round trips, exact buffer sizes and resync after damage,
+ * then a loopback over a pseudo terminal to measure what the decoder keeps
+ * up with when the bytes arrive in whatever chunks the tty hands out. */
+
+typedef struct {
+    uint32_t frames;
+    uint8_t type;
+    uint8_t seq;
+    uint8_t payload[UART_FRAME_MAX_PAYLOAD];
+    size_t len;
+} received_t;
+
+static void on_frame(uint8_t type, uint8_t seq, const uint8_t *payload, size_t len, void *ctx) {
+    received_t *received = ctx;
+    received->frames++;
+    received->type = type;
+    received->seq = seq;
+    TEST_CHECK(len <= sizeof(received->payload));
+    memcpy(received->payload, payload, len);
+    received->len = len;
+}
+
+static uint32_t rand32(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static void test_crc(void) {
+    const uint8_t check[] = "123456789";
+    TEST_CHECK(uart_frame_crc16(0xffff, check, 9) == 0x29b1);
+    TEST_CHECK(uart_frame_crc32(0, check, 9) == 0xcbf43926);
+    /* Both can be run over a message in pieces */
+    TEST_CHECK(uart_frame_crc16(uart_frame_crc16(0xffff, check, 4), check + 4, 5) == 0x29b1);
+    TEST_CHECK(uart_frame_crc32(uart_frame_crc32(0, check, 4), check + 4, 5) == 0xcbf43926);
+}
+
+static void test_round_trip(void) {
+    uint32_t seed = 12345;
+    uint8_t payload[UART_FRAME_MAX_PAYLOAD];
+    uint8_t out[UART_FRAME_ENCODED_MAX(UART_FRAME_MAX_PAYLOAD)];
+    uint8_t exact[sizeof(out)];
+    uart_frame_decoder_t decoder;
+    received_t received = { 0 };
+    uart_frame_decoder_init(&decoder, on_frame, &received);
+
+    for (int run = 0; run < 20000; run++) {
+        size_t len = rand32(&seed) % (UART_FRAME_MAX_PAYLOAD + 1);
+        int fill = rand32(&seed) % 4;
+        for (size_t i = 0; i < len; i++) {
+            /* All zeros and no zeros at all are the COBS worst cases */
+            payload[i] = fill == 0 ? 0 : fill == 1 ? 0xff : fill == 2 ? 1 + rand32(&seed) % 255 : rand32(&seed);
+        }
+        uint8_t type = UART_FRAME_TYPE_DATA | (run & 1 ? UART_FRAME_FLAG_CRC32 : 0);
+        uint8_t seq = run;
+        size_t n = uart_frame_encode(type, seq, payload, len, out, sizeof(out));
+        TEST_CHECK(n > 0 && n <= UART_FRAME_ENCODED_MAX(len));
+        TEST_CHECK(memchr(out, UART_FRAME_DELIMITER, n - 1) == NULL && out[n - 1] == UART_FRAME_DELIMITER);
+        /* A buffer of exactly the encoded size is enough, one byte less is not */
+        TEST_CHECK(uart_frame_encode(type, seq, payload, len, exact, n) == n);
+        TEST_CHECK(memcmp(out, exact, n) == 0);
+        TEST_CHECK(uart_frame_encode(type, seq, payload, len, exact, n - 1) == 0);
+
+        /* Random chunking, the decoder must not care */
+        uint32_t before = received.frames;
+        size_t pos = 0;
+        while (pos < n) {
+            size_t chunk = 1 + rand32(&seed) % (n - pos);
+            uart_frame_decoder_feed(&decoder, out + pos, chunk);
+            pos += chunk;
+        }
+        TEST_CHECK(received.frames == before + 1);
+        TEST_CHECK(received.type == type && received.seq == seq && received.len == len);
+        TEST_CHECK(memcmp(received.payload, payload, len) == 0);
+    }
+    TEST_CHECK(decoder.stats.crc_errors == 0 && decoder.stats.format_errors == 0 && decoder.stats.overflows == 0);
+}
+
+static void test_damage(void) {
+    uint8_t payload[16] = "telemetry";
+    uint8_t frame[UART_FRAME_ENCODED_MAX(16)];
+    uint8_t stream[4 * sizeof(frame) + 400];
+    uart_frame_decoder_t decoder;
+    received_t received = { 0 };
+    uart_frame_decoder_init(&decoder, on_frame, &received);
+
+    size_t n = uart_frame_encode(UART_FRAME_TYPE_DATA, 1, payload, sizeof(payload), frame, sizeof(frame));
+    size_t len = 0;
+    /* Idle fill, a flipped bit, a runaway frame longer than any valid one, then a good frame */
+    stream[len++] = UART_FRAME_DELIMITER;
+    stream[len++] = UART_FRAME_DELIMITER;
+    memcpy(stream + len, frame, n);
+    stream[len + 5] ^= 0x10;
+    len += n;
+    memset(stream + len, 0x55, sizeof(decoder.buf) + 10);
+    len += sizeof(decoder.buf) + 10;
+    stream[len++] = UART_FRAME_DELIMITER;
+    /* Too short to hold a header and a CRC */
+    stream[len++] = 0x02;
+    stream[len++] = 0x01;
+    stream[len++] = UART_FRAME_DELIMITER;
+    memcpy(stream + len, frame, n);
+    len += n;
+    TEST_CHECK(len <= sizeof(stream));
+
+    uart_frame_decoder_feed(&decoder, stream, len);
+    TEST_CHECK(received.frames == 1 && received.seq == 1);
+    TEST_CHECK(decoder.stats.frames == 1);
+    TEST_CHECK(decoder.stats.crc_errors == 1);
+    TEST_CHECK(decoder.stats.overflows == 1);
+    TEST_CHECK(decoder.stats.format_errors == 1);
+}
+
+static void test_batch(void) {
+    uart_frame_batch_t batch;
+    uart_frame_batch_reset(&batch);
+    uint8_t sample[UART_FRAME_MAX_PAYLOAD] = { 0 };
+    size_t added = 0;
+    while (uart_frame_batch_add(&batch, added, sample, 10)) {
+        added++;
+    }
+    TEST_CHECK(added == UART_FRAME_MAX_PAYLOAD / 12 && batch.count == added);
+    TEST_CHECK(batch.payload[0] == 0 && batch.payload[1] == 10 && batch.payload[12] == 1);
+    /* One sample that fills the payload exactly */
+    uart_frame_batch_reset(&batch);
+    TEST_CHECK(uart_frame_batch_add(&batch, 0, sample, UART_FRAME_MAX_PAYLOAD - 2));
+    TEST_CHECK(!uart_frame_batch_add(&batch, 1, sample, 0));
+}
+
+#define LOOPBACK_FRAMES     20000
+#define LOOPBACK_PAYLOAD    64
+
+typedef struct {
+    int fd;
+    size_t bytes;
+} writer_t;
+
+static void *loopback_writer(void *arg) {
+    writer_t *writer = arg;
+    uint8_t payload[LOOPBACK_PAYLOAD];
+    uint8_t frame[UART_FRAME_ENCODED_MAX(LOOPBACK_PAYLOAD)];
+    for (uint32_t i = 0; i < LOOPBACK_FRAMES; i++) {
+        for (size_t j = 0; j < sizeof(payload); j++) {
+            payload[j] = i + j;
+        }
+        size_t n = uart_frame_encode(UART_FRAME_TYPE_DATA, i, payload, sizeof(payload), frame, sizeof(frame));
+        for (size_t pos = 0; pos < n;) {
+            ssize_t w = write(writer->fd, frame + pos, n - pos);
+            TEST_CHECK(w > 0);
+            pos += w;
+        }
+        writer->bytes += n;
+    }
+    return NULL;
+}
+
+static void bench_pty_loopback(void) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        printf("pty loopback: no pseudo terminals here, skipped\n");
+        return;
+    }
+    int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+    TEST_CHECK(slave >= 0);
+    struct termios tio;
+    TEST_CHECK(tcgetattr(slave, &tio) == 0);
+    cfmakeraw(&tio);
+    TEST_CHECK(tcsetattr(slave, TCSANOW, &tio) == 0);
+
+    uart_frame_decoder_t decoder;
+    received_t received = { 0 };
+    uart_frame_decoder_init(&decoder, on_frame, &received);
+    writer_t writer = { .fd = master };
+    pthread_t thread;
+    int64_t start = test_now_ns();
+    TEST_CHECK(pthread_create(&thread, NULL, loopback_writer, &writer) == 0);
+
+    uint8_t buf[256];
+    size_t bytes = 0;
+    uint32_t reads = 0;
+    while (received.frames < LOOPBACK_FRAMES) {
+        ssize_t n = read(slave, buf, sizeof(buf));
+        TEST_CHECK(n > 0);
+        bytes += n;
+        reads++;
+        uart_frame_decoder_feed(&decoder, buf, n);
+        /* Frames arrive in order and intact */
+        TEST_CHECK(received.seq == (uint8_t) (received.frames - 1) || received.frames == 0);
+    }
+    int64_t elapsed = test_now_ns() - start;
+    pthread_join(thread, NULL);
+    close(slave);
+    close(master);
+
+    TEST_CHECK(bytes == writer.bytes);
+    TEST_CHECK(decoder.stats.crc_errors == 0 && decoder.stats.format_errors == 0);
+    /* Payload is what the application gets across, the wire rate also counts
+     * the type and seq header, the CRC, COBS and the delimiter */
+    double frames_per_s = received.frames * 1e9 / elapsed;
+    printf("pty loopback: %u frames of %d payload bytes, %.0f frames/s, payload %.1f MB/s, "
+           "wire %.1f MB/s (%.2f wire bytes per payload byte), %.1f bytes per read\n", received.frames,
+           LOOPBACK_PAYLOAD, frames_per_s, frames_per_s * LOOPBACK_PAYLOAD / 1e6, bytes * 1e3 / elapsed,
+           (double) bytes / ((double) received.frames * LOOPBACK_PAYLOAD), (double) bytes / reads);
+}
+
+int main(void) {
+    test_crc();
+    test_round_trip();
+    test_damage();
+    test_batch();
+    bench_pty_loopback();
+    return 0;
+}
@@ -0,0 +1,147 @@
+#include <string.h>
+#include "test_util.h"
+#include "uart_match.h"
+
+/* Compares the matcher against a naive search at every offset over random
+ * streams, fed in random chunks, then measures its throughput. */
+
+#define MATCHES_MAX     4096
+
+typedef struct {
+    int pattern;
+    uint32_t offset;
+} hit_t;
+
+typedef struct {
+    hit_t hits[MATCHES_MAX];
+    size_t count;
+} hits_t;
+
+static void on_match(int pattern, uint32_t offset, void *ctx) {
+    hits_t *hits = ctx;
+    TEST_CHECK(hits->count < MATCHES_MAX);
+    hits->hits[hits->count].pattern = pattern;
+    hits->hits[hits->count].offset = offset;
+    hits->count++;
+}
+
+/* Same order as the matcher: by end position, then pattern index */
+static size_t naive(const uart_match_pattern_t *patterns, size_t count, const uint8_t *data, size_t len,
+                    hit_t *hits) {
+    size_t found = 0;
+    for (size_t end = 1; end <= len; end++) {
+        for (size_t p = 0; p < count; p++) {
+            size_t plen = patterns[p].len;
+            if (plen <= end && memcmp(data + end - plen, patterns[p].bytes, plen) == 0) {
+                TEST_CHECK(found < MATCHES_MAX);
+                hits[found].pattern = p;
+                hits[found].offset = end - plen;
+                found++;
+            }
+        }
+    }
+    return found;
+}
+
+static uint32_t rand32(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static const uart_match_pattern_t patterns[] = {
+    { "+++", 3 },
+    { "\r\n", 2 },
+    { "\0", 1 },
+    { "++", 2 },
+    { "\n+", 2 },
+    { "AT+", 3 },
+};
+
+#define PATTERN_COUNT   (sizeof(patterns) / sizeof(patterns[0]))
+
+static void test_against_naive(void) {
+    /* Few distinct bytes, so matches, overlaps and near misses are common */
+    static const uint8_t alphabet[] = { '+', '\r', '\n', 0, 'A', 'T', 'x' };
+    uint32_t seed = 42;
+    static uart_match_t match;
+    static hits_t got;
+    static hit_t want[MATCHES_MAX];
+    uint8_t data[1024];
+
+    for (int run = 0; run < 500; run++) {
+        size_t len = rand32(&seed) % sizeof(data);
+        for (size_t i = 0; i < len; i++) {
+            data[i] = alphabet[rand32(&seed) % sizeof(alphabet)];
+        }
+        got.count = 0;
+        TEST_CHECK(uart_match_init(&match, patterns, PATTERN_COUNT, on_match, &got));
+        size_t reported = 0;
+        for (size_t pos = 0; pos < len;) {
+            size_t chunk = 1 + rand32(&seed) % (len - pos);
+            reported += uart_match_feed(&match, data + pos, chunk);
+            pos += chunk;
+        }
+        size_t expect = naive(patterns, PATTERN_COUNT, data, len, want);
+        TEST_CHECK(reported == expect && got.count == expect);
+        TEST_CHECK(memcmp(got.hits, want, expect * sizeof(hit_t)) == 0);
+    }
+}
+
+static void test_reset_and_limits(void) {
+    static uart_match_t match;
+    static hits_t got;
+    TEST_CHECK(uart_match_init(&match, patterns, 1, on_match, &got));
+    /* A reset forgets the partial "++" and restarts the offsets */
+    got.count = 0;
+    uart_match_feed(&match, (const uint8_t *) "xx++", 4);
+    uart_match_reset(&match);
+    TEST_CHECK(uart_match_feed(&match, (const uint8_t *) "+", 1) == 0);
+    TEST_CHECK(uart_match_feed(&match, (const uint8_t *) "++", 2) == 1);
+    TEST_CHECK(got.count == 1 && got.hits[0].offset == 0);
+
+    TEST_CHECK(!uart_match_init(&match, patterns, 0, on_match, &got));
+    uart_match_pattern_t many[UART_MATCH_MAX_PATTERNS + 1];
+    for (size_t i = 0; i < UART_MATCH_MAX_PATTERNS + 1; i++) {
+        many[i] = patterns[0];
+    }
+    TEST_CHECK(!uart_match_init(&match, many, UART_MATCH_MAX_PATTERNS + 1, on_match, &got));
+    uart_match_pattern_t empty = { "", 0 };
+    TEST_CHECK(!uart_match_init(&match, &empty, 1, on_match, &got));
+    /* More distinct bytes than classes */
+    static char wide[UART_MATCH_MAX_CLASSES + 1];
+    for (size_t i = 0; i < sizeof(wide); i++) {
+        wide[i] = 'A' + i;
+    }
+    uart_match_pattern_t too_wide = { wide, sizeof(wide) };
+    TEST_CHECK(!uart_match_init(&match, &too_wide, 1, on_match, &got));
+}
+
+static void bench_feed(void) {
+    static uart_match_t match;
+    static uint8_t data[64 * 1024];
+    uint32_t seed = 7;
+    for (size_t i = 0; i < sizeof(data); i++) {
+        /* Mostly text, now and then a '+' so the DFA leaves its start state */
+        data[i] = rand32(&seed) % 16 ? 'a' + rand32(&seed) % 26 : '+';
+    }
+    TEST_CHECK(uart_match_init(&match, patterns, PATTERN_COUNT, NULL, NULL));
+    const int rounds = 500;
+    size_t found = 0;
+    int64_t start = test_now_ns();
+    for (int i = 0; i < rounds; i++) {
+        found += uart_match_feed(&match, data, sizeof(data));
+    }
+    int64_t elapsed = test_now_ns() - start;
+    TEST_CHECK(found > 0);
+    printf("feed: %.0f MB/s, %.2f ns per byte\n", (double) sizeof(data) * rounds * 1e3 / elapsed,
+           (double) elapsed / ((double) sizeof(data) * rounds));
+}
+
+int main(void) {
+    test_against_naive();
+    test_reset_and_limits();
+    bench_feed();
+    return 0;
+}
@@ -0,0 +1,213 @@
+#include <stdlib.h>
+#include <string.h>
+#include "test_util.h"
+#include "uart_shell.h"
+
+/* Handlers append "name:args;" to a log, so a whole session can be compared
+ * no matter how the input was chunked. */
+
+static char calls[1024];
+static size_t calls_len;
+
+static void record(const char *args, size_t len, void *ctx) {
+    const char *name = ctx;
+    size_t name_len = strlen(name);
+    TEST_CHECK(calls_len + name_len + len + 2 < sizeof(calls));
+    memcpy(calls + calls_len, name, name_len);
+    calls_len += name_len;
+    calls[calls_len++] = ':';
+    memcpy(calls + calls_len, args, len);
+    calls_len += len;
+    calls[calls_len++] = ';';
+    calls[calls_len] = 0;
+}
+
+static const uart_shell_command_t commands[] = {
+    { "period", record, "period" },
+    { "level", record, "level" },
+    { "stats", record, "stats" },
+    { "telemetry", record, "telemetry" },
+};
+
+#define COMMAND_COUNT   (sizeof(commands) / sizeof(commands[0]))
+
+static const char script[] =
+    "period=500\r\n"
+    "  level 1\n"
+    "\r\n"
+    "bogus\r"
+    "stats\n"
+    "telemetry\r\n"
+    "levelx=1\n"
+    "period=";
+static const char script_calls[] = "period:500;level:1;stats:;telemetry:;";
+
+static uint32_t rand32(uint32_t *state) {
+    /* xorshift32, reproducible across runs */
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static void feed_session(const char *data, size_t len, const size_t *cuts, size_t cut_count,
+                         uart_shell_t *shell) {
+    TEST_CHECK(uart_shell_init(shell, commands, COMMAND_COUNT));
+    calls_len = 0;
+    calls[0] = 0;
+    size_t pos = 0;
+    for (size_t i = 0; i <= cut_count; i++) {
+        size_t next = i < cut_count ? cuts[i] : len;
+        uart_shell_feed(shell, (const uint8_t *) data + pos, next - pos);
+        pos = next;
+    }
+}
+
+static void test_split_anywhere(void) {
+    uart_shell_t shell;
+    size_t len = sizeof(script) - 1;
+    feed_session(script, len, NULL, 0, &shell);
+    TEST_CHECK(strcmp(calls, script_calls) == 0);
+    TEST_CHECK(shell.stats.lines == 6);
+    TEST_CHECK(shell.stats.unknown == 2);
+    /* The unterminated "period=" waits for its end of line */
+    TEST_CHECK(shell.line_len == 7);
+
+    for (size_t a = 0; a <= len; a++) {
+        for (size_t b = a; b <= len; b++) {
+            size_t cuts[] = { a, b };
+            feed_session(script, len, cuts, 2, &shell);
+            TEST_CHECK(strcmp(calls, script_calls) == 0);
+            TEST_CHECK(shell.stats.lines == 6 && shell.stats.unknown == 2);
+        }
+    }
+    /* One byte at a time */
+    size_t cuts[sizeof(script)];
+    for (size_t i = 0; i < len; i++) {
+        cuts[i] = i;
+    }
+    feed_session(script, len, cuts, len, &shell);
+    TEST_CHECK(strcmp(calls, script_calls) == 0);
+}
+
+static void test_overflow(void) {
+    uart_shell_t shell;
+    char data[3 * UART_SHELL_LINE_MAX];
+    size_t len = 0;
+    /* Exactly UART_SHELL_LINE_MAX fits */
+    len += sprintf(data + len, "level=");
+    memset(data + len, '7', UART_SHELL_LINE_MAX - 6);
+    len += UART_SHELL_LINE_MAX - 6;
+    data[len++] = '\n';
+    /* One more does not, and everything up to its terminator is dropped */
+    len += sprintf(data + len, "level=");
+    memset(data + len, '8', UART_SHELL_LINE_MAX - 5);
+    len += UART_SHELL_LINE_MAX - 5;
+    len += sprintf(data + len, "\nstats\n");
+
+    /* Split so both long lines have to be buffered */
+    size_t cuts[] = { 3, UART_SHELL_LINE_MAX + 4 };
+    feed_session(data, len, cuts, 2, &shell);
+    TEST_CHECK(shell.stats.overflows == 1);
+    TEST_CHECK(strncmp(calls, "level:7777", 10) == 0);
+    TEST_CHECK(strlen(calls) == 6 + UART_SHELL_LINE_MAX - 6 + 1 + strlen("stats:;"));
+    TEST_CHECK(strcmp(calls + strlen(calls) - 7, "stats:;") == 0);
+}
+
+static void test_init(void) {
+    uart_shell_t shell;
+    const uart_shell_command_t duplicate[] = {
+        { "a", record, "a" },
+        { "b", record, "b" },
+        { "a", record, "a" },
+    };
+    TEST_CHECK(!uart_shell_init(&shell, duplicate, 3));
+    TEST_CHECK(!uart_shell_init(&shell, commands, UART_SHELL_MAX_COMMANDS + 1));
+    /* A prefix of a command is not that command */
+    TEST_CHECK(uart_shell_init(&shell, commands, COMMAND_COUNT));
+    TEST_CHECK(!uart_shell_dispatch(&shell, "per", 3));
+    TEST_CHECK(!uart_shell_dispatch(&shell, "periods", 7));
+    /* A NUL from the line does not end the name early */
+    TEST_CHECK(!uart_shell_dispatch(&shell, "stats\0", 6));
+    TEST_CHECK(!uart_shell_dispatch(&shell, "stats\0x", 7));
+}
+
+static void test_parse_int(void) {
+    int value = 0;
+    TEST_CHECK(uart_shell_parse_int("500", 3, &value) && value == 500);
+    TEST_CHECK(uart_shell_parse_int("-12", 3, &value) && value == -12);
+    TEST_CHECK(uart_shell_parse_int("+7", 2, &value) && value == 7);
+    TEST_CHECK(uart_shell_parse_int("2147483647", 10, &value) && value == 2147483647);
+    TEST_CHECK(!uart_shell_parse_int("2147483648", 10, &value));
+    TEST_CHECK(!uart_shell_parse_int("", 0, &value));
+    TEST_CHECK(!uart_shell_parse_int("-", 1, &value));
+    TEST_CHECK(!uart_shell_parse_int("12a", 3, &value));
+    /* Only len bytes count, the rest of the buffer is not looked at */
+    TEST_CHECK(uart_shell_parse_int("12a", 2, &value) && value == 12);
+}
+
+static void count(const char *args, size_t len, void *ctx) {
+    (*(uint32_t *) ctx)++;
+}
+
+/* The script repeated and fed in random pieces of 1 to 120 bytes, the most
+ * the UART driver hands over per event. The shell has to keep up with a
+ * 115200 baud link, 8N1, which carries 11520 bytes a second. */
+static void test_bench(void) {
+    enum { REPEAT = 100000, BAUD = 115200, PIECE_MAX = 120 };
+    uint32_t dispatched = 0;
+    const uart_shell_command_t counting[] = {
+        { "period", count, &dispatched },
+        { "level", count, &dispatched },
+        { "stats", count, &dispatched },
+        { "telemetry", count, &dispatched },
+    };
+    /* The trailing "period=" joins up with the first line of the next copy */
+    size_t script_len = sizeof(script) - 1;
+    size_t len = script_len * REPEAT;
+    char *data = malloc(len);
+    TEST_CHECK(data != NULL);
+    for (size_t i = 0; i < REPEAT; i++) {
+        memcpy(data + i * script_len, script, script_len);
+    }
+    size_t piece_count = 0;
+    size_t *pieces = malloc(len * sizeof(size_t));
+    TEST_CHECK(pieces != NULL);
+    uint32_t seed = 0x5eed;
+    for (size_t pos = 0; pos < len;) {
+        size_t piece = 1 + rand32(&seed) % PIECE_MAX;
+        pieces[piece_count++] = piece < len - pos ? piece : len - pos;
+        pos += pieces[piece_count - 1];
+    }
+
+    uart_shell_t shell;
+    TEST_CHECK(uart_shell_init(&shell, counting, COMMAND_COUNT));
+    int64_t start = test_now_ns();
+    size_t pos = 0;
+    for (size_t i = 0; i < piece_count; i++) {
+        uart_shell_feed(&shell, (const uint8_t *) data + pos, pieces[i]);
+        pos += pieces[i];
+    }
+    double seconds = (test_now_ns() - start) / 1e9;
+    /* The joined "period=period=500" is still a period line, so every copy
+     * dispatches like the session */
+    TEST_CHECK(shell.stats.lines == 6 * REPEAT);
+    TEST_CHECK(dispatched == 4 * REPEAT);
+
+    double lines_per_s = shell.stats.lines / seconds;
+    double uart_lines_per_s = BAUD / 10.0 / ((double) len / shell.stats.lines);
+    printf("random pieces: %u lines in %.3f s, %.2f M lines/s, %.1f MB/s, %.0fx the %d baud line rate "
+           "of %.0f lines/s\n", (unsigned) shell.stats.lines, seconds, lines_per_s / 1e6, len / seconds / 1e6,
+           lines_per_s / uart_lines_per_s, BAUD, uart_lines_per_s);
+    free(pieces);
+    free(data);
+}
+
+int main(void) {
+    test_split_anywhere();
+    test_overflow();
+    test_init();
+    test_parse_int();
+    test_bench();
+    return 0;
+}
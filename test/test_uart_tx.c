@@ -0,0 +1,237 @@
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "test_util.h"
+#include "uart_tx.h"
+#include "uart_telemetry.h"
+
+/* The driver is replaced by a capture buffer. Producers hammer the queue
+ * from several threads and every message has to come out whole, then
+ * telemetry runs through the same queue against a peer that acks. */
+
+#define CAPTURE_MAX     (8 * 1024 * 1024)
+
+static pthread_mutex_t s_capture_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t s_capture[CAPTURE_MAX];
+static size_t s_capture_len;
+static uint32_t s_driver_writes;
+static void (*s_peer)(const uint8_t *data, size_t len);
+
+int uart_write_bytes(uart_port_t port, const void *src, size_t size) {
+    pthread_mutex_lock(&s_capture_lock);
+    TEST_CHECK(s_capture_len + size <= CAPTURE_MAX);
+    memcpy(s_capture + s_capture_len, src, size);
+    s_capture_len += size;
+    s_driver_writes++;
+    pthread_mutex_unlock(&s_capture_lock);
+    if (s_peer) {
+        s_peer(src, size);
+    }
+    return size;
+}
+
+uart_port_t uart_iot_get_port(uart_iot_handle_t uart) {
+    return UART_NUM_0;
+}
+
+static void capture_reset(void) {
+    pthread_mutex_lock(&s_capture_lock);
+    s_capture_len = 0;
+    s_driver_writes = 0;
+    pthread_mutex_unlock(&s_capture_lock);
+}
+
+/* The worker flushes within flush_deadline_ms, give it a generous multiple */
+static size_t capture_wait(size_t len) {
+    size_t now = 0;
+    for (int i = 0; i < 500; i++) {
+        pthread_mutex_lock(&s_capture_lock);
+        now = s_capture_len;
+        pthread_mutex_unlock(&s_capture_lock);
+        if (now >= len) {
+            break;
+        }
+        usleep(1000);
+    }
+    return now;
+}
+
+#define PRODUCERS           4
+#define WRITES_PER_PRODUCER 10000
+#define MESSAGE_MAX         (3 * UART_TX_SLOT_DATA + 7)
+
+typedef struct {
+    uart_tx_handle_t tx;
+    uint8_t id;
+    uint32_t accepted;
+    uint32_t accepted_bytes;
+} producer_t;
+
+static uint32_t rand32(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+/* Messages are [0xa0 | id][len][id ...] so a reader can walk them and spot
+ * any byte that belongs to someone else */
+static void *producer_run(void *arg) {
+    producer_t *producer = arg;
+    uint8_t message[MESSAGE_MAX];
+    uint32_t seed = producer->id + 1;
+    for (int i = 0; i < WRITES_PER_PRODUCER; i++) {
+        size_t len = 3 + rand32(&seed) % (MESSAGE_MAX - 3);
+        message[0] = 0xa0 | producer->id;
+        message[1] = len;
+        memset(message + 2, producer->id, len - 2);
+        esp_err_t err = uart_tx_write(producer->tx, producer->id, message, len);
+        if (err == ESP_OK) {
+            producer->accepted++;
+            producer->accepted_bytes += len;
+        } else {
+            TEST_CHECK(err == ESP_ERR_NO_MEM);
+            usleep(20);
+        }
+    }
+    return NULL;
+}
+
+static void test_concurrent_writes(void) {
+    uart_tx_config_t config = UART_TX_CONFIG_DEFAULT();
+    config.slot_count = 16;
+    uart_tx_handle_t tx;
+    /* The handle is only asked for its port */
+    TEST_CHECK(uart_tx_create((uart_iot_handle_t) 1, &config, &tx) == ESP_OK);
+    capture_reset();
+
+    producer_t producers[PRODUCERS];
+    pthread_t threads[PRODUCERS];
+    size_t expect_bytes = 0;
+    for (int i = 0; i < PRODUCERS; i++) {
+        producers[i] = (producer_t) { .tx = tx, .id = i };
+        TEST_CHECK(pthread_create(&threads[i], NULL, producer_run, &producers[i]) == 0);
+    }
+    for (int i = 0; i < PRODUCERS; i++) {
+        pthread_join(threads[i], NULL);
+        expect_bytes += producers[i].accepted_bytes;
+    }
+    TEST_CHECK(capture_wait(expect_bytes) == expect_bytes);
+
+    uint32_t seen[PRODUCERS] = { 0 };
+    size_t pos = 0;
+    while (pos < s_capture_len) {
+        uint8_t id = s_capture[pos] & 0x0f;
+        size_t len = s_capture[pos + 1];
+        TEST_CHECK((s_capture[pos] & 0xf0) == 0xa0 && id < PRODUCERS);
+        TEST_CHECK(pos + len <= s_capture_len);
+        for (size_t i = 2; i < len; i++) {
+            TEST_CHECK(s_capture[pos + i] == id);
+        }
+        seen[id]++;
+        pos += len;
+    }
+
+    uart_tx_stats_t stats;
+    uart_tx_get_stats(tx, &stats);
+    uint32_t accepted = 0;
+    for (int i = 0; i < PRODUCERS; i++) {
+        TEST_CHECK(seen[i] == producers[i].accepted);
+        TEST_CHECK(stats.bytes[i] == producers[i].accepted_bytes);
+        accepted += producers[i].accepted;
+    }
+    TEST_CHECK(stats.high_water <= config.slot_count);
+    printf("concurrent: %u of %u writes accepted, %u driver writes, high water %u\n",
+           accepted, PRODUCERS * WRITES_PER_PRODUCER, stats.writes, stats.high_water);
+
+    /* Longer than the whole queue can never go out */
+    static uint8_t big[16 * UART_TX_SLOT_DATA + 1];
+    TEST_CHECK(uart_tx_write(tx, 0, big, sizeof(big)) == ESP_ERR_INVALID_SIZE);
+    TEST_CHECK(uart_tx_write(tx, UART_TX_MAX_PRODUCERS, big, 1) == ESP_ERR_INVALID_ARG);
+    uart_tx_delete(tx);
+}
+
+static void test_coalescing(void) {
+    uart_tx_config_t config = UART_TX_CONFIG_DEFAULT();
+    uart_tx_handle_t tx;
+    TEST_CHECK(uart_tx_create((uart_iot_handle_t) 1, &config, &tx) == ESP_OK);
+    capture_reset();
+    /* Small writes land within the flush deadline as a few driver writes */
+    for (int i = 0; i < 32; i++) {
+        TEST_CHECK(uart_tx_write(tx, 0, "0123456789abcdef", 16) == ESP_OK);
+    }
+    TEST_CHECK(capture_wait(32 * 16) == 32 * 16);
+    printf("coalescing: 32 writes of 16 bytes took %u driver writes\n", s_driver_writes);
+    TEST_CHECK(s_driver_writes < 32);
+    uart_tx_delete(tx);
+}
+
+/* Peer side of the telemetry link: acks a frame the second time it is sent */
+
+static uart_telemetry_handle_t s_telemetry;
+static uart_frame_decoder_t s_peer_decoder;
+static int s_peer_last_seq = -1;
+static uint32_t s_peer_samples;
+
+static void peer_frame(uint8_t type, uint8_t seq, const uint8_t *payload, size_t len, void *ctx) {
+    for (size_t pos = 0; pos + 2 <= len; pos += 2 + payload[pos + 1]) {
+        s_peer_samples++;
+    }
+    if (!(type & UART_FRAME_FLAG_ACK_REQ)) {
+        return;
+    }
+    if (s_peer_last_seq != seq) {
+        /* Pretend the first copy got lost */
+        s_peer_last_seq = seq;
+        return;
+    }
+    uint8_t ack[UART_FRAME_ENCODED_MAX(0)];
+    size_t n = uart_frame_encode(UART_FRAME_TYPE_ACK, seq, NULL, 0, ack, sizeof(ack));
+    uart_telemetry_feed(s_telemetry, ack, n);
+}
+
+static void peer_feed(const uint8_t *data, size_t len) {
+    uart_frame_decoder_feed(&s_peer_decoder, data, len);
+}
+
+static void test_telemetry(void) {
+    uart_tx_config_t tx_config = UART_TX_CONFIG_DEFAULT();
+    uart_tx_handle_t tx;
+    TEST_CHECK(uart_tx_create((uart_iot_handle_t) 1, &tx_config, &tx) == ESP_OK);
+    uart_telemetry_config_t config = UART_TELEMETRY_CONFIG_DEFAULT();
+    config.crc32 = true;
+    TEST_CHECK(uart_telemetry_create(tx, 3, &config, &s_telemetry) == ESP_OK);
+    uart_frame_decoder_init(&s_peer_decoder, peer_frame, NULL);
+    capture_reset();
+    s_peer = peer_feed;
+
+    /* 100 samples of 8 bytes fill several frames on their own */
+    uint8_t sample[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    for (int i = 0; i < 100; i++) {
+        TEST_CHECK(uart_telemetry_add(s_telemetry, i, sample, sizeof(sample)) == ESP_OK);
+    }
+    TEST_CHECK(uart_telemetry_flush(s_telemetry, true) == ESP_OK);
+
+    uart_telemetry_stats_t stats;
+    uart_telemetry_get_stats(s_telemetry, &stats);
+    TEST_CHECK(stats.samples == 100 && stats.dropped == 0 && stats.encode_errors == 0);
+    TEST_CHECK(stats.retransmits == 1 && stats.ack_failures == 0);
+    /* Every sample reached the peer once, plus the retransmitted last frame */
+    uint32_t last_frame = 100 - (stats.frames - 1) * ((UART_FRAME_MAX_PAYLOAD) / (2 + sizeof(sample)));
+    TEST_CHECK(s_peer_samples == 100 + last_frame);
+
+    uart_tx_stats_t tx_stats;
+    uart_tx_get_stats(tx, &tx_stats);
+    TEST_CHECK(tx_stats.bytes[3] == s_capture_len && tx_stats.dropped[3] == 0);
+    /* The worker may still be inside the peer's feed, stop it before the telemetry goes */
+    uart_tx_delete(tx);
+    s_peer = NULL;
+    uart_telemetry_delete(s_telemetry);
+}
+
+int main(void) {
+    test_concurrent_writes();
+    test_coalescing();
+    test_telemetry();
+    return 0;
+}
@@ -0,0 +1,22 @@
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+/* Tests are plain programs, a failed check reports where and fails the ctest run */
+#define TEST_CHECK(cond) do {                                                       \
+    if (!(cond)) {                                                                  \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);   \
+        exit(1);                                                                    \
+    }                                                                               \
+} while (0)
+
+static inline int64_t test_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+#endif
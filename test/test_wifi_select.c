@@ -0,0 +1,159 @@
+#include <string.h>
+#include "test_util.h"
+#include "wifi_select.h"
+
+/* Ranks synthetic scans against a reference that builds every candidate
+ * and sorts the whole list, and walks the roaming trigger through RSSI
+ * sequences. */
+
+#define MAX_PROFILES    4
+#define MAX_APS         24
+
+static uint64_t rand64(uint64_t *state) {
+    /* xorshift64, reproducible across runs */
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static wifi_profile_t profile(const char *ssid, int8_t priority) {
+    wifi_profile_t p = { .priority = priority };
+    strcpy(p.ssid, ssid);
+    return p;
+}
+
+static wifi_select_ap_t ap(const char *ssid, int8_t rssi) {
+    wifi_select_ap_t a = { .rssi = rssi, .channel = 1 };
+    strcpy(a.ssid, ssid);
+    return a;
+}
+
+/* All candidates, then a stable insertion sort: score, then RSSI, then scan order */
+static size_t reference_rank(const wifi_profile_t *profiles, size_t profile_count,
+                             const wifi_select_ap_t *aps, size_t ap_count, int8_t min_rssi,
+                             wifi_select_candidate_t *out) {
+    size_t count = 0;
+    for (size_t a = 0; a < ap_count; a++) {
+        if (aps[a].rssi < min_rssi) {
+            continue;
+        }
+        for (size_t p = 0; p < profile_count; p++) {
+            if (strcmp(aps[a].ssid, profiles[p].ssid) == 0) {
+                out[count].profile = p;
+                out[count].ap = a;
+                out[count].score = aps[a].rssi + profiles[p].priority * WIFI_SELECT_PRIORITY_DB;
+                count++;
+                break;
+            }
+        }
+    }
+    for (size_t i = 1; i < count; i++) {
+        wifi_select_candidate_t c = out[i];
+        size_t j = i;
+        while (j > 0 && (out[j - 1].score < c.score ||
+                         (out[j - 1].score == c.score && aps[out[j - 1].ap].rssi < aps[c.ap].rssi))) {
+            out[j] = out[j - 1];
+            j--;
+        }
+        out[j] = c;
+    }
+    return count;
+}
+
+static void test_rank_basic(void) {
+    wifi_profile_t profiles[] = { profile("home", 0), profile("office", 2), profile("phone", -1) };
+    wifi_select_ap_t aps[] = {
+        ap("home", -60),
+        ap("cafe", -30),        /* No profile */
+        ap("office", -68),      /* -68 + 10 beats -60, ties with -58 */
+        ap("phone", -50),       /* -50 - 5 beats both */
+        ap("home", -90),        /* Below min_rssi */
+        ap("home", -58),
+    };
+    wifi_select_candidate_t out[8];
+    size_t n = wifi_select_rank(profiles, 3, aps, 6, -80, out, 8);
+    TEST_CHECK(n == 4);
+    TEST_CHECK(out[0].ap == 3 && out[0].profile == 2 && out[0].score == -55);
+    /* Same score, the stronger signal goes first */
+    TEST_CHECK(out[1].ap == 5 && out[1].profile == 0 && out[1].score == -58);
+    TEST_CHECK(out[2].ap == 2 && out[2].profile == 1 && out[2].score == -58);
+    TEST_CHECK(out[3].ap == 0 && out[3].score == -60);
+
+    /* Only the best ones are kept when out is short */
+    n = wifi_select_rank(profiles, 3, aps, 6, -80, out, 2);
+    TEST_CHECK(n == 2 && out[0].ap == 3 && out[1].ap == 5);
+    TEST_CHECK(wifi_select_rank(profiles, 3, aps, 6, -80, out, 0) == 0);
+    TEST_CHECK(wifi_select_rank(profiles, 3, aps, 6, -20, out, 8) == 0);
+    TEST_CHECK(wifi_select_rank(profiles, 0, aps, 6, -80, out, 8) == 0);
+
+    /* Ties on score and RSSI keep scan order */
+    wifi_select_ap_t twins[] = { ap("home", -70), ap("home", -70), ap("home", -70) };
+    n = wifi_select_rank(profiles, 3, twins, 3, -80, out, 8);
+    TEST_CHECK(n == 3 && out[0].ap == 0 && out[1].ap == 1 && out[2].ap == 2);
+}
+
+static void test_rank_random(void) {
+    static const char *ssids[] = { "a", "b", "c", "d", "e", "f" };
+    uint64_t seed = 0x2545f4914f6cdd1dULL;
+    for (int run = 0; run < 20000; run++) {
+        wifi_profile_t profiles[MAX_PROFILES];
+        wifi_select_ap_t aps[MAX_APS];
+        size_t profile_count = rand64(&seed) % (MAX_PROFILES + 1);
+        size_t ap_count = rand64(&seed) % (MAX_APS + 1);
+        for (size_t i = 0; i < profile_count; i++) {
+            /* Duplicate SSIDs happen, the first profile for an SSID wins */
+            profiles[i] = profile(ssids[rand64(&seed) % 6], (int8_t) (rand64(&seed) % 7) - 3);
+        }
+        for (size_t i = 0; i < ap_count; i++) {
+            /* A narrow RSSI range makes ties common */
+            aps[i] = ap(ssids[rand64(&seed) % 6], (int8_t) -(40 + rand64(&seed) % 20));
+        }
+        int8_t min_rssi = (int8_t) -(45 + rand64(&seed) % 20);
+        size_t max_out = rand64(&seed) % (MAX_APS + 2);
+
+        wifi_select_candidate_t expect[MAX_APS];
+        wifi_select_candidate_t out[MAX_APS + 2];
+        size_t expect_count = reference_rank(profiles, profile_count, aps, ap_count, min_rssi, expect);
+        if (expect_count > max_out) {
+            expect_count = max_out;
+        }
+        size_t n = wifi_select_rank(profiles, profile_count, aps, ap_count, min_rssi, out, max_out);
+        TEST_CHECK(n == expect_count);
+        for (size_t i = 0; i < n; i++) {
+            TEST_CHECK(out[i].profile == expect[i].profile);
+            TEST_CHECK(out[i].ap == expect[i].ap);
+            TEST_CHECK(out[i].score == expect[i].score);
+        }
+    }
+}
+
+static void test_roam(void) {
+    wifi_roam_t roam;
+    wifi_roam_init(&roam, -75, 3);
+    /* A dip shorter than the window doesn't count, the streak starts over */
+    TEST_CHECK(!wifi_roam_sample(&roam, -80));
+    TEST_CHECK(!wifi_roam_sample(&roam, -80));
+    TEST_CHECK(!wifi_roam_sample(&roam, -75));
+    TEST_CHECK(!wifi_roam_sample(&roam, -80));
+    TEST_CHECK(!wifi_roam_sample(&roam, -80));
+    TEST_CHECK(wifi_roam_sample(&roam, -80));
+    /* Fires again only after another full window */
+    TEST_CHECK(!wifi_roam_sample(&roam, -80));
+    TEST_CHECK(!wifi_roam_sample(&roam, -80));
+    TEST_CHECK(wifi_roam_sample(&roam, -80));
+
+    /* A zero window acts as one sample */
+    wifi_roam_init(&roam, -75, 0);
+    TEST_CHECK(wifi_roam_sample(&roam, -76));
+    TEST_CHECK(!wifi_roam_sample(&roam, -70));
+    TEST_CHECK(wifi_roam_sample(&roam, -76));
+}
+
+int main(void) {
+    test_rank_basic();
+    test_rank_random();
+    test_roam();
+    printf("wifi_select: ok\n");
+    return 0;
+}